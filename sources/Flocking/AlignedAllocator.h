@@ -0,0 +1,46 @@
+﻿#pragma once
+#include <new>
+#include <vector>
+
+// Keeps the SoA arrays aligned to a full AVX register
+template<typename T, size_t ALIGNMENT = 32>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, ALIGNMENT>;
+    };
+
+    AlignedAllocator() noexcept = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) noexcept {}
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{ALIGNMENT}));
+    }
+
+    void deallocate(T* ptr, size_t) noexcept
+    {
+        ::operator delete(ptr, std::align_val_t{ALIGNMENT});
+    }
+
+    template<typename U>
+    bool operator ==(const AlignedAllocator<U, ALIGNMENT>&) const noexcept
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator !=(const AlignedAllocator<U, ALIGNMENT>&) const noexcept
+    {
+        return false;
+    }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
@@ -1,16 +1,33 @@
 ﻿#include "pch.h"
 #include "Behavior.h"
-
-void Behavior::Perform(float deltaTime, Boid& boid, const vector<Boid>& boids)
+#include "BoidStorage.h"
+#include "FlockOctree.h"
+#include "FrameStats.h"
+#include "NearestNeighbours.h"
+#include "ObstacleField.h"
+#include "NeighbourIndex.h"
+#include "ObstacleIndex.h"
+#include "SteeringKernels.h"
+
+void Behavior::Perform(float deltaTime, Boid& boid, const vector<Boid>& boids) const
 {
-    const vector<const Boid*> neighbours = GetNeighbours(boid, boids);
+    ArenaScope scope;
+
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+    const BoidList neighbours = GetNeighbours(boid, boids);
+    FLOCKING_COUNT(FRAME_COUNTER::NEIGHBOURS, neighbours.size());
     
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::STEERING);
     const RVector3 alignment = GetAlignment(boid, neighbours) * alignmentWeight;
     const RVector3 cohesion = GetCohesion(boid, neighbours) * cohesionWeight;
     const RVector3 separation = GetSeparation(boid, neighbours) * separationWeight;
-    const RVector3 avoidance = GetAvoidance(boid) * avoidanceWeight;
+    const RVector3 attraction = GetFlockAttraction(boid) * flockAttractionWeight;
 
-    const RVector3 acceleration = alignment + cohesion + separation + avoidance;
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::OBSTACLE_AVOIDANCE);
+    const RVector3 avoidance = GetThrottledAvoidance(boid) * avoidanceWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::INTEGRATION);
+    const RVector3 acceleration = alignment + cohesion + separation + avoidance + attraction;
     boid.velocity += acceleration.getUnit();
     boid.velocity = clamp(boid.velocity, maxSpeed);
     
@@ -18,22 +35,68 @@ void Behavior::Perform(float deltaTime, Boid& boid, const vector<Boid>& boids)
 }
 
 
-vector<const Boid*> Behavior::GetNeighbours(const Boid& boid, const vector<Boid>& boids) const
+BoidList Behavior::GetNeighbours(const Boid& boid, const vector<Boid>& boids) const
 {
-    static thread_local vector<const Boid*> neighbours;
-    neighbours.clear();
-    
-    for(const Boid& other : boids) {
-        if(&other != &boid && GetDistanceBetweenSquare(boid.position, other.position) <= viewDistance && GetAngleBetween(boid.velocity, (other.position - boid.position)) <= viewAngle)
-        {
-            neighbours.push_back(&other);
+    BoidList neighbours;
+    const int nearestCount = GetMaxNeighbours();
+    NearestNeighbours nearest(nearestCount);
+
+    // Squared distance to a boid this one sees, negative for any other
+    const auto getVisibleDistance = [this, &boid, &boids](int index)
+    {
+        return IsNeighbour(boid, boids[index]) ? GetDistanceBetweenSquare(boid.position, boids[index].position) : -1.f;
+    };
+
+    const auto tryAdd = [&](int index)
+    {
+        const float distance_2 = getVisibleDistance(index);
+        if(distance_2 < 0.f) {
+            return;
+        }
+
+        if(nearestCount > 0) {
+            nearest.Offer(distance_2, index);
+        } else {
+            neighbours.push_back(&boids[index]);
+        }
+    };
+
+    const bool indexed = boid.neighbourIndex != nullptr && boid.neighbourIndex->IsBuiltFor(&boids, boids.size());
+    if(indexed && nearestCount > 0) {
+        boid.neighbourIndex->QueryNearest(boid.position, GetViewRadius(), getVisibleDistance, nearest);
+    } else if(indexed) {
+        // No scope of its own, rewinding it would take the neighbours growing alongside with it
+        IdList candidates;
+        boid.neighbourIndex->Query(boid.position, GetViewRadius(), candidates);
+
+        for(int index : candidates) {
+            tryAdd(index);
         }
+    } else {
+        for(int index = 0; index < boids.size(); ++index) {
+            tryAdd(index);
+        }
+    }
+
+    if(nearestCount > 0) {
+        nearest.ForEachById([&boids, &neighbours](int index) { neighbours.push_back(&boids[index]); });
     }
 
     return neighbours;
 }
 
-RVector3 Behavior::GetAlignment(const Boid& boid, const vector<const Boid*>& boids) const
+bool Behavior::IsNeighbour(const Boid& boid, const Boid& other) const
+{
+    return &other != &boid && GetDistanceBetweenSquare(boid.position, other.position) <= viewDistance && GetAngleBetween(boid.velocity, (other.position - boid.position)) <= viewAngle;
+}
+
+float Behavior::GetViewRadius() const
+{
+    // IsNeighbour compares the squared distance against viewDistance, so this is the radius it actually sees
+    return std::sqrt(viewDistance);
+}
+
+RVector3 Behavior::GetAlignment(const Boid& boid, const BoidList& boids) const
 {
     if(boids.size() < 1) {
         return RVector3{};
@@ -48,7 +111,7 @@ RVector3 Behavior::GetAlignment(const Boid& boid, const vector<const Boid*>& boi
     return alignment.getUnit();
 }
 
-RVector3 Behavior::GetCohesion(const Boid& boid, const vector<const Boid*>& boids) const
+RVector3 Behavior::GetCohesion(const Boid& boid, const BoidList& boids) const
 {
     if(boids.size() < 1) {
         return RVector3{};
@@ -66,7 +129,7 @@ RVector3 Behavior::GetCohesion(const Boid& boid, const vector<const Boid*>& boid
     return cohesion.getUnit();
 }
 
-RVector3 Behavior::GetSeparation(const Boid& boid, const vector<const Boid*>& boids) const
+RVector3 Behavior::GetSeparation(const Boid& boid, const BoidList& boids) const
 {
     if(boids.size() < 1) {
         return RVector3{};
@@ -79,7 +142,8 @@ RVector3 Behavior::GetSeparation(const Boid& boid, const vector<const Boid*>& bo
         
         const float minDist = minBoidDistance + boid.radius;
         const float minDist_2 = minDist * minDist;
-        if(direction.lengthSquare() > minDist_2) {
+        const float distance_2 = direction.lengthSquare();
+        if(distance_2 > minDist_2 || distance_2 < SEPARATION_EPSILON_2) {
             continue;
         }
 
@@ -89,6 +153,38 @@ RVector3 Behavior::GetSeparation(const Boid& boid, const vector<const Boid*>& bo
     return shift.getUnit();
 }
 
+RVector3 Behavior::GetFlockAttraction(const Boid& boid) const
+{
+    if(flockAttractionWeight <= 0.f || boid.flockOctree == nullptr) {
+        return RVector3{};
+    }
+
+    // The boids in view are cohesion's, the far field starts where the view ends
+    const FarField field = boid.flockOctree->Query(boid.position, GetViewRadius(), flockAttractionRange);
+    if(field.weight <= 0.f) {
+        return RVector3{};
+    }
+
+    return (field.center - boid.position).getUnit();
+}
+
+int Behavior::GetMaxNeighbours() const
+{
+    if(neighbourCap <= 0) {
+        return maxNeighbours;
+    }
+    return maxNeighbours > 0 ? std::min(maxNeighbours, neighbourCap) : neighbourCap;
+}
+
+RVector3 Behavior::GetThrottledAvoidance(Boid& boid) const
+{
+    // Ticks start from the spawn order, so the boids take turns rather than all raycast on the same update
+    if(boid.avoidanceTick++ % static_cast<uint32_t>(std::max(1, avoidanceInterval)) == 0) {
+        boid.avoidance = GetAvoidance(boid);
+    }
+    return boid.avoidance;
+}
+
 RVector3 Behavior::GetAvoidance(const Boid& boid) const
 {
     RVector3 shift;
@@ -103,7 +199,9 @@ RVector3 Behavior::GetAvoidance(const Boid& boid) const
         shift += minPoint - position;
     }
 
-    shift += GetUnobstructedDirection(boid);
+    if(boid.avoidsObstacles) {
+        shift += GetUnobstructedDirection(boid);
+    }
 
     return shift.getUnit();
 }
@@ -114,6 +212,33 @@ RVector3 Behavior::GetUnobstructedDirection(const Boid& boid) const
     RVector3 bestDir;
 
     const RVector3 rayDir = boid.position + (boid.velocity.getUnit() * (obstacleAvoidanceDist + boid.radius));
+
+    if(boid.obstacleField != nullptr && boid.obstacleField->IsReady()) {
+        const RVector3 direction = boid.velocity.getUnit();
+        float distance;
+        RVector3 gradient;
+
+        // Same reach as the ray, only obstacles the boid is heading into are dodged
+        if(boid.obstacleField->Sample(boid.position, distance, gradient) && distance < obstacleAvoidanceDist + boid.radius && direction.dot(gradient) < 0.f) {
+            const RVector3 obstacleSteering = direction.cross({0.f, -1.f, 0.f});
+            bestDir = gradient + obstacleSteering * obstacleDodgeStrength;
+        }
+
+        return bestDir.getUnit();
+    }
+
+    FLOCKING_COUNT(FRAME_COUNTER::RAYCASTS, 1);
+
+    if(boid.obstacleIndex != nullptr) {
+        RVector3 hitPoint;
+        if(boid.obstacleIndex->Raycast(boid.position, rayDir, hitPoint)) {
+            const RVector3 obstacleSteering = boid.velocity.getUnit().cross({0.f, -1.f, 0.f});
+            bestDir = (hitPoint + obstacleSteering * obstacleDodgeStrength) - boid.position;
+        }
+
+        return bestDir.getUnit();
+    }
+
     const RRay ray = {boid.position, rayDir};
 
     RaycastCb cb = {[&bestDir, &position = boid.position, &velocity = boid.velocity, &obstacleDodgeStrength = obstacleDodgeStrength](const RaycastInfo& raycastInfo)
@@ -123,46 +248,102 @@ RVector3 Behavior::GetUnobstructedDirection(const Boid& boid) const
         return 0.0f;
     }};
     
+    // rp3d queries are not thread safe, parallel updates take turns here
+    std::lock_guard<std::mutex> lock(GetPhysicsMutex());
     GetPhysicsWorld().raycast(ray, &cb);
 
     return bestDir.getUnit();
 }
 
 template<typename T>
-vector<const Boid*> Behavior::GetOfBehavior(const vector<const Boid*>& boids) const
+void Behavior::GetOfBehavior(const BoidList& boids, BoidList& boidsOfType) const
 {
-    vector<const Boid*> boidsOfType;
+    boidsOfType.clear();
     for(const Boid* boid : boids) {
-        if(dynamic_cast<T*>(boid->behavior.get()) != nullptr) {
+        if(boid->behavior->GetType() == T::TYPE) {
             boidsOfType.push_back(boid);
         }
     }
+}
+
+RVector3 Behavior::GetAlignment(const NeighbourBuffer& neighbours, const CellSums* far) const
+{
+    const int farCount = far != nullptr ? far->count : 0;
+    if(neighbours.Size() + farCount < 1) {
+        return RVector3{};
+    }
+
+    RVector3 alignment = GetSteeringKernels().sumVelocities(neighbours);
+    if(farCount > 0) {
+        alignment += far->velocity;
+    }
+
+    return alignment.getUnit();
+}
+
+RVector3 Behavior::GetCohesion(const RVector3& position, const NeighbourBuffer& neighbours, const CellSums* far) const
+{
+    const int farCount = far != nullptr ? far->count : 0;
+    if(neighbours.Size() + farCount < 1) {
+        return RVector3{};
+    }
+
+    RVector3 cohesion = GetSteeringKernels().sumPositions(neighbours);
+    if(farCount > 0) {
+        cohesion += far->position;
+    }
+
+    cohesion = (cohesion / static_cast<float>(neighbours.Size() + farCount)) - position;
+    return cohesion.getUnit();
+}
+
+RVector3 Behavior::GetSeparation(const RVector3& position, float radius, const NeighbourBuffer& neighbours) const
+{
+    if(neighbours.Size() < 1) {
+        return RVector3{};
+    }
+
+    const float minDist = minBoidDistance + radius;
+    const float minDist_2 = minDist * minDist;
 
-    return boidsOfType;
+    return GetSteeringKernels().sumSeparation(position, minDist_2, neighbours).getUnit();
 }
 
 // PreyBehavior
 
-void PreyBehavior::Perform(float deltaTime, Boid& boid, const vector<Boid>& boids)
+void PreyBehavior::Perform(float deltaTime, Boid& boid, const vector<Boid>& boids) const
 {
-    const vector<const Boid*> neighbours = GetNeighbours(boid, boids);
-    const vector<const Boid*> friends = GetOfBehavior<PreyBehavior>(neighbours);
-    const vector<const Boid*> enemies = GetOfBehavior<HunterBehavior>(neighbours);
+    ArenaScope scope;
+    BoidList friends;
+    BoidList enemies;
 
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+    const BoidList neighbours = GetNeighbours(boid, boids);
+    FLOCKING_COUNT(FRAME_COUNTER::NEIGHBOURS, neighbours.size());
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::TYPE_FILTERING);
+    GetOfBehavior<PreyBehavior>(neighbours, friends);
+    GetOfBehavior<HunterBehavior>(neighbours, enemies);
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::STEERING);
     const RVector3 alignment = GetAlignment(boid, friends) * alignmentWeight;
     const RVector3 cohesion = GetCohesion(boid, friends) * cohesionWeight;
     const RVector3 separation = GetSeparation(boid, neighbours) * separationWeight;
-    const RVector3 avoidance = GetAvoidance(boid) * avoidanceWeight;
     const RVector3 escape = GetEscape(boid, enemies) * escapeWeight;
+    const RVector3 attraction = GetFlockAttraction(boid) * flockAttractionWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::OBSTACLE_AVOIDANCE);
+    const RVector3 avoidance = GetThrottledAvoidance(boid) * avoidanceWeight;
 
-    const RVector3 acceleration = alignment + cohesion + separation + avoidance + escape;
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::INTEGRATION);
+    const RVector3 acceleration = alignment + cohesion + separation + avoidance + escape + attraction;
     boid.velocity += acceleration.getUnit();
     boid.velocity = clamp(boid.velocity, maxSpeed);
     
     boid.position += boid.velocity * deltaTime;
 }
 
-RVector3 PreyBehavior::GetEscape(const Boid& boid, const vector<const Boid*>& boids) const
+RVector3 PreyBehavior::GetEscape(const Boid& boid, const BoidList& boids) const
 {
     RVector3 escape;
 
@@ -173,25 +354,49 @@ RVector3 PreyBehavior::GetEscape(const Boid& boid, const vector<const Boid*>& bo
     return escape.getUnit();
 }
 
+RVector3 PreyBehavior::GetEscape(const RVector3& position, const NeighbourBuffer& enemies) const
+{
+    RVector3 escape;
+
+    for(int i = 0; i < enemies.Size(); ++i) {
+        escape += position - RVector3{enemies.px[i], enemies.py[i], enemies.pz[i]};
+    }
+
+    return escape.getUnit();
+}
+
 // HunterBehavior
 
-void HunterBehavior::Perform(float deltaTime, Boid& boid, const vector<Boid>& boids)
+void HunterBehavior::Perform(float deltaTime, Boid& boid, const vector<Boid>& boids) const
 {
-    const vector<const Boid*> neighbours = GetNeighbours(boid, boids);
-    const vector<const Boid*> friends = GetOfBehavior<HunterBehavior>(neighbours);
-    const vector<const Boid*> targets = GetOfBehavior<PreyBehavior>(neighbours);
+    ArenaScope scope;
+    BoidList friends;
+    BoidList targets;
+
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+    const BoidList neighbours = GetNeighbours(boid, boids);
+    FLOCKING_COUNT(FRAME_COUNTER::NEIGHBOURS, neighbours.size());
 
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::TYPE_FILTERING);
+    GetOfBehavior<HunterBehavior>(neighbours, friends);
+    GetOfBehavior<PreyBehavior>(neighbours, targets);
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::STEERING);
     const RVector3 separation = GetSeparation(boid, friends) * separationWeight;
     const RVector3 hunting = GetHunting(boid, targets) * huntingWeight;
-    const RVector3 avoidance = GetAvoidance(boid) * avoidanceWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::OBSTACLE_AVOIDANCE);
+    const RVector3 avoidance = GetThrottledAvoidance(boid) * avoidanceWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::INTEGRATION);
     RVector3 velocityAcceleration = (hunting + separation + avoidance);
 
     ApplyEnergy(deltaTime, boid, velocityAcceleration);
     boid.position += boid.velocity * deltaTime;
 
     if(TryEat(boid, targets)) {
-        ++targetsEaten;
-        energy += eatEnergy;
+        ++boid.hunter.targetsEaten;
+        boid.hunter.energy += eatEnergy;
         boid.radius *= 1.1f;
     }
 
@@ -200,27 +405,29 @@ void HunterBehavior::Perform(float deltaTime, Boid& boid, const vector<Boid>& bo
     }
 }
 
-void HunterBehavior::ApplyEnergy(float deltaTime, Boid& boid, RVector3& velocityAcceleration)
+void HunterBehavior::ApplyEnergy(float deltaTime, Boid& boid, RVector3& velocityAcceleration) const
 {
-    if(energy > 0) {
+    HunterState& state = boid.hunter;
+
+    if(state.energy > 0) {
         const float accelerationDt = acceleration * deltaTime;
-        energy = std::max(0.f, energy - accelerationDt);
-        speed = std::clamp(speed + accelerationDt, 1.f, acceleratedMaxSpeed);
+        state.energy = std::max(0.f, state.energy - accelerationDt);
+        state.speed = std::clamp(state.speed + accelerationDt, 1.f, acceleratedMaxSpeed);
 
         velocityAcceleration = velocityAcceleration.getUnit() * (1 + accelerationDt);
     } else {
-        speed = std::clamp(speed, 1.f, maxSpeed);
+        state.speed = std::clamp(state.speed, 1.f, maxSpeed);
     }
 
     constexpr static int MULTIPLIER = 100;
-    boid.velocity += velocityAcceleration / ((timeDominating * MULTIPLIER) + 1);
-    boid.velocity = boid.velocity.getUnit() * speed;
+    boid.velocity += velocityAcceleration / ((state.timeDominating * MULTIPLIER) + 1);
+    boid.velocity = boid.velocity.getUnit() * state.speed;
 
-    timeDominating = std::max(0.f, timeDominating - deltaTime);
+    state.timeDominating = std::max(0.f, state.timeDominating - deltaTime);
 }
 
 
-RVector3 HunterBehavior::GetHunting(const Boid& boid, const vector<const Boid*>& boids) const
+RVector3 HunterBehavior::GetHunting(const Boid& boid, const BoidList& boids) const
 {
     const Boid* bestTarget = nullptr;
     float bestDist_2 = std::numeric_limits<float>::max();
@@ -241,7 +448,7 @@ RVector3 HunterBehavior::GetHunting(const Boid& boid, const vector<const Boid*>&
     return hunting.getUnit();
 }
 
-bool HunterBehavior::TryEat(const Boid& boid, const vector<const Boid*>& boids) const
+bool HunterBehavior::TryEat(const Boid& boid, const BoidList& boids) const
 {
     for(const Boid* other : boids) {
         if(GetDistanceBetweenSquare(boid.position, other->position) <= boid.radius + eatDistance) {
@@ -253,12 +460,48 @@ bool HunterBehavior::TryEat(const Boid& boid, const vector<const Boid*>& boids)
     return false;
 }
 
-bool HunterBehavior::TryConvert(Boid& boid)
+bool HunterBehavior::TryConvert(Boid& boid) const
 {
-    if(targetsEaten < maxTargetEaten) {
+    // Only a FlockingSimulation wires convertTo, a hunter on its own stays one rather than lose its behavior
+    if(convertTo == nullptr || boid.hunter.targetsEaten < maxTargetEaten) {
         return false;
     }
     
-    boid.behavior = std::make_unique<PreyBehavior>();
+    boid.behavior = convertTo;
     return true;
 }
+
+RVector3 HunterBehavior::GetHunting(const RVector3& position, const NeighbourBuffer& targets) const
+{
+    int bestTarget = -1;
+    float bestDist_2 = std::numeric_limits<float>::max();
+
+    for(int i = 0; i < targets.Size(); ++i) {
+        const float distance = GetDistanceBetweenSquare(position, RVector3{targets.px[i], targets.py[i], targets.pz[i]});
+        if(distance < bestDist_2) {
+            bestTarget = i;
+            bestDist_2 = distance;
+        }
+    }
+
+    if(bestTarget < 0) {
+        return RVector3{};
+    }
+
+    const RVector3 targetPosition = {targets.px[bestTarget], targets.py[bestTarget], targets.pz[bestTarget]};
+    const RVector3 targetVelocity = {targets.vx[bestTarget], targets.vy[bestTarget], targets.vz[bestTarget]};
+    const RVector3 hunting = (targetPosition - position).getUnit() + targetVelocity.getUnit() * preyVelocityWeight;
+    return hunting.getUnit();
+}
+
+bool HunterBehavior::TryEat(const Boid& boid, const NeighbourBuffer& targets, int& eatenId) const
+{
+    for(int i = 0; i < targets.Size(); ++i) {
+        if(GetDistanceBetweenSquare(boid.position, RVector3{targets.px[i], targets.py[i], targets.pz[i]}) <= boid.radius + eatDistance) {
+            eatenId = targets.id[i];
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -6,34 +6,60 @@
 
 #include "BehaviorTypes.h"
 #include "DefaultBehaviorParams.h"
+#include "FrameArena.h"
 
 using std::vector;
 struct Boid;
+struct NeighbourBuffer;
+struct CellSums;
 
+// Neighbour and filter lists of a single Perform, they live in the frame arena
+using BoidList = ArenaVector<const Boid*>;
+
+// Behaviors are flyweights: one instance per type holds the tuning shared by every boid of that type,
+// whatever changes per boid lives in the Boid itself
 class Behavior
 {
 public:
     virtual ~Behavior() = default;
-    virtual void Perform(float deltaTime, Boid& boid, const vector<Boid>& boids);
+    virtual void Perform(float deltaTime, Boid& boid, const vector<Boid>& boids) const;
     virtual BEHAVIOR_TYPE GetType() const
     {
-        return BEHAVIOR_TYPE::DEFAULT;
+        return TYPE;
     }
+
+    constexpr static BEHAVIOR_TYPE TYPE = BEHAVIOR_TYPE::DEFAULT;
 #ifndef DEBUG
 // protected:
 #endif
-    virtual vector<const Boid*> GetNeighbours(const Boid& boid, const vector<Boid>& boids) const;
-    virtual RVector3 GetAlignment(const Boid& boid, const vector<const Boid*>& boids) const;
-    virtual RVector3 GetCohesion(const Boid& boid, const vector<const Boid*>& boids) const;
-    virtual RVector3 GetSeparation(const Boid& boid, const vector<const Boid*>& boids) const;
+    virtual BoidList GetNeighbours(const Boid& boid, const vector<Boid>& boids) const;
+    bool IsNeighbour(const Boid& boid, const Boid& other) const;
+    float GetViewRadius() const;
+    virtual RVector3 GetAlignment(const Boid& boid, const BoidList& boids) const;
+    virtual RVector3 GetCohesion(const Boid& boid, const BoidList& boids) const;
+    virtual RVector3 GetSeparation(const Boid& boid, const BoidList& boids) const;
     virtual RVector3 GetAvoidance(const Boid& boid) const;
+    // GetAvoidance every avoidanceInterval updates of the boid, the last result in between
+    RVector3 GetThrottledAvoidance(Boid& boid) const;
+    // Towards the flocks beyond the view, within flockAttractionRange, see FlockOctree
+    RVector3 GetFlockAttraction(const Boid& boid) const;
     virtual RVector3 GetUnobstructedDirection(const Boid& boid) const;
 
+    // Keeps the boids whose behavior is exactly T, compared by type tag
     template<typename T>
-    vector<const Boid*> GetOfBehavior(const vector<const Boid*>& boids) const;
+    void GetOfBehavior(const BoidList& boids, BoidList& boidsOfType) const;
+
+    // STORAGE_MODE::SOA counterparts reading the gathered neighbour lanes, far adds the neighbours only known by their sums
+    RVector3 GetAlignment(const NeighbourBuffer& neighbours, const CellSums* far = nullptr) const;
+    RVector3 GetCohesion(const RVector3& position, const NeighbourBuffer& neighbours, const CellSums* far = nullptr) const;
+    RVector3 GetSeparation(const RVector3& position, float radius, const NeighbourBuffer& neighbours) const;
 
     float viewDistance = DefaultBehaviorParams::VIEW_DISTANCE;
     float viewAngle = DefaultBehaviorParams::VIEW_ANGLE;
+    // Topological neighbourhood: only the maxNeighbours nearest of the visible boids count, 0 counts all of them
+    int maxNeighbours = DefaultBehaviorParams::MAX_NEIGHBOURS;
+    // maxNeighbours as lowered by neighbourCap
+    int GetMaxNeighbours() const;
     
     float maxSpeed = DefaultBehaviorParams::MAX_SPEED;
     float minBoidDistance = DefaultBehaviorParams::MIN_BOID_DISTANCE;
@@ -44,21 +70,31 @@ public:
     float cohesionWeight = DefaultBehaviorParams::COHESION_WEIGHT;
     float separationWeight = DefaultBehaviorParams::SEPARATION_WEIGHT;
     float avoidanceWeight = DefaultBehaviorParams::AVOIDANCE_WEIGHT;
+    float flockAttractionWeight = DefaultBehaviorParams::FLOCK_ATTRACTION_WEIGHT;
+    float flockAttractionRange = DefaultBehaviorParams::FLOCK_ATTRACTION_RANGE;
+
+    // Set by the frame budget governor of the simulation, not tuning: at most neighbourCap neighbours count (0 for no cap)
+    // and the obstacles are looked for every avoidanceInterval updates
+    int neighbourCap = 0;
+    int avoidanceInterval = 1;
 };
 
 class PreyBehavior : public Behavior
 {
 public:
-    void Perform(float deltaTime, Boid& boid, const vector<Boid>& boids) override;
+    void Perform(float deltaTime, Boid& boid, const vector<Boid>& boids) const override;
     BEHAVIOR_TYPE GetType() const override
     {
-        return BEHAVIOR_TYPE::PREY;
+        return TYPE;
     }
+
+    constexpr static BEHAVIOR_TYPE TYPE = BEHAVIOR_TYPE::PREY;
     
 #ifndef DEBUG
 // protected:
 #endif
-    virtual RVector3 GetEscape(const Boid& boid, const vector<const Boid*>& boids) const;
+    virtual RVector3 GetEscape(const Boid& boid, const BoidList& boids) const;
+    RVector3 GetEscape(const RVector3& position, const NeighbourBuffer& enemies) const;
 
     float escapeWeight = DefaultPreyBehaviorParams::ESCAPE_WEIGHT;
 };
@@ -73,19 +109,23 @@ public:
 
     BEHAVIOR_TYPE GetType() const override
     {
-        return BEHAVIOR_TYPE::HUNTER;
+        return TYPE;
     }
+
+    constexpr static BEHAVIOR_TYPE TYPE = BEHAVIOR_TYPE::HUNTER;
     
-    void Perform(float deltaTime, Boid& boid, const vector<Boid>& boids) override;
+    void Perform(float deltaTime, Boid& boid, const vector<Boid>& boids) const override;
 
     
 #ifndef DEBUG
 // protected:
 #endif
-    void ApplyEnergy(float deltaTime, Boid& boid, RVector3& acceleration);
-    RVector3 GetHunting(const Boid& boid, const vector<const Boid*>& boids) const;
-    bool TryEat(const Boid& boid, const vector<const Boid*>& boids) const;
-    bool TryConvert(Boid& boid);
+    void ApplyEnergy(float deltaTime, Boid& boid, RVector3& acceleration) const;
+    RVector3 GetHunting(const Boid& boid, const BoidList& boids) const;
+    bool TryEat(const Boid& boid, const BoidList& boids) const;
+    RVector3 GetHunting(const RVector3& position, const NeighbourBuffer& targets) const;
+    bool TryEat(const Boid& boid, const NeighbourBuffer& targets, int& eatenId) const;
+    bool TryConvert(Boid& boid) const;
 
     float acceleratedMaxSpeed = DefaultHunterBehaviorParams::ACCELERATED_MAX_SPEED;
     
@@ -93,14 +133,12 @@ public:
     float preyVelocityWeight = DefaultHunterBehaviorParams::PREY_VELOCITY_WEIGHT;
     float eatDistance = DefaultHunterBehaviorParams::EAT_DISTANCE;
 
-    float speed = DefaultHunterBehaviorParams::SPEED;
     float acceleration = DefaultHunterBehaviorParams::ACCELERATION;
-    float energy = DefaultHunterBehaviorParams::ENERGY;
     float eatEnergy = DefaultHunterBehaviorParams::EAT_ENERGY;
-    float timeDominating = DefaultHunterBehaviorParams::TIME_DOMINATING;
 
     int maxTargetEaten = DefaultHunterBehaviorParams::MAX_TARGETS_EATEN;
 
-    int targetsEaten = 0;
+    // What a hunter becomes once it has eaten maxTargetEaten targets
+    const PreyBehavior* convertTo = nullptr;
 };
 #endif
\ No newline at end of file
@@ -5,4 +5,6 @@ enum class BEHAVIOR_TYPE
     DEFAULT,
     PREY,
     HUNTER
-};
\ No newline at end of file
+};
+
+constexpr int BEHAVIOR_TYPE_COUNT = 3;
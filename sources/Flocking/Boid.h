@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "pch.h"
 #include "Behavior.h"
+#include "DefaultBehaviorParams.h"
 
 #ifndef BOID
 #define BOID
@@ -8,7 +9,10 @@
 using std::vector;
 
 class Behavior;
-using BehaviorPtr = std::unique_ptr<Behavior>;
+class FlockOctree;
+class INeighbourIndex;
+class ObstacleIndex;
+class ObstacleField;
 
 enum class STATUS
 {
@@ -16,6 +20,15 @@ enum class STATUS
     DEAD
 };
 
+// Per-boid part of HunterBehavior
+struct HunterState
+{
+    float speed = DefaultHunterBehaviorParams::SPEED;
+    float energy = DefaultHunterBehaviorParams::ENERGY;
+    float timeDominating = DefaultHunterBehaviorParams::TIME_DOMINATING;
+    int targetsEaten = 0;
+};
+
 struct Boid
 {
     void Update(float deltaTime, const vector<Boid>&);
@@ -25,13 +38,31 @@ struct Boid
 
     const RVector3* minPoint;
     const RVector3* maxPoint;
+    const INeighbourIndex* neighbourIndex = nullptr;
+    // Empty while no behavior weighs the flock attraction
+    const FlockOctree* flockOctree = nullptr;
+    // Null raycasts against the physics world instead
+    const ObstacleIndex* obstacleIndex = nullptr;
+    // Used over the index once it is ready
+    const ObstacleField* obstacleField = nullptr;
     
     RVector3 position;
     RVector3 velocity;
+    // Position before the last update, rendering interpolates from it
+    RVector3 previousPosition;
+    // Last Behavior::GetAvoidance and the updates counted towards the next one, see Behavior::avoidanceInterval
+    RVector3 avoidance;
+    uint32_t avoidanceTick = 0;
+    // Updates counted towards the next steering turn, see FlockingSimulation::SetTimeSlices
+    uint32_t steeringTick = 0;
+    // Cleared while the boid is in a distance band without raycasts, see FlockingSimulation::SetObservers
+    bool avoidsObstacles = true;
 
     float radius = 0.5f;
 
-    BehaviorPtr behavior;
+    // Shared flyweight owned by the simulation
+    const Behavior* behavior = nullptr;
+    HunterState hunter;
     mutable STATUS status = STATUS::ALIVE;
 };
 
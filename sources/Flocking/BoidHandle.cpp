@@ -0,0 +1,122 @@
+﻿#include "pch.h"
+#include "BoidHandle.h"
+
+void BoidSlots::Clear()
+{
+    for(uint32_t slot : slotOfId) {
+        Slot& entry = slots[slot];
+        entry.id = -1;
+        ++entry.generation;
+        freeSlots.push_back(slot);
+    }
+
+    slotOfId.clear();
+}
+
+BoidHandle BoidSlots::PushBack()
+{
+    return PushBack(Reserve());
+}
+
+BoidHandle BoidSlots::PushBack(BoidHandle reserved)
+{
+    // A reserved slot is off the free list with no boid, Clear and Release leave it alone
+    if(reserved.slot >= slots.size() || slots[reserved.slot].generation != reserved.generation || slots[reserved.slot].id >= 0) {
+        reserved = Reserve();
+    }
+
+    Slot& entry = slots[reserved.slot];
+    entry.id = static_cast<int>(slotOfId.size());
+    slotOfId.push_back(reserved.slot);
+
+    return reserved;
+}
+
+BoidHandle BoidSlots::Reserve()
+{
+    uint32_t slot;
+    if(freeSlots.empty()) {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+        // Every slot can be free at once, growing the free list here keeps Release, which runs mid-update, off the heap
+        freeSlots.reserve(slots.capacity());
+    } else {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    return {slot, slots[slot].generation};
+}
+
+void BoidSlots::Release(int id)
+{
+    const uint32_t slot = slotOfId[id];
+    Slot& entry = slots[slot];
+
+    entry.id = -1;
+    ++entry.generation;
+    freeSlots.push_back(slot);
+    slotOfId[id] = BoidHandle::INVALID_SLOT;
+}
+
+void BoidSlots::Move(int from, int to)
+{
+    const uint32_t slot = slotOfId[from];
+    slotOfId[to] = slot;
+    slots[slot].id = to;
+}
+
+void BoidSlots::Permute(const vector<int>& order)
+{
+    for(size_t id = 0; id < order.size(); ++id) {
+        slots[slotOfId[order[id]]].id = static_cast<int>(id);
+    }
+
+    // The ids of the slots are already the new ones, so slotOfId is rebuilt from them without a copy
+    for(uint32_t slot = 0; slot < slots.size(); ++slot) {
+        if(slots[slot].id >= 0) {
+            slotOfId[slots[slot].id] = slot;
+        }
+    }
+}
+
+void BoidSlots::Resize(size_t size)
+{
+    slotOfId.resize(size);
+}
+
+size_t BoidSlots::Size() const
+{
+    return slotOfId.size();
+}
+
+int BoidSlots::Find(BoidHandle handle) const
+{
+    if(handle.slot >= slots.size()) {
+        return -1;
+    }
+
+    const Slot& entry = slots[handle.slot];
+    return entry.generation == handle.generation ? entry.id : -1;
+}
+
+BoidHandle BoidSlots::GetHandle(int id) const
+{
+    const uint32_t slot = slotOfId[id];
+    return {slot, slots[slot].generation};
+}
+
+uint32_t BoidSlots::GetSlot(int id) const
+{
+    return slotOfId[id];
+}
+
+int BoidSlots::GetId(uint32_t slot) const
+{
+    return slots[slot].id;
+}
+
+size_t BoidSlots::GetSlotCount() const
+{
+    return slots.size();
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// Stable reference to a boid. Ids change whenever dead boids are compacted away, handles do not,
+// and a handle to a removed boid stays invalid even once its slot is reused
+struct BoidHandle
+{
+    bool operator ==(const BoidHandle& other) const
+    {
+        return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator !=(const BoidHandle& other) const
+    {
+        return !(*this == other);
+    }
+
+    constexpr static uint32_t INVALID_SLOT = UINT32_MAX;
+
+    uint32_t slot = INVALID_SLOT;
+    uint32_t generation = 0;
+};
+
+// Slot map from handles to the dense boid ids, kept in step with vector<Boid> the same way BoidStorage is
+class BoidSlots
+{
+public:
+    void Clear();
+
+    // Handle of the boid appended at id Size()
+    BoidHandle PushBack();
+    // The boid appended at id Size() takes a handle from Reserve, a fresh one if it is no longer reserved
+    BoidHandle PushBack(BoidHandle reserved);
+    // Takes a slot for a boid appended later, the handle resolves to nothing until then
+    BoidHandle Reserve();
+    // The boid at id stops existing, its handle no longer resolves
+    void Release(int id);
+    void Move(int from, int to);
+    // Id i takes the boid that was at order[i], every handle keeps resolving to its boid
+    void Permute(const vector<int>& order);
+    void Resize(size_t size);
+
+    size_t Size() const;
+    // -1 when the handle was never issued or its boid is gone
+    int Find(BoidHandle handle) const;
+    BoidHandle GetHandle(int id) const;
+
+    uint32_t GetSlot(int id) const;
+    // -1 when the slot is free
+    int GetId(uint32_t slot) const;
+    size_t GetSlotCount() const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    struct Slot
+    {
+        int id = -1;
+        uint32_t generation = 0;
+    };
+
+    vector<Slot> slots;
+    vector<uint32_t> freeSlots;
+    // Slot of every id
+    vector<uint32_t> slotOfId;
+};
@@ -0,0 +1,235 @@
+﻿#include "pch.h"
+#include "BoidStorage.h"
+
+void BoidStorage::Clear()
+{
+    Resize(0);
+}
+
+void BoidStorage::Reserve(size_t capacity)
+{
+    px.reserve(capacity);
+    py.reserve(capacity);
+    pz.reserve(capacity);
+    vx.reserve(capacity);
+    vy.reserve(capacity);
+    vz.reserve(capacity);
+    radius.reserve(capacity);
+    type.reserve(capacity);
+    status.reserve(capacity);
+}
+
+void BoidStorage::Resize(size_t size)
+{
+    px.resize(size);
+    py.resize(size);
+    pz.resize(size);
+    vx.resize(size);
+    vy.resize(size);
+    vz.resize(size);
+    radius.resize(size);
+    type.resize(size);
+    status.resize(size);
+}
+
+void BoidStorage::Assign(const vector<Boid>& boids)
+{
+    Clear();
+    Reserve(boids.size());
+
+    for(const Boid& boid : boids) {
+        PushBack(boid);
+    }
+}
+
+void BoidStorage::PushBack(const Boid& boid)
+{
+    px.push_back(boid.position.x);
+    py.push_back(boid.position.y);
+    pz.push_back(boid.position.z);
+    vx.push_back(boid.velocity.x);
+    vy.push_back(boid.velocity.y);
+    vz.push_back(boid.velocity.z);
+    radius.push_back(boid.radius);
+    type.push_back(boid.behavior->GetType());
+    status.push_back(boid.status);
+}
+
+void BoidStorage::Store(int id, const Boid& boid)
+{
+    px[id] = boid.position.x;
+    py[id] = boid.position.y;
+    pz[id] = boid.position.z;
+    vx[id] = boid.velocity.x;
+    vy[id] = boid.velocity.y;
+    vz[id] = boid.velocity.z;
+    radius[id] = boid.radius;
+    status[id] = boid.status;
+}
+
+void BoidStorage::StoreMotion(int id, const Boid& boid)
+{
+    px[id] = boid.position.x;
+    py[id] = boid.position.y;
+    pz[id] = boid.position.z;
+    vx[id] = boid.velocity.x;
+    vy[id] = boid.velocity.y;
+    vz[id] = boid.velocity.z;
+}
+
+void BoidStorage::SwapMotion(BoidStorage& other)
+{
+    px.swap(other.px);
+    py.swap(other.py);
+    pz.swap(other.pz);
+    vx.swap(other.vx);
+    vy.swap(other.vy);
+    vz.swap(other.vz);
+}
+
+void BoidStorage::Move(int from, int to)
+{
+    px[to] = px[from];
+    py[to] = py[from];
+    pz[to] = pz[from];
+    vx[to] = vx[from];
+    vy[to] = vy[from];
+    vz[to] = vz[from];
+    radius[to] = radius[from];
+    type[to] = type[from];
+    status[to] = status[from];
+}
+
+void BoidStorage::Permute(const vector<int>& order, BoidStorage& scratch)
+{
+    scratch.Resize(Size());
+
+    for(size_t to = 0; to < order.size(); ++to) {
+        const int from = order[to];
+        scratch.px[to] = px[from];
+        scratch.py[to] = py[from];
+        scratch.pz[to] = pz[from];
+        scratch.vx[to] = vx[from];
+        scratch.vy[to] = vy[from];
+        scratch.vz[to] = vz[from];
+        scratch.radius[to] = radius[from];
+        scratch.type[to] = type[from];
+        scratch.status[to] = status[from];
+    }
+
+    SwapMotion(scratch);
+    radius.swap(scratch.radius);
+    type.swap(scratch.type);
+    status.swap(scratch.status);
+}
+
+size_t BoidStorage::Size() const
+{
+    return px.size();
+}
+
+RVector3 BoidStorage::GetPosition(int id) const
+{
+    return {px[id], py[id], pz[id]};
+}
+
+PositionLanes BoidStorage::GetPositionLanes() const
+{
+    return {px.data(), py.data(), pz.data(), static_cast<int>(Size())};
+}
+
+RVector3 BoidStorage::GetVelocity(int id) const
+{
+    return {vx[id], vy[id], vz[id]};
+}
+
+// TypePartitions
+
+void TypePartitions::Build(const BoidStorage& storage)
+{
+    // Any group may end up holding every boid, reserving for that keeps rebuilds off the heap while types change
+    for(vector<int>& group : ids) {
+        group.clear();
+        group.reserve(storage.Size());
+    }
+
+    for(int id = 0; id < storage.Size(); ++id) {
+        ids[static_cast<int>(storage.type[id])].push_back(id);
+    }
+}
+
+const vector<int>& TypePartitions::Of(BEHAVIOR_TYPE behaviorType) const
+{
+    return ids[static_cast<int>(behaviorType)];
+}
+
+// NeighbourBuffer
+
+void NeighbourBuffer::Clear()
+{
+    id.clear();
+    px.clear();
+    py.clear();
+    pz.clear();
+    vx.clear();
+    vy.clear();
+    vz.clear();
+    type.clear();
+}
+
+void NeighbourBuffer::Reserve(size_t capacity)
+{
+    id.reserve(capacity);
+    px.reserve(capacity);
+    py.reserve(capacity);
+    pz.reserve(capacity);
+    vx.reserve(capacity);
+    vy.reserve(capacity);
+    vz.reserve(capacity);
+    type.reserve(capacity);
+}
+
+void NeighbourBuffer::Add(const BoidStorage& storage, int other)
+{
+    id.push_back(other);
+    px.push_back(storage.px[other]);
+    py.push_back(storage.py[other]);
+    pz.push_back(storage.pz[other]);
+    vx.push_back(storage.vx[other]);
+    vy.push_back(storage.vy[other]);
+    vz.push_back(storage.vz[other]);
+    type.push_back(storage.type[other]);
+}
+
+void NeighbourBuffer::Filter(const NeighbourBuffer& source, BEHAVIOR_TYPE behaviorType)
+{
+    Clear();
+    Reserve(source.Size());
+
+    for(int i = 0; i < source.Size(); ++i) {
+        if(source.type[i] != behaviorType) {
+            continue;
+        }
+
+        id.push_back(source.id[i]);
+        px.push_back(source.px[i]);
+        py.push_back(source.py[i]);
+        pz.push_back(source.pz[i]);
+        vx.push_back(source.vx[i]);
+        vy.push_back(source.vy[i]);
+        vz.push_back(source.vz[i]);
+        type.push_back(source.type[i]);
+    }
+}
+
+int NeighbourBuffer::Size() const
+{
+    return static_cast<int>(id.size());
+}
+
+void CellSums::Add(const CellSums& other)
+{
+    position += other.position;
+    velocity += other.velocity;
+    count += other.count;
+}
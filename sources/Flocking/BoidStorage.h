@@ -0,0 +1,99 @@
+﻿#pragma once
+#include "AlignedAllocator.h"
+#include "Boid.h"
+#include "FrameArena.h"
+#include "NeighbourIndex.h"
+
+// Structure-of-arrays copy of the hot boid data. In STORAGE_MODE::SOA it is the authoritative state
+// read by the neighbour and steering loops, while vector<Boid> stays as the view holding cold data.
+struct BoidStorage
+{
+    void Clear();
+    void Reserve(size_t capacity);
+    void Resize(size_t size);
+    void Assign(const vector<Boid>& boids);
+    void PushBack(const Boid& boid);
+
+    void Store(int id, const Boid& boid);
+    void StoreMotion(int id, const Boid& boid);
+    void SwapMotion(BoidStorage& other);
+    void Move(int from, int to);
+    // Row i takes what was in row order[i], scratch is left holding the old rows
+    void Permute(const vector<int>& order, BoidStorage& scratch);
+
+    size_t Size() const;
+    RVector3 GetPosition(int id) const;
+    PositionLanes GetPositionLanes() const;
+    RVector3 GetVelocity(int id) const;
+
+    AlignedVector<float> px;
+    AlignedVector<float> py;
+    AlignedVector<float> pz;
+
+    AlignedVector<float> vx;
+    AlignedVector<float> vy;
+    AlignedVector<float> vz;
+
+    AlignedVector<float> radius;
+    AlignedVector<BEHAVIOR_TYPE> type;
+    AlignedVector<STATUS> status;
+};
+
+// Ids of the boids grouped by behavior type, ascending within each group,
+// so every group can be run through its own statically dispatched update
+struct TypePartitions
+{
+    void Build(const BoidStorage& storage);
+
+    const vector<int>& Of(BEHAVIOR_TYPE behaviorType) const;
+
+    vector<int> ids[BEHAVIOR_TYPE_COUNT];
+};
+
+// Neighbours of a single boid gathered into contiguous lanes for the steering loops.
+// The lanes live in the frame arena, so a buffer is only valid inside the ArenaScope it was filled in.
+struct NeighbourBuffer
+{
+    template<typename T>
+    using Lane = ArenaVector<T, 32>;
+
+    void Clear();
+    // Sizes every lane for capacity neighbours, so Add never has to move them
+    void Reserve(size_t capacity);
+    void Add(const BoidStorage& storage, int other);
+    void Filter(const NeighbourBuffer& source, BEHAVIOR_TYPE behaviorType);
+
+    int Size() const;
+
+    Lane<int> id;
+
+    Lane<float> px;
+    Lane<float> py;
+    Lane<float> pz;
+
+    Lane<float> vx;
+    Lane<float> vy;
+    Lane<float> vz;
+
+    Lane<BEHAVIOR_TYPE> type;
+};
+
+// Sums over a group of boids, all alignment and cohesion need to know of them
+struct CellSums
+{
+    void Add(const CellSums& other);
+
+    RVector3 position;
+    RVector3 velocity;
+    int count = 0;
+};
+
+// Per-boid scratch lanes, the neighbours of the boid being updated and their per-type subsets
+struct NeighbourScratch
+{
+    NeighbourBuffer neighbours;
+    NeighbourBuffer friends;
+    NeighbourBuffer enemies;
+    // STEERING_MODE::CELL_AGGREGATES: the neighbours taken from cell sums per type, they are not in the lanes
+    CellSums far[BEHAVIOR_TYPE_COUNT];
+};
@@ -0,0 +1,67 @@
+﻿#include "pch.h"
+#include "CellAggregates.h"
+
+void CellAggregates::Build(const BoidStorage& storage, const RVector3& minPoint, const RVector3& maxPoint, float cellSize)
+{
+    const int count = static_cast<int>(storage.Size());
+    const auto getPosition = [&storage](int id) { return storage.GetPosition(id); };
+    grid.Build(count, getPosition, minPoint, maxPoint, cellSize);
+
+    int occupiedCells = 0;
+    for(size_t cell = 0; cell + 1 < grid.cellStarts.size(); ++cell) {
+        occupiedCells += grid.cellStarts[cell + 1] > grid.cellStarts[cell] ? 1 : 0;
+    }
+
+    // Occupancy falls with the cube of the cell edge
+    const float occupancy = occupiedCells > 0 ? static_cast<float>(count) / occupiedCells : 0.f;
+    if(occupancy > MIN_AGGREGATED) {
+        const float refinement = std::min(std::cbrt(occupancy / MIN_AGGREGATED), MAX_REFINEMENT);
+        grid.Build(count, getPosition, minPoint, maxPoint, cellSize / refinement);
+    }
+
+    const size_t cellCount = grid.cellStarts.size() - 1;
+    sums.assign(cellCount * BEHAVIOR_TYPE_COUNT, CellSums{});
+    for(int id = 0; id < count; ++id) {
+        CellSums& cellSums = sums[grid.cellOfBoid[id] * BEHAVIOR_TYPE_COUNT + static_cast<int>(storage.type[id])];
+        cellSums.position += storage.GetPosition(id);
+        cellSums.velocity += storage.GetVelocity(id);
+        ++cellSums.count;
+    }
+
+    // The grid already lists the boids of a cell in order, the hunters among them keep it
+    hunterStarts.resize(cellCount + 1);
+    hunters.clear();
+    for(size_t cell = 0; cell < cellCount; ++cell) {
+        hunterStarts[cell] = static_cast<int>(hunters.size());
+        if(sums[cell * BEHAVIOR_TYPE_COUNT + static_cast<int>(BEHAVIOR_TYPE::HUNTER)].count == 0) {
+            continue;
+        }
+        for(int i = grid.cellStarts[cell]; i < grid.cellStarts[cell + 1]; ++i) {
+            if(storage.type[grid.indices[i]] == BEHAVIOR_TYPE::HUNTER) {
+                hunters.push_back(grid.indices[i]);
+            }
+        }
+    }
+    hunterStarts[cellCount] = static_cast<int>(hunters.size());
+}
+
+float CellAggregates::GetCellSize() const
+{
+    return grid.GetCellSize();
+}
+
+bool CellAggregates::IsDense(const RVector3& position) const
+{
+    const int cell = grid.GetCellIndex(position);
+    return grid.cellStarts[cell + 1] - grid.cellStarts[cell] >= MIN_AGGREGATED;
+}
+
+bool CellAggregates::IsInView(const RVector3& direction, float viewAngle, float cosViewAngle, const RVector3& offset)
+{
+    if(viewAngle >= 180.f) {
+        return true;
+    }
+
+    // A boid standing still passes every offset, as in the exact test
+    return direction.dot(offset) >= cosViewAngle * direction.length() * offset.length();
+}
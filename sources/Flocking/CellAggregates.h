@@ -0,0 +1,132 @@
+﻿#pragma once
+#include "pch.h"
+#include "BoidStorage.h"
+#include "SpatialGrid.h"
+
+using std::vector;
+
+// How far STEERING_MODE::CELL_AGGREGATES steers from the exact search, mean angles in degrees over the sampled boids
+struct ApproximationError
+{
+    float alignmentDegrees = 0.f;
+    float cohesionDegrees = 0.f;
+    int samples = 0;
+};
+
+// Per cell and boid type sums of the positions and velocities, built once per update for STEERING_MODE::CELL_AGGREGATES.
+// A query takes the cells in view from their sums and hands back only the hunters and the boids of the cells within
+// separation reach or too sparse to be worth a sum, so the work per boid follows the cells in view rather than the boids in them.
+// Cells on the edge of the view count whole when the centroid of the type is in view, that is where the error comes from.
+class CellAggregates
+{
+public:
+    // Cells start at cellSize and shrink while the occupied ones hold more than MIN_AGGREGATED boids on average,
+    // down to MAX_REFINEMENT times smaller, a dense flock then visits one by one only what lies within separation reach
+    void Build(const BoidStorage& storage, const RVector3& minPoint, const RVector3& maxPoint, float cellSize);
+
+    // Adds the sums of every cell in view and farther than nearRadius to far[type], except for hunters,
+    // calls boundary(int id) for every hunter and every boid of the cells closer than nearRadius or under MIN_AGGREGATED boids
+    template<typename Boundary>
+    void Query(const RVector3& position, const RVector3& velocity, float viewRadius, float viewAngle, float nearRadius, CellSums* far, Boundary&& boundary) const;
+
+    float GetCellSize() const;
+    // Whether the cell of position holds enough boids for sums to pay off, sparse parts of the flock are cheaper searched exactly
+    bool IsDense(const RVector3& position) const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    // Same test as Behavior::IsNeighbour for a single offset
+    static bool IsInView(const RVector3& direction, float viewAngle, float cosViewAngle, const RVector3& offset);
+
+    // Below this many boids testing them one by one is cheaper than testing the cell
+    constexpr static int MIN_AGGREGATED = 8;
+    constexpr static float MAX_REFINEMENT = 4.f;
+
+    SpatialGrid grid;
+    // BEHAVIOR_TYPE_COUNT entries per cell
+    vector<CellSums> sums;
+    // Hunters grouped by cell, those of a cell are hunters[hunterStarts[cell]..hunterStarts[cell + 1])
+    vector<int> hunterStarts;
+    vector<int> hunters;
+};
+
+template<typename Boundary>
+void CellAggregates::Query(const RVector3& position, const RVector3& velocity, float viewRadius, float viewAngle, float nearRadius, CellSums* far, Boundary&& boundary) const
+{
+    const float viewRadius_2 = viewRadius * viewRadius;
+    const float nearRadius_2 = nearRadius * nearRadius;
+    const float cosViewAngle = std::cos(AnglesToRadians(viewAngle));
+
+    // Squared distances to the nearest and the farthest point of every slab of cells along each axis,
+    // a cell adds up those of its three slabs. Border cells hold the boids clamped into them, they reach out to infinity
+    int minCoords[3];
+    int maxCoords[3];
+    ArenaVector<float> nearest_2[3];
+    ArenaVector<float> farthest_2[3];
+    for(int axis = 0; axis < 3; ++axis) {
+        minCoords[axis] = grid.GetCellCoord(position[axis] - viewRadius, axis);
+        maxCoords[axis] = grid.GetCellCoord(position[axis] + viewRadius, axis);
+
+        for(int coord = minCoords[axis]; coord <= maxCoords[axis]; ++coord) {
+            const float min = coord > 0 ? grid.origin[axis] + coord * grid.cellSize : -std::numeric_limits<float>::max();
+            const float max = coord < grid.dimensions[axis] - 1 ? grid.origin[axis] + (coord + 1) * grid.cellSize : std::numeric_limits<float>::max();
+            const float outside = std::max({min - position[axis], 0.f, position[axis] - max});
+            const float across = std::max(position[axis] - min, max - position[axis]);
+            nearest_2[axis].push_back(outside * outside);
+            farthest_2[axis].push_back(across * across);
+        }
+    }
+
+    for(int z = minCoords[2]; z <= maxCoords[2]; ++z) {
+        for(int y = minCoords[1]; y <= maxCoords[1]; ++y) {
+            for(int x = minCoords[0]; x <= maxCoords[0]; ++x) {
+                const int cell = (z * grid.dimensions[1] + y) * grid.dimensions[0] + x;
+                const int begin = grid.cellStarts[cell];
+                const int end = grid.cellStarts[cell + 1];
+                if(end - begin < MIN_AGGREGATED) {
+                    for(int i = begin; i < end; ++i) {
+                        boundary(grid.indices[i]);
+                    }
+                    continue;
+                }
+
+                const int dx = x - minCoords[0];
+                const int dy = y - minCoords[1];
+                const int dz = z - minCoords[2];
+                const float cellNearest_2 = nearest_2[0][dx] + nearest_2[1][dy] + nearest_2[2][dz];
+                if(cellNearest_2 > viewRadius_2) {
+                    continue;
+                }
+
+                // The boid's own cell never qualifies, its nearest distance is 0
+                if(cellNearest_2 <= nearRadius_2 || cellNearest_2 <= 0.f) {
+                    for(int i = begin; i < end; ++i) {
+                        boundary(grid.indices[i]);
+                    }
+                    continue;
+                }
+
+                // Prey flee from every hunter they see on its own, a sum would place it where none is
+                for(int i = hunterStarts[cell]; i < hunterStarts[cell + 1]; ++i) {
+                    boundary(hunters[i]);
+                }
+
+                // Cells reaching past the view count whole when the centroid of the type is in view
+                const bool inRadius = farthest_2[0][dx] + farthest_2[1][dy] + farthest_2[2][dz] <= viewRadius_2;
+                const CellSums* cellSums = &sums[cell * BEHAVIOR_TYPE_COUNT];
+                for(int type = 0; type < BEHAVIOR_TYPE_COUNT; ++type) {
+                    const CellSums& typeSums = cellSums[type];
+                    if(typeSums.count == 0 || type == static_cast<int>(BEHAVIOR_TYPE::HUNTER)) {
+                        continue;
+                    }
+
+                    const RVector3 offset = typeSums.position / static_cast<float>(typeSums.count) - position;
+                    if((inRadius || offset.lengthSquare() <= viewRadius_2) && IsInView(velocity, viewAngle, cosViewAngle, offset)) {
+                        far[type].Add(typeSums);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -4,6 +4,7 @@ struct DefaultBehaviorParams
 {
     constexpr static float VIEW_DISTANCE = 2.5f;
     constexpr static float VIEW_ANGLE = 100.f;
+    constexpr static int MAX_NEIGHBOURS = 0;
     
     constexpr static float MAX_SPEED = 5.f;
     constexpr static float MIN_BOID_DISTANCE = 0.5f;
@@ -14,6 +15,9 @@ struct DefaultBehaviorParams
     constexpr static float COHESION_WEIGHT = 0.02f;
     constexpr static float SEPARATION_WEIGHT = 0.05f;
     constexpr static float AVOIDANCE_WEIGHT = 0.3f;
+    // Off by default, the far field is only built while a behavior weighs it
+    constexpr static float FLOCK_ATTRACTION_WEIGHT = 0.f;
+    constexpr static float FLOCK_ATTRACTION_RANGE = 20.f;
 };
 
 struct DefaultPreyBehaviorParams : DefaultBehaviorParams
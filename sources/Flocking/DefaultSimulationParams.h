@@ -0,0 +1,58 @@
+﻿#pragma once
+#include <cstdint>
+
+#include "SimulationTypes.h"
+
+// What the frame budget governor gives up at one level, see FlockingSimulation::SetFrameBudget
+struct SimulationLod
+{
+    // Behavior::neighbourCap, 0 for none
+    int neighbourCap;
+    int avoidanceInterval;
+    // Least FlockingSimulation::SetTimeSlices
+    int timeSlices;
+};
+
+// From distance to the nearest observer on, a boid steers every updateInterval updates, and only looks for
+// obstacles with raycasts (or the field) if raycasts is set. See FlockingSimulation::SetObservers
+struct DistanceBand
+{
+    float distance;
+    int updateInterval;
+    bool raycasts;
+};
+
+struct DefaultSimulationParams
+{
+    constexpr static bool USE_SPATIAL_GRID = true;
+    constexpr static NEIGHBOUR_BACKEND NEIGHBOURS = NEIGHBOUR_BACKEND::GRID;
+    constexpr static float NEIGHBOUR_SKIN = 0.f;
+    constexpr static int SORT_INTERVAL = 0;
+    constexpr static STEERING_MODE STEERING = STEERING_MODE::EXACT;
+    // Coarsest cell edge of STEERING_MODE::CELL_AGGREGATES, as a fraction of the widest view radius
+    constexpr static float AGGREGATE_CELLS_PER_VIEW_RADIUS = 2.f;
+    // Node edge over distance below which FlockOctree takes a node as a whole
+    constexpr static float FLOCK_OPENING_ANGLE = 0.5f;
+    constexpr static STORAGE_MODE STORAGE = STORAGE_MODE::AOS;
+    constexpr static UPDATE_MODE UPDATE = UPDATE_MODE::SEQUENTIAL;
+    constexpr static int WORKER_COUNT = 0;
+    constexpr static int FRAME_STATS_WINDOW = 120;
+    constexpr static uint64_t RANDOM_SEED = 0x5EED;
+    constexpr static OBSTACLE_BACKEND OBSTACLES = OBSTACLE_BACKEND::STATIC_INDEX;
+    constexpr static float OBSTACLE_CELL_SIZE = 4.f;
+    constexpr static float OBSTACLE_FIELD_CELL_SIZE = 0.5f;
+    constexpr static bool OBSTACLE_FIELD_BACKGROUND_BUILD = true;
+    // Milliseconds an update may take before the governor lowers the quality, 0 never does
+    constexpr static float FRAME_BUDGET_MS = 0.f;
+    // Updates averaged before each step up or down a level
+    constexpr static int FRAME_BUDGET_WINDOW = 15;
+    // Share of the budget the mean update has to drop below before a level is given back
+    constexpr static float FRAME_BUDGET_HEADROOM = 0.6f;
+    constexpr static int LOD_LEVEL_COUNT = 6;
+    constexpr static SimulationLod LOD_LEVELS[LOD_LEVEL_COUNT] = {{0, 1, 1}, {16, 1, 1}, {8, 2, 1}, {6, 4, 1}, {6, 4, 2}, {6, 4, 4}};
+    constexpr static int TIME_SLICES = 1;
+    constexpr static bool TIME_SLICE_EXEMPT_HUNTERS = true;
+    constexpr static bool TIME_SLICE_EXEMPT_NEAR_OBSTACLES = true;
+    // By increasing distance, the first always starts at 0
+    constexpr static DistanceBand DISTANCE_BANDS[DISTANCE_BAND_COUNT] = {{0.f, 1, true}, {15.f, 2, true}, {30.f, 4, true}, {60.f, 8, true}};
+};
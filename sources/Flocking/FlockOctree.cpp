@@ -0,0 +1,169 @@
+﻿#include "pch.h"
+#include "FlockOctree.h"
+
+void FlockOctree::Clear()
+{
+    nodes.clear();
+    positions.clear();
+    velocities.clear();
+}
+
+bool FlockOctree::IsEmpty() const
+{
+    return nodes.empty();
+}
+
+void FlockOctree::SetOpeningAngle(float angle)
+{
+    openingAngle = angle;
+}
+
+float FlockOctree::GetOpeningAngle() const
+{
+    return openingAngle;
+}
+
+void FlockOctree::SplitNode(int node, int depth)
+{
+    // Children are appended, so nodes[node] is only read back through its index
+    const int begin = nodes[node].begin;
+    const int end = nodes[node].end;
+    const RVector3 center = nodes[node].center;
+    const float halfSize = nodes[node].halfSize;
+
+    RVector3 positionSum;
+    RVector3 velocitySum;
+
+    if(end - begin <= LEAF_SIZE || depth >= MAX_DEPTH) {
+        for(int i = begin; i < end; ++i) {
+            positionSum += positions[i];
+            velocitySum += velocities[i];
+        }
+    } else {
+        const auto getOctant = [&center](const RVector3& position)
+        {
+            return (position.x >= center.x ? 1 : 0) | (position.y >= center.y ? 2 : 0) | (position.z >= center.z ? 4 : 0);
+        };
+
+        int starts[9] = {};
+        for(int i = begin; i < end; ++i) {
+            ++starts[getOctant(positions[i]) + 1];
+        }
+        for(int octant = 1; octant <= 8; ++octant) {
+            starts[octant] += starts[octant - 1];
+        }
+
+        int cursors[8];
+        std::copy(starts, starts + 8, cursors);
+        for(int i = begin; i < end; ++i) {
+            const int target = begin + cursors[getOctant(positions[i])]++;
+            sortedPositions[target] = positions[i];
+            sortedVelocities[target] = velocities[i];
+        }
+        std::copy(sortedPositions.begin() + begin, sortedPositions.begin() + end, positions.begin() + begin);
+        std::copy(sortedVelocities.begin() + begin, sortedVelocities.begin() + end, velocities.begin() + begin);
+
+        const int firstChild = static_cast<int>(nodes.size());
+        const float childHalfSize = halfSize * 0.5f;
+        for(int octant = 0; octant < 8; ++octant) {
+            if(starts[octant] == starts[octant + 1]) {
+                continue;
+            }
+
+            Node child;
+            child.center = center + RVector3{octant & 1 ? childHalfSize : -childHalfSize, octant & 2 ? childHalfSize : -childHalfSize, octant & 4 ? childHalfSize : -childHalfSize};
+            child.halfSize = childHalfSize;
+            child.begin = begin + starts[octant];
+            child.end = begin + starts[octant + 1];
+            nodes.push_back(child);
+        }
+
+        const int childCount = static_cast<int>(nodes.size()) - firstChild;
+        nodes[node].firstChild = firstChild;
+        nodes[node].childCount = childCount;
+
+        for(int child = firstChild; child < firstChild + childCount; ++child) {
+            SplitNode(child, depth + 1);
+            positionSum += nodes[child].centerOfMass * static_cast<float>(nodes[child].count);
+            velocitySum += nodes[child].velocity * static_cast<float>(nodes[child].count);
+        }
+    }
+
+    Node& built = nodes[node];
+    built.count = end - begin;
+    built.centerOfMass = positionSum / static_cast<float>(built.count);
+    built.velocity = velocitySum / static_cast<float>(built.count);
+}
+
+void FlockOctree::AddPull(FarField& field, const RVector3& center, const RVector3& velocity, float pull)
+{
+    field.center += center * pull;
+    field.velocity += velocity * pull;
+    field.weight += pull;
+}
+
+FarField FlockOctree::Query(const RVector3& position, float nearRadius, float farRadius) const
+{
+    FarField field;
+    if(nodes.empty()) {
+        return field;
+    }
+
+    const float near_2 = nearRadius * nearRadius;
+    const float far_2 = farRadius * farRadius;
+    const float openingAngle_2 = openingAngle * openingAngle;
+    const auto getPull = [farRadius](float distance_2) { return 1.f / std::sqrt(distance_2) - 1.f / farRadius; };
+
+    int stack[8 * MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+
+    while(top > 0) {
+        const Node& node = nodes[stack[--top]];
+
+        float nearest_2 = 0.f;
+        float farthest_2 = 0.f;
+        for(int axis = 0; axis < 3; ++axis) {
+            const float offset = std::abs(position[axis] - node.center[axis]);
+            const float outside = std::max(offset - node.halfSize, 0.f);
+            nearest_2 += outside * outside;
+            farthest_2 += (offset + node.halfSize) * (offset + node.halfSize);
+        }
+
+        // Entirely out of range, or entirely in view where cohesion already counts every boid
+        if(nearest_2 > far_2 || farthest_2 <= near_2) {
+            continue;
+        }
+
+        // A node narrow enough and clear of the view pulls from its center of mass. Those across the view are opened,
+        // they are few and hold the nearest boids, which pull the hardest
+        const float distance_2 = (node.centerOfMass - position).lengthSquare();
+        const float edge = node.halfSize * 2.f;
+        if(nearest_2 > near_2 && edge * edge < openingAngle_2 * distance_2) {
+            if(distance_2 < far_2) {
+                AddPull(field, node.centerOfMass, node.velocity, node.count * getPull(distance_2));
+            }
+            continue;
+        }
+
+        if(node.childCount == 0) {
+            for(int i = node.begin; i < node.end; ++i) {
+                const float boidDistance_2 = (positions[i] - position).lengthSquare();
+                if(boidDistance_2 > near_2 && boidDistance_2 < far_2) {
+                    AddPull(field, positions[i], velocities[i], getPull(boidDistance_2));
+                }
+            }
+            continue;
+        }
+
+        for(int child = node.firstChild; child < node.firstChild + node.childCount; ++child) {
+            stack[top++] = child;
+        }
+    }
+
+    if(field.weight > 0.f) {
+        field.center /= field.weight;
+        field.velocity /= field.weight;
+    }
+    return field;
+}
@@ -0,0 +1,109 @@
+﻿#pragma once
+#include "pch.h"
+#include "DefaultSimulationParams.h"
+
+using std::vector;
+
+// What the boids beyond the view pull towards, see FlockOctree::Query
+struct FarField
+{
+    // Means of the far boids weighted by their pull, weight is the sum of the pulls
+    RVector3 center;
+    RVector3 velocity;
+    float weight = 0.f;
+};
+
+// Barnes–Hut octree over the flock, every node keeps the center of mass and the mean velocity of the boids below it.
+// A query takes a node as a whole once it looks narrower than the opening angle from the query point,
+// so a boid senses the whole flock in O(log n) instead of visiting every boid, and a build is O(n log n).
+class FlockOctree
+{
+public:
+    // Boids for which include(i) holds, getPosition(i) and getVelocity(i) read boid i
+    template<typename Include, typename GetPosition, typename GetVelocity>
+    void Build(int count, Include&& include, GetPosition&& getPosition, GetVelocity&& getVelocity);
+    void Clear();
+    bool IsEmpty() const;
+
+    // Every boid farther than nearRadius pulls with 1 / distance - 1 / farRadius, fading out at farRadius so that
+    // flocks do not jump in and out of range. Nodes whose edge over their distance is below the opening angle pull from their center of mass
+    FarField Query(const RVector3& position, float nearRadius, float farRadius) const;
+
+    // 0 opens every node, the query then sums boid by boid
+    void SetOpeningAngle(float angle);
+    float GetOpeningAngle() const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    constexpr static int LEAF_SIZE = 8;
+    // Boids on the same spot would split forever
+    constexpr static int MAX_DEPTH = 16;
+
+    struct Node
+    {
+        // Cube of the node
+        RVector3 center;
+        float halfSize = 0.f;
+
+        RVector3 centerOfMass;
+        RVector3 velocity;
+        int count = 0;
+
+        // The children are nodes[firstChild, firstChild + childCount), empty octants have none
+        int firstChild = -1;
+        int childCount = 0;
+        // Leaves own positions[begin, end)
+        int begin = 0;
+        int end = 0;
+    };
+
+    void SplitNode(int node, int depth);
+    static void AddPull(FarField& field, const RVector3& center, const RVector3& velocity, float pull);
+
+    vector<Node> nodes;
+    // In tree order, so a leaf reads contiguous memory
+    vector<RVector3> positions;
+    vector<RVector3> velocities;
+    // Where SplitNode sorts a node into its octants
+    vector<RVector3> sortedPositions;
+    vector<RVector3> sortedVelocities;
+
+    float openingAngle = DefaultSimulationParams::FLOCK_OPENING_ANGLE;
+};
+
+template<typename Include, typename GetPosition, typename GetVelocity>
+void FlockOctree::Build(int count, Include&& include, GetPosition&& getPosition, GetVelocity&& getVelocity)
+{
+    Clear();
+
+    RVector3 min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    RVector3 max = -min;
+    for(int i = 0; i < count; ++i) {
+        if(!include(i)) {
+            continue;
+        }
+
+        const RVector3 position = getPosition(i);
+        positions.push_back(position);
+        velocities.push_back(getVelocity(i));
+        for(int axis = 0; axis < 3; ++axis) {
+            min[axis] = std::min(min[axis], position[axis]);
+            max[axis] = std::max(max[axis], position[axis]);
+        }
+    }
+
+    if(positions.empty()) {
+        return;
+    }
+
+    Node root;
+    root.center = (min + max) * 0.5f;
+    root.halfSize = std::max({max.x - min.x, max.y - min.y, max.z - min.z}) * 0.5f;
+    root.end = static_cast<int>(positions.size());
+    nodes.push_back(root);
+
+    sortedPositions.resize(positions.size());
+    sortedVelocities.resize(velocities.size());
+    SplitNode(0, 0);
+}
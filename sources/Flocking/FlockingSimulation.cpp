@@ -1,7 +1,12 @@
 ﻿#include "pch.h"
 #include "FlockingSimulation.h"
+#include "NearestNeighbours.h"
+
+FlockingSimulation::FlockingSimulation()
+{
+    hunterBehavior.convertTo = &preyBehavior;
+}
 
-FlockingSimulation::FlockingSimulation() = default;
 FlockingSimulation::~FlockingSimulation()
 {
     ClearAll();
@@ -11,26 +16,544 @@ void FlockingSimulation::OnInitialize() {}
 
 void FlockingSimulation::OnUpdate(float deltaTime)
 {
+    const auto start = std::chrono::steady_clock::now();
+    // The update's frame, unscoped temporaries of this thread go with it. Worker tasks scope their own
+    ArenaScope frame;
+
+#if FLOCKING_PROFILE
+    // Whatever this thread measured outside of an update is not part of the frame
+    TakeThreadSample();
+#endif
+
+    for(Boid& boid : boids) {
+        boid.previousPosition = boid.position;
+    }
+    activeTimeSlices = std::max(timeSlices, DefaultSimulationParams::LOD_LEVELS[lodLevel].timeSlices);
+
+    PrepareObstacles();
+    PrepareFlockOctree();
+
+    if(updateMode == UPDATE_MODE::PARALLEL) {
+        UpdateParallel(deltaTime);
+    } else if(storageMode == STORAGE_MODE::SOA) {
+        UpdateSoA(deltaTime);
+    } else {
+        UpdateAoS(deltaTime);
+    }
+
+    RemoveDead();
+
+    if(sortInterval > 0 && ++updatesSinceSort >= sortInterval) {
+        SortBoids();
+        updatesSinceSort = 0;
+    }
+
+    UpdateGovernor(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+#if FLOCKING_PROFILE
+    profiler.Submit(0);
+    profiler.EndFrame();
+#endif
+}
+
+void FlockingSimulation::UpdateAoS(float deltaTime)
+{
+    if(useSpatialGrid) {
+        FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+        BuildNeighbourIndexAoS(GetLargestStep(deltaTime));
+    }
+    
     for(int i = 0; i < boids.size(); ++i) {
         Boid& boid = boids[i];
         if(boid.status == STATUS::DEAD) {
             continue;
         }
+
+        if(!TakesSteeringTurn(boid)) {
+            boid.position += boid.velocity * deltaTime;
+            continue;
+        }
        
         boid.Update(deltaTime, boids);
+        FLOCKING_COUNT(FRAME_COUNTER::BOIDS_UPDATED, 1);
+    }
+
+    // Positions have moved, the index is only trusted for the update it was built for
+    neighbourIndex->Invalidate();
+}
+
+void FlockingSimulation::BuildNeighbourIndexAoS(float pendingStep)
+{
+    indexX.resize(boids.size());
+    indexY.resize(boids.size());
+    indexZ.resize(boids.size());
+    for(size_t i = 0; i < boids.size(); ++i) {
+        indexX[i] = boids[i].position.x;
+        indexY[i] = boids[i].position.y;
+        indexZ[i] = boids[i].position.z;
+    }
+
+    neighbourIndex->Build({indexX.data(), indexY.data(), indexZ.data(), static_cast<int>(boids.size())}, minPoint, maxPoint, GetGridCellSize());
+    neighbourIndex->SetSource(&boids, boids.size());
+    // Updated in place, a boid late in the update looks for the others where they are now, not where they were binned
+    neighbourIndex->SetDrift(pendingStep);
+}
+
+void FlockingSimulation::UpdateSoA(float deltaTime)
+{
+    // Updated in place, a boid gathering late in the update already sees the others' new positions
+    PrepareNeighbourSearch(nullptr, GetLargestStep(deltaTime));
+
+    // Updates in place, later ids see the new state of earlier ones, so the order stays by id as in the AoS loop
+    for(int id = 0; id < storage.Size(); ++id) {
+        if(storage.status[id] == STATUS::DEAD) {
+            continue;
+        }
+
+        if(!TakesSteeringTurn(boids[id])) {
+            boids[id].position += boids[id].velocity * deltaTime;
+            storage.Store(id, boids[id]);
+            continue;
+        }
+
+        ArenaScope scope;
+        NeighbourScratch scratch;
+        const int eatenId = UpdateBoidAt(id, scratch, deltaTime);
+        storage.Store(id, boids[id]);
+
+        if(storage.type[id] == BEHAVIOR_TYPE::HUNTER) {
+            ResolveHunterEvent({id, eatenId});
+        }
+    }
+
+    neighbourIndex->Invalidate();
+}
+
+void FlockingSimulation::UpdateParallel(float deltaTime)
+{
+    ThreadPool& pool = GetThreadPool();
+    workers.resize(pool.GetWorkerCount());
+    profiler.SetWorkerCount(pool.GetWorkerCount());
+    for(WorkerState& worker : workers) {
+        worker.hunterEvents.clear();
+    }
+
+    // Gathers read the front buffer, nothing they see moves before the update is over
+    PrepareNeighbourSearch(&pool, 0.f);
+    backStorage.Resize(storage.Size());
+
+    // Every boid reads the front buffer (storage) and writes its own view boid and back buffer slot only,
+    // so each type can run as its own batch without changing the result
+    partitions.Build(storage);
+    UpdatePartition<Behavior>(pool, deltaTime);
+    UpdatePartition<PreyBehavior>(pool, deltaTime);
+    UpdatePartition<HunterBehavior>(pool, deltaTime);
+
+    neighbourIndex->Invalidate();
+    storage.SwapMotion(backStorage);
+
+#if FLOCKING_PROFILE
+    pool.ForEachWorker([this](int, int, int worker) { profiler.Submit(worker); });
+
+    const SchedulerStats scheduler = pool.TakeStats();
+    FLOCKING_COUNT(FRAME_COUNTER::STEALS, scheduler.steals);
+    FLOCKING_COUNT(FRAME_COUNTER::WORKER_BUSY_NANOSECONDS, scheduler.busyNanoseconds);
+    FLOCKING_COUNT(FRAME_COUNTER::WORKER_CAPACITY_NANOSECONDS, scheduler.capacityNanoseconds);
+#endif
+
+    // Stolen ranges land on any worker, hunters are resolved in id order so the outcome does not depend on who ran them
+    hunterEvents.clear();
+    for(const WorkerState& worker : workers) {
+        hunterEvents.insert(hunterEvents.end(), worker.hunterEvents.begin(), worker.hunterEvents.end());
+    }
+    std::sort(hunterEvents.begin(), hunterEvents.end(), [](const HunterEvent& a, const HunterEvent& b) { return a.hunterId < b.hunterId; });
+
+    for(const HunterEvent& event : hunterEvents) {
+        ResolveHunterEvent(event);
+    }
+}
+
+void FlockingSimulation::PrepareNeighbourSearch(ThreadPool* pool, float pendingStep)
+{
+    if(steeringMode == STEERING_MODE::CELL_AGGREGATES) {
+        FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+        cellAggregates.Build(storage, minPoint, maxPoint, GetMaxViewRadius() / DefaultSimulationParams::AGGREGATE_CELLS_PER_VIEW_RADIUS);
+    }
+
+    if(neighbourSkin <= 0.f) {
+        if(useSpatialGrid) {
+            FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+            neighbourIndex->Build(storage.GetPositionLanes(), minPoint, maxPoint, GetGridCellSize());
+            neighbourIndex->SetDrift(pendingStep);
+        }
+        return;
+    }
+
+    bool rebuild;
+    {
+        FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+        rebuild = neighbourLists.NeedsRebuild(storage, slots, GetMaxViewRadius() + neighbourSkin, neighbourSkin, pendingStep);
+    }
+
+    if(rebuild) {
+        RebuildNeighbourLists(pool);
+    }
+}
+
+void FlockingSimulation::RebuildNeighbourLists(ThreadPool* pool)
+{
+    const float radius = GetMaxViewRadius() + neighbourSkin;
+    const float radius_2 = radius * radius;
+    const int count = static_cast<int>(storage.Size());
+
+    // Sized for half the radius, grid cells then visit less empty volume around the wider list sphere
+    if(useSpatialGrid) {
+        FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+        neighbourIndex->Build(storage.GetPositionLanes(), minPoint, maxPoint, radius * 0.5f);
+    }
+
+    neighbourLists.BeginRebuild(storage, slots, radius, pool != nullptr ? pool->GetWorkerCount() : 1);
+
+    // Only a distance test, the view cone is left to the gathers as velocities change every update
+    const auto forEachCandidate = [this, radius, radius_2](int id, auto&& visitor)
+    {
+        const RVector3 position = storage.GetPosition(id);
+        const auto test = [&](int other)
+        {
+            const float dx = storage.px[other] - position.x;
+            const float dy = storage.py[other] - position.y;
+            const float dz = storage.pz[other] - position.z;
+            if(other != id && dx * dx + dy * dy + dz * dz <= radius_2) {
+                visitor(other);
+            }
+        };
+
+        if(useSpatialGrid) {
+            ArenaScope scope;
+            IdList candidates;
+            neighbourIndex->Query(position, radius, candidates);
+            for(int other : candidates) {
+                test(other);
+            }
+        } else {
+            for(int other = 0; other < storage.Size(); ++other) {
+                test(other);
+            }
+        }
+    };
+
+    const auto fill = [this, &forEachCandidate](int begin, int end, int worker)
+    {
+        FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+        for(int id = begin; id < end; ++id) {
+            neighbourLists.Fill(worker, slots.GetSlot(id), [this, id, &forEachCandidate](auto&& add)
+            {
+                forEachCandidate(id, [this, &add](int other) { add(slots.GetSlot(other)); });
+            });
+        }
+    };
+    RunRanges(pool, count, fill);
+
+    neighbourLists.EndRebuild();
+    neighbourIndex->Invalidate();
+    FLOCKING_COUNT(FRAME_COUNTER::NEIGHBOUR_LIST_REBUILDS, 1);
+}
+
+void FlockingSimulation::RunRanges(ThreadPool* pool, int count, const ThreadPool::Task& task)
+{
+    if(pool != nullptr) {
+        pool->ParallelFor(count, task);
+    } else {
+        task(0, count, 0);
     }
+}
+
+void FlockingSimulation::GatherNeighbours(int id, const Behavior& behavior, NeighbourScratch& scratch) const
+{
+    const bool aggregated = steeringMode == STEERING_MODE::CELL_AGGREGATES && storage.type[id] != BEHAVIOR_TYPE::HUNTER && behavior.GetMaxNeighbours() == 0 &&
+                            cellAggregates.IsDense(storage.GetPosition(id));
+    GatherNeighbours(id, behavior, scratch.neighbours, aggregated ? scratch.far : nullptr);
+}
+
+void FlockingSimulation::GatherNeighbours(int id, const Behavior& behavior, NeighbourBuffer& neighbours, CellSums* far) const
+{
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+    neighbours.Clear();
+
+    const RVector3 position = storage.GetPosition(id);
+    const RVector3 velocity = storage.GetVelocity(id);
+    const float velocityLength_2 = velocity.lengthSquare();
+
+    // Same test as Behavior::IsNeighbour, with the acos replaced by a comparison against the cosine
+    const bool seesAround = behavior.viewAngle >= 180.f;
+    const float cosViewAngle = std::cos(AnglesToRadians(behavior.viewAngle));
+
+    // Squared distance to a boid this one sees, negative for any other
+    const auto getVisibleDistance = [&](int other)
+    {
+        if(other == id) {
+            return -1.f;
+        }
+
+        const float dx = storage.px[other] - position.x;
+        const float dy = storage.py[other] - position.y;
+        const float dz = storage.pz[other] - position.z;
+        const float distance_2 = dx * dx + dy * dy + dz * dz;
+        if(distance_2 > behavior.viewDistance) {
+            return -1.f;
+        }
+
+        const float dot = velocity.x * dx + velocity.y * dy + velocity.z * dz;
+        if(!seesAround && dot < cosViewAngle * std::sqrt(velocityLength_2 * distance_2)) {
+            return -1.f;
+        }
+
+        return distance_2;
+    };
+
+    // Topological: only the maxNeighbours nearest are kept, the lanes are sized once they are known
+    const bool topological = behavior.GetMaxNeighbours() > 0;
+    NearestNeighbours nearest(behavior.GetMaxNeighbours());
+    const auto reserve = [&neighbours, topological](size_t candidates)
+    {
+        if(!topological) {
+            neighbours.Reserve(candidates);
+        }
+    };
+
+    const auto tryAdd = [&](int other)
+    {
+        const float distance_2 = getVisibleDistance(other);
+        if(distance_2 < 0.f) {
+            return;
+        }
+
+        if(topological) {
+            nearest.Offer(distance_2, other);
+        } else {
+            neighbours.Add(storage, other);
+        }
+    };
+
+    // Sized for every candidate up front, the lanes are then filled without moving
+    if(far != nullptr) {
+        // Separation needs every boid within its reach one by one, cells that close stay on the edge
+        IdList candidates;
+        cellAggregates.Query(position, velocity, behavior.GetViewRadius(), behavior.viewAngle, behavior.minBoidDistance + storage.radius[id], far,
+            [&candidates](int other) { candidates.push_back(other); });
+        reserve(candidates.size());
+        for(int other : candidates) {
+            tryAdd(other);
+        }
+    } else if(neighbourLists.IsValid()) {
+        const uint32_t slot = slots.GetSlot(id);
+        reserve(neighbourLists.GetCount(slot));
+        for(const uint32_t* candidate = neighbourLists.Begin(slot); candidate != neighbourLists.End(slot); ++candidate) {
+            // Removed since the build when the slot is free
+            const int other = slots.GetId(*candidate);
+            if(other >= 0) {
+                tryAdd(other);
+            }
+        }
+    } else if(useSpatialGrid && topological) {
+        neighbourIndex->QueryNearest(position, behavior.GetViewRadius(), getVisibleDistance, nearest);
+    } else if(useSpatialGrid) {
+        IdList candidates;
+        neighbourIndex->Query(position, behavior.GetViewRadius(), candidates);
+        reserve(candidates.size());
+        for(int other : candidates) {
+            tryAdd(other);
+        }
+    } else {
+        reserve(storage.Size());
+        for(int other = 0; other < storage.Size(); ++other) {
+            tryAdd(other);
+        }
+    }
+
+    if(topological) {
+        neighbours.Reserve(nearest.Size());
+        nearest.ForEachById([this, &neighbours](int other) { neighbours.Add(storage, other); });
+    }
+
+    FLOCKING_COUNT(FRAME_COUNTER::NEIGHBOURS, neighbours.Size());
+    FLOCKING_COUNT(FRAME_COUNTER::BOIDS_UPDATED, 1);
+}
+
+int FlockingSimulation::UpdateBoidAt(int id, NeighbourScratch& scratch, float deltaTime)
+{
+    const Behavior& behavior = *boids[id].behavior;
+    GatherNeighbours(id, behavior, scratch);
+
+    switch(storage.type[id]) {
+    case BEHAVIOR_TYPE::PREY:
+        return UpdateBoidSoA(id, static_cast<const PreyBehavior&>(behavior), scratch, deltaTime);
+    case BEHAVIOR_TYPE::HUNTER:
+        return UpdateBoidSoA(id, static_cast<const HunterBehavior&>(behavior), scratch, deltaTime);
+    default:
+        return UpdateBoidSoA(id, behavior, scratch, deltaTime);
+    }
+}
+
+int FlockingSimulation::UpdateBoidSoA(int id, const Behavior& behavior, NeighbourScratch& scratch, float deltaTime)
+{
+    Boid& boid = boids[id];
+    const NeighbourBuffer& neighbours = scratch.neighbours;
+
+    // Every type counts, hunters never end up in the cell sums
+    CellSums far;
+    for(const CellSums& farOfType : scratch.far) {
+        far.Add(farOfType);
+    }
+
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::STEERING);
+    const RVector3 alignment = behavior.GetAlignment(neighbours, &far) * behavior.alignmentWeight;
+    const RVector3 cohesion = behavior.GetCohesion(boid.position, neighbours, &far) * behavior.cohesionWeight;
+    const RVector3 separation = behavior.GetSeparation(boid.position, boid.radius, neighbours) * behavior.separationWeight;
+    const RVector3 attraction = behavior.GetFlockAttraction(boid) * behavior.flockAttractionWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::OBSTACLE_AVOIDANCE);
+    const RVector3 avoidance = behavior.GetThrottledAvoidance(boid) * behavior.avoidanceWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::INTEGRATION);
+    const RVector3 acceleration = alignment + cohesion + separation + avoidance + attraction;
+    boid.velocity += acceleration.getUnit();
+    boid.velocity = clamp(boid.velocity, behavior.maxSpeed);
+
+    boid.position += boid.velocity * deltaTime;
+    return -1;
+}
+
+int FlockingSimulation::UpdateBoidSoA(int id, const PreyBehavior& behavior, NeighbourScratch& scratch, float deltaTime)
+{
+    Boid& boid = boids[id];
+
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::TYPE_FILTERING);
+    scratch.friends.Filter(scratch.neighbours, BEHAVIOR_TYPE::PREY);
+    scratch.enemies.Filter(scratch.neighbours, BEHAVIOR_TYPE::HUNTER);
+
+    const NeighbourBuffer& neighbours = scratch.neighbours;
+    const NeighbourBuffer& friends = scratch.friends;
+    const NeighbourBuffer& enemies = scratch.enemies;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::STEERING);
+    const CellSums& farFriends = scratch.far[static_cast<int>(BEHAVIOR_TYPE::PREY)];
+    const RVector3 alignment = behavior.GetAlignment(friends, &farFriends) * behavior.alignmentWeight;
+    const RVector3 cohesion = behavior.GetCohesion(boid.position, friends, &farFriends) * behavior.cohesionWeight;
+    const RVector3 separation = behavior.GetSeparation(boid.position, boid.radius, neighbours) * behavior.separationWeight;
+    const RVector3 escape = behavior.GetEscape(boid.position, enemies) * behavior.escapeWeight;
+    const RVector3 attraction = behavior.GetFlockAttraction(boid) * behavior.flockAttractionWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::OBSTACLE_AVOIDANCE);
+    const RVector3 avoidance = behavior.GetThrottledAvoidance(boid) * behavior.avoidanceWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::INTEGRATION);
+    const RVector3 acceleration = alignment + cohesion + separation + avoidance + escape + attraction;
+    boid.velocity += acceleration.getUnit();
+    boid.velocity = clamp(boid.velocity, behavior.maxSpeed);
+
+    boid.position += boid.velocity * deltaTime;
+    return -1;
+}
+
+int FlockingSimulation::UpdateBoidSoA(int id, const HunterBehavior& behavior, NeighbourScratch& scratch, float deltaTime)
+{
+    Boid& boid = boids[id];
+
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::TYPE_FILTERING);
+    scratch.friends.Filter(scratch.neighbours, BEHAVIOR_TYPE::HUNTER);
+    scratch.enemies.Filter(scratch.neighbours, BEHAVIOR_TYPE::PREY);
+
+    const NeighbourBuffer& friends = scratch.friends;
+    const NeighbourBuffer& enemies = scratch.enemies;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::STEERING);
+    const RVector3 separation = behavior.GetSeparation(boid.position, boid.radius, friends) * behavior.separationWeight;
+    const RVector3 hunting = behavior.GetHunting(boid.position, enemies) * behavior.huntingWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::OBSTACLE_AVOIDANCE);
+    const RVector3 avoidance = behavior.GetThrottledAvoidance(boid) * behavior.avoidanceWeight;
+
+    FLOCKING_PHASE_SWITCH(timer, FRAME_PHASE::INTEGRATION);
+    RVector3 velocityAcceleration = (hunting + separation + avoidance);
+
+    behavior.ApplyEnergy(deltaTime, boid, velocityAcceleration);
+    boid.position += boid.velocity * deltaTime;
+
+    int eatenId = -1;
+    behavior.TryEat(boid, enemies, eatenId);
+    return eatenId;
+}
+
+void FlockingSimulation::ResolveHunterEvent(const HunterEvent& event)
+{
+    Boid& hunter = boids[event.hunterId];
+    const HunterBehavior& behavior = static_cast<const HunterBehavior&>(*hunter.behavior);
+
+    // Two hunters may have caught the same prey, only the first one in id order eats it
+    if(event.eatenId >= 0 && storage.status[event.eatenId] == STATUS::ALIVE) {
+        ++hunter.hunter.targetsEaten;
+        hunter.hunter.energy += behavior.eatEnergy;
+        hunter.radius *= 1.1f;
+        storage.radius[event.hunterId] = hunter.radius;
+
+        boids[event.eatenId].status = STATUS::DEAD;
+        storage.status[event.eatenId] = STATUS::DEAD;
+    }
+
+    if(behavior.TryConvert(hunter)) {
+        storage.type[event.hunterId] = hunter.behavior->GetType();
+    }
+}
+
+void FlockingSimulation::RemoveDead()
+{
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::DEAD_COMPACTION);
+    const bool hasStorage = storageMode == STORAGE_MODE::SOA;
 
     int countForDelete = 0;
     for(int i = boids.size() - 1; i >= 0; --i) {
         Boid& boid = boids[i];
         
         if(boid.status == STATUS::DEAD) {
-            boids[i] = std::move(boids[boids.size() - 1 - countForDelete]);
+            const int last = boids.size() - 1 - countForDelete;
+            boids[i] = std::move(boids[last]);
+            slots.Release(i);
+            if(last != i) {
+                slots.Move(last, i);
+            }
+            if(hasStorage) {
+                storage.Move(last, i);
+            }
             ++countForDelete;
         }
     }
 
     boids.erase(boids.end() - countForDelete, boids.end());
+    slots.Resize(boids.size());
+    if(hasStorage) {
+        storage.Resize(boids.size());
+    }
+}
+
+void FlockingSimulation::SortBoids()
+{
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::SPATIAL_SORT);
+
+    mortonOrder.Build(static_cast<int>(boids.size()), [this](int id) -> const RVector3& { return boids[id].position; }, minPoint, maxPoint);
+    const vector<int>& order = mortonOrder.GetOrder();
+
+    sortedBoids.clear();
+    sortedBoids.reserve(boids.size());
+    for(int id : order) {
+        sortedBoids.emplace_back(std::move(boids[id]));
+    }
+    boids.swap(sortedBoids);
+
+    slots.Permute(order);
+    if(storageMode == STORAGE_MODE::SOA) {
+        storage.Permute(order, sortedStorage);
+    }
 }
 
 void FlockingSimulation::OnShutdown()
@@ -38,13 +561,56 @@ void FlockingSimulation::OnShutdown()
     ClearAll();
 }
 
+void FlockingSimulation::SetSeed(uint64_t seed)
+{
+    random.Seed(seed);
+}
+
+void FlockingSimulation::GenerateSpawnMotion(int boidsCount)
+{
+    // One channel per component, so each is a single bulk fill
+    constexpr int CHANNELS = 7;
+    spawnValues.resize(static_cast<size_t>(boidsCount) * CHANNELS);
+    float* x = spawnValues.data();
+    float* y = x + boidsCount;
+    float* z = y + boidsCount;
+    float* dx = z + boidsCount;
+    float* dy = dx + boidsCount;
+    float* dz = dy + boidsCount;
+    float* speed = dz + boidsCount;
+
+    random.FillUniform(x, boidsCount, minPoint.x, maxPoint.x);
+    random.FillUniform(y, boidsCount, minPoint.y, maxPoint.y);
+    random.FillUniform(z, boidsCount, minPoint.z, maxPoint.z);
+    random.FillUniform(dx, boidsCount, 0.f, 100.f);
+    random.FillUniform(dy, boidsCount, 0.f, 100.f);
+    random.FillUniform(dz, boidsCount, 0.f, 100.f);
+    random.FillUniform(speed, boidsCount, 1.f, 10.f);
+
+    spawnPositions.resize(boidsCount);
+    spawnVelocities.resize(boidsCount);
+    for(int i = 0; i < boidsCount; ++i) {
+        spawnPositions[i] = RVector3{x[i], y[i], z[i]};
+        spawnVelocities[i] = RVector3{dx[i], dy[i], dz[i]}.getUnit() * speed[i];
+    }
+}
+
 void FlockingSimulation::ClearAll()
 {
     for(CollisionBody* body : obstacles) {
         GetPhysicsWorld().destroyCollisionBody(body);
     }
     obstacles.clear();
+    obstacleIndex.Clear();
+    obstacleField.Clear();
     boids.clear();
+    slots.Clear();
+    storage.Clear();
+    backStorage.Clear();
+    neighbourIndex->Invalidate();
+    neighbourLists.Invalidate();
+    updatesSinceSort = 0;
+    profiler.Clear();
 }
 
 void FlockingSimulation::AddObstacle(const float* center, const float* extents)
@@ -58,6 +624,8 @@ void FlockingSimulation::AddObstacle(const float* center, const float* extents)
     body->addCollider(shape, Transform::identity());
 
     obstacles.push_back(body);
+    obstacleIndex.AddBox({center[0], center[1], center[2]}, {extents[0], extents[1], extents[2]});
+    obstacleField.Invalidate();
 }
 
 const float* FlockingSimulation::GetPositionOf(int id) const
@@ -65,7 +633,487 @@ const float* FlockingSimulation::GetPositionOf(int id) const
     return &boids[id].position.x;
 }
 
+const float* FlockingSimulation::GetPositionOf(BoidHandle handle) const
+{
+    const Boid* boid = Resolve(handle);
+    return boid != nullptr ? &boid->position.x : nullptr;
+}
+
+const Boid* FlockingSimulation::Resolve(BoidHandle handle) const
+{
+    const int id = slots.Find(handle);
+    return id >= 0 ? &boids[id] : nullptr;
+}
+
+bool FlockingSimulation::IsAlive(BoidHandle handle) const
+{
+    const Boid* boid = Resolve(handle);
+    return boid != nullptr && boid->status == STATUS::ALIVE;
+}
+
+BoidHandle FlockingSimulation::GetHandle(int id) const
+{
+    return slots.GetHandle(id);
+}
+
+size_t FlockingSimulation::GetSlotCount() const
+{
+    return slots.GetSlotCount();
+}
+
+BoidHandle FlockingSimulation::ReserveHandle()
+{
+    return slots.Reserve();
+}
+
+float FlockingSimulation::GetGridCellSize() const
+{
+    float cellSize = 0.f;
+    for(const Boid& boid : boids) {
+        cellSize = std::max(cellSize, boid.behavior->GetViewRadius());
+    }
+
+    return cellSize > 0.f ? cellSize : std::sqrt(DefaultBehaviorParams::VIEW_DISTANCE);
+}
+
+float FlockingSimulation::GetMaxViewRadius() const
+{
+    return std::max({defaultBehavior.GetViewRadius(), preyBehavior.GetViewRadius(), hunterBehavior.GetViewRadius()});
+}
+
+float FlockingSimulation::GetTopSpeed() const
+{
+    return std::max({defaultBehavior.maxSpeed, preyBehavior.maxSpeed, hunterBehavior.maxSpeed, hunterBehavior.acceleratedMaxSpeed});
+}
+
+float FlockingSimulation::GetLargestStep(float deltaTime) const
+{
+    // A boid that steers is clamped to its behavior's speed, one that coasts keeps its velocity
+    float topSpeed_2 = GetTopSpeed() * GetTopSpeed();
+    for(const Boid& boid : boids) {
+        topSpeed_2 = std::max(topSpeed_2, boid.velocity.lengthSquare());
+    }
+
+    return std::sqrt(topSpeed_2) * deltaTime;
+}
+
+void FlockingSimulation::GetInterpolatedPositions(float alpha, vector<RVector3>& positions) const
+{
+    positions.resize(boids.size());
+    for(size_t i = 0; i < boids.size(); ++i) {
+        positions[i] = boids[i].previousPosition + (boids[i].position - boids[i].previousPosition) * alpha;
+    }
+}
+
 const vector<Boid>& FlockingSimulation::GetBoids() const
 {
     return boids;
+}
+
+FrameStats FlockingSimulation::GetFrameStats() const
+{
+    FrameStats stats = profiler.GetStats();
+    stats.lodLevel = lodLevel;
+    return stats;
+}
+
+void FlockingSimulation::SetFrameBudget(float milliseconds)
+{
+    frameBudget = milliseconds;
+    budgetWindowMs = 0.0;
+    budgetWindowUpdates = 0;
+
+    if(frameBudget <= 0.f) {
+        SetLodLevel(0);
+    }
+}
+
+float FlockingSimulation::GetFrameBudget() const
+{
+    return frameBudget;
+}
+
+void FlockingSimulation::SetLodLevel(int level)
+{
+    lodLevel = std::clamp(level, 0, DefaultSimulationParams::LOD_LEVEL_COUNT - 1);
+
+    const SimulationLod& lod = DefaultSimulationParams::LOD_LEVELS[lodLevel];
+    for(Behavior* behavior : {&defaultBehavior, static_cast<Behavior*>(&preyBehavior)}) {
+        behavior->neighbourCap = lod.neighbourCap;
+        behavior->avoidanceInterval = lod.avoidanceInterval;
+    }
+}
+
+int FlockingSimulation::GetLodLevel() const
+{
+    return lodLevel;
+}
+
+void FlockingSimulation::SetTimeSlices(int slices)
+{
+    timeSlices = std::max(1, slices);
+}
+
+int FlockingSimulation::GetTimeSlices() const
+{
+    return timeSlices;
+}
+
+void FlockingSimulation::SetTimeSliceExemptions(bool hunters, bool nearObstacles)
+{
+    huntersExempt = hunters;
+    nearObstaclesExempt = nearObstacles;
+}
+
+void FlockingSimulation::SetObservers(const float* positions, int count)
+{
+    observers.resize(count);
+    for(int i = 0; i < count; ++i) {
+        observers[i] = RVector3{positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]};
+    }
+}
+
+void FlockingSimulation::SetDistanceBand(int band, const DistanceBand& distanceBand)
+{
+    assert(band >= 0 && band < DISTANCE_BAND_COUNT);
+    distanceBands[band] = distanceBand;
+}
+
+const DistanceBand& FlockingSimulation::GetDistanceBand(int band) const
+{
+    assert(band >= 0 && band < DISTANCE_BAND_COUNT);
+    return distanceBands[band];
+}
+
+int FlockingSimulation::GetBandOf(const RVector3& position) const
+{
+    if(observers.empty()) {
+        return 0;
+    }
+
+    float nearest_2 = std::numeric_limits<float>::max();
+    for(const RVector3& observer : observers) {
+        nearest_2 = std::min(nearest_2, (observer - position).lengthSquare());
+    }
+
+    int band = 0;
+    while(band + 1 < DISTANCE_BAND_COUNT && nearest_2 >= distanceBands[band + 1].distance * distanceBands[band + 1].distance) {
+        ++band;
+    }
+    return band;
+}
+
+bool FlockingSimulation::TakesSteeringTurn(Boid& boid) const
+{
+    const int band = GetBandOf(boid.position);
+    const DistanceBand& distanceBand = distanceBands[band];
+    boid.avoidsObstacles = distanceBand.raycasts;
+
+    // The counter is the boid's own, so its turn comes every interval updates however the others are reordered
+    const uint32_t interval = static_cast<uint32_t>(std::max({activeTimeSlices, distanceBand.updateInterval, 1}));
+    const bool turn = boid.steeringTick++ % interval == 0 ||
+                      (huntersExempt && boid.behavior->GetType() == BEHAVIOR_TYPE::HUNTER) ||
+                      // The last avoidance is only zero away from every obstacle and the bounds
+                      (nearObstaclesExempt && boid.avoidance.lengthSquare() > 0.f);
+
+    FLOCKING_COUNT(GetBandCounter(FRAME_COUNTER::BAND_BOIDS, band), 1);
+    if(turn) {
+        FLOCKING_COUNT(GetBandCounter(FRAME_COUNTER::BAND_STEERED, band), 1);
+    }
+    return turn;
+}
+
+void FlockingSimulation::UpdateGovernor(double milliseconds)
+{
+    if(frameBudget <= 0.f) {
+        return;
+    }
+
+    budgetWindowMs += milliseconds;
+    if(++budgetWindowUpdates < DefaultSimulationParams::FRAME_BUDGET_WINDOW) {
+        return;
+    }
+
+    // A whole window at the new level is measured before the next step, so one slow update never drops several levels
+    const double mean = budgetWindowMs / budgetWindowUpdates;
+    budgetWindowMs = 0.0;
+    budgetWindowUpdates = 0;
+
+    if(mean > frameBudget) {
+        SetLodLevel(lodLevel + 1);
+    } else if(mean < frameBudget * DefaultSimulationParams::FRAME_BUDGET_HEADROOM) {
+        SetLodLevel(lodLevel - 1);
+    }
+}
+
+void FlockingSimulation::SetStorageMode(STORAGE_MODE mode)
+{
+    if(mode == STORAGE_MODE::SOA && storageMode != STORAGE_MODE::SOA) {
+        storage.Assign(boids);
+    }
+
+    if(mode == STORAGE_MODE::AOS) {
+        storage.Clear();
+        backStorage.Clear();
+        updateMode = UPDATE_MODE::SEQUENTIAL;
+    }
+
+    // AoS updates move the boids without looking at the lists
+    neighbourLists.Invalidate();
+    storageMode = mode;
+}
+
+STORAGE_MODE FlockingSimulation::GetStorageMode() const
+{
+    return storageMode;
+}
+
+void FlockingSimulation::SetUpdateMode(UPDATE_MODE mode)
+{
+    if(mode == UPDATE_MODE::PARALLEL) {
+        SetStorageMode(STORAGE_MODE::SOA);
+    }
+
+    updateMode = mode;
+}
+
+UPDATE_MODE FlockingSimulation::GetUpdateMode() const
+{
+    return updateMode;
+}
+
+void FlockingSimulation::SetNeighbourSkin(float skin)
+{
+    neighbourSkin = skin;
+    neighbourLists.Invalidate();
+}
+
+float FlockingSimulation::GetNeighbourSkin() const
+{
+    return neighbourSkin;
+}
+
+void FlockingSimulation::SetSortInterval(int interval)
+{
+    sortInterval = interval;
+    updatesSinceSort = 0;
+}
+
+int FlockingSimulation::GetSortInterval() const
+{
+    return sortInterval;
+}
+
+void FlockingSimulation::SetFlockOpeningAngle(float angle)
+{
+    flockOctree.SetOpeningAngle(angle);
+}
+
+float FlockingSimulation::GetFlockOpeningAngle() const
+{
+    return flockOctree.GetOpeningAngle();
+}
+
+void FlockingSimulation::SetSteeringMode(STEERING_MODE mode)
+{
+    steeringMode = mode;
+}
+
+STEERING_MODE FlockingSimulation::GetSteeringMode() const
+{
+    return steeringMode;
+}
+
+ApproximationError FlockingSimulation::MeasureApproximationError(int sampleCount)
+{
+    ApproximationError error;
+    if(steeringMode != STEERING_MODE::CELL_AGGREGATES || storageMode != STORAGE_MODE::SOA || storage.Size() == 0) {
+        return error;
+    }
+
+    PrepareNeighbourSearch(nullptr, 0.f);
+
+    // GetAngleBetween feeds rounding above one straight into acos, identical directions would come out as NaN
+    const auto getAngle = [](const RVector3& a, const RVector3& b)
+    {
+        if(a.lengthSquare() <= 0.f || b.lengthSquare() <= 0.f) {
+            return 0.f;
+        }
+        const float cosAngle = std::clamp(a.getUnit().dot(b.getUnit()), -1.f, 1.f);
+        return static_cast<float>(std::acos(cosAngle) * 180 / M_PI);
+    };
+
+    const int stride = std::max(1, static_cast<int>(storage.Size()) / std::max(1, sampleCount));
+    for(int id = 0; id < storage.Size(); id += stride) {
+        const Behavior& behavior = *boids[id].behavior;
+        if(storage.type[id] == BEHAVIOR_TYPE::HUNTER || behavior.GetMaxNeighbours() > 0) {
+            continue;
+        }
+
+        // Alignment and cohesion steer by the same boids whatever the type, the error of prey is that of their friends
+        ArenaScope scope;
+        NeighbourScratch exact;
+        NeighbourScratch approximate;
+        GatherNeighbours(id, behavior, exact.neighbours);
+        GatherNeighbours(id, behavior, approximate);
+
+        const BEHAVIOR_TYPE friendType = storage.type[id] == BEHAVIOR_TYPE::PREY ? BEHAVIOR_TYPE::PREY : BEHAVIOR_TYPE::DEFAULT;
+        CellSums far;
+        if(friendType == BEHAVIOR_TYPE::PREY) {
+            exact.friends.Filter(exact.neighbours, BEHAVIOR_TYPE::PREY);
+            approximate.friends.Filter(approximate.neighbours, BEHAVIOR_TYPE::PREY);
+            far = approximate.far[static_cast<int>(BEHAVIOR_TYPE::PREY)];
+        } else {
+            for(const CellSums& farOfType : approximate.far) {
+                far.Add(farOfType);
+            }
+        }
+
+        const NeighbourBuffer& exactFriends = friendType == BEHAVIOR_TYPE::PREY ? exact.friends : exact.neighbours;
+        const NeighbourBuffer& approximateFriends = friendType == BEHAVIOR_TYPE::PREY ? approximate.friends : approximate.neighbours;
+        const RVector3 position = storage.GetPosition(id);
+
+        error.alignmentDegrees += getAngle(behavior.GetAlignment(exactFriends), behavior.GetAlignment(approximateFriends, &far));
+        error.cohesionDegrees += getAngle(behavior.GetCohesion(position, exactFriends), behavior.GetCohesion(position, approximateFriends, &far));
+        ++error.samples;
+    }
+
+    neighbourIndex->Invalidate();
+
+    if(error.samples > 0) {
+        error.alignmentDegrees /= error.samples;
+        error.cohesionDegrees /= error.samples;
+    }
+    return error;
+}
+
+void FlockingSimulation::SetWorkerCount(int count)
+{
+    workerCount = count;
+    threadPool.reset();
+}
+
+int FlockingSimulation::GetWorkerCount() const
+{
+    if(sharedThreadPool != nullptr) {
+        return sharedThreadPool->GetWorkerCount();
+    }
+    return threadPool != nullptr ? threadPool->GetWorkerCount() : workerCount;
+}
+
+void FlockingSimulation::SetThreadPool(ThreadPool* pool)
+{
+    sharedThreadPool = pool;
+}
+
+void FlockingSimulation::SetNeighbourBackend(NEIGHBOUR_BACKEND backend)
+{
+    if(backend == neighbourIndex->GetBackend()) {
+        return;
+    }
+
+    neighbourIndex = CreateNeighbourIndex(backend);
+
+    for(Boid& boid : boids) {
+        boid.neighbourIndex = neighbourIndex.get();
+    }
+}
+
+NEIGHBOUR_BACKEND FlockingSimulation::GetNeighbourBackend() const
+{
+    return neighbourIndex->GetBackend();
+}
+
+const INeighbourIndex& FlockingSimulation::GetNeighbourIndex() const
+{
+    return *neighbourIndex;
+}
+
+void FlockingSimulation::SetObstacleBackend(OBSTACLE_BACKEND backend)
+{
+    obstacleBackend = backend;
+
+    for(Boid& boid : boids) {
+        boid.obstacleIndex = GetObstacleIndex();
+        boid.obstacleField = GetActiveObstacleField();
+    }
+}
+
+OBSTACLE_BACKEND FlockingSimulation::GetObstacleBackend() const
+{
+    return obstacleBackend;
+}
+
+void FlockingSimulation::SetObstacleFieldCellSize(float cellSize, bool background)
+{
+    obstacleFieldCellSize = cellSize;
+    obstacleFieldBackground = background;
+    obstacleField.Invalidate();
+}
+
+const ObstacleField& FlockingSimulation::GetObstacleField() const
+{
+    return obstacleField;
+}
+
+const ObstacleIndex* FlockingSimulation::GetObstacleIndex() const
+{
+    return obstacleBackend != OBSTACLE_BACKEND::PHYSICS ? &obstacleIndex : nullptr;
+}
+
+const ObstacleField* FlockingSimulation::GetActiveObstacleField() const
+{
+    return obstacleBackend == OBSTACLE_BACKEND::DISTANCE_FIELD ? &obstacleField : nullptr;
+}
+
+void FlockingSimulation::PrepareObstacles()
+{
+    if(obstacleIndex.NeedsBuild()) {
+        obstacleIndex.Build(obstacleCellSize);
+    }
+
+    if(obstacleBackend != OBSTACLE_BACKEND::DISTANCE_FIELD) {
+        return;
+    }
+
+    if(obstacleField.NeedsBuild()) {
+        obstacleField.Build(obstacleIndex.boxMin, obstacleIndex.boxMax, minPoint, maxPoint, obstacleFieldCellSize, obstacleFieldBackground);
+    }
+
+    obstacleField.TryPublish();
+}
+
+void FlockingSimulation::PrepareFlockOctree()
+{
+    // Hunters neither feel the attraction nor make up the flocks that cause it
+    if(defaultBehavior.flockAttractionWeight <= 0.f && preyBehavior.flockAttractionWeight <= 0.f) {
+        flockOctree.Clear();
+        return;
+    }
+
+    FLOCKING_PHASE_TIMER(timer, FRAME_PHASE::NEIGHBOUR_SEARCH);
+    if(storageMode == STORAGE_MODE::SOA) {
+        flockOctree.Build(storage.Size(),
+            [this](int id) { return storage.status[id] == STATUS::ALIVE && storage.type[id] != BEHAVIOR_TYPE::HUNTER; },
+            [this](int id) { return storage.GetPosition(id); },
+            [this](int id) { return storage.GetVelocity(id); });
+    } else {
+        flockOctree.Build(static_cast<int>(boids.size()),
+            [this](int i) { return boids[i].status == STATUS::ALIVE && boids[i].behavior->GetType() != BEHAVIOR_TYPE::HUNTER; },
+            [this](int i) { return boids[i].position; },
+            [this](int i) { return boids[i].velocity; });
+    }
+}
+
+ThreadPool& FlockingSimulation::GetThreadPool()
+{
+    if(sharedThreadPool != nullptr) {
+        return *sharedThreadPool;
+    }
+
+    if(threadPool == nullptr) {
+        threadPool = std::make_unique<ThreadPool>(workerCount);
+    }
+
+    return *threadPool;
 }
\ No newline at end of file
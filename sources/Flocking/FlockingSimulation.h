@@ -2,15 +2,46 @@
 #include <map>
 
 #include "Boid.h"
+#include "BoidHandle.h"
+#include "BoidStorage.h"
+#include "CellAggregates.h"
+#include "DefaultSimulationParams.h"
+#include "FlockOctree.h"
+#include "FrameStats.h"
+#include "MortonOrder.h"
+#include "NeighbourIndex.h"
+#include "NeighbourLists.h"
+#include "ObstacleField.h"
+#include "ObstacleIndex.h"
+#include "Random.h"
+#include "ThreadPool.h"
 
 using std::vector;
 using std::map;
 
+// Outcome of a hunter update, applied once no other boid can be reading the hunter or its prey
+struct HunterEvent
+{
+    int hunterId;
+    int eatenId;
+};
+
+struct WorkerState
+{
+    vector<HunterEvent> hunterEvents;
+};
+
 class FlockingSimulation
 {
 public:
     FlockingSimulation();
     ~FlockingSimulation();
+
+    // Boids point into the behaviors and the index of the simulation they were spawned in
+    FlockingSimulation(const FlockingSimulation&) = delete;
+    FlockingSimulation& operator =(const FlockingSimulation&) = delete;
+    FlockingSimulation(FlockingSimulation&&) = delete;
+    FlockingSimulation& operator =(FlockingSimulation&&) = delete;
     
     void OnInitialize();
     void OnUpdate(float deltaTime);
@@ -18,51 +49,346 @@ public:
 
     void ClearAll();
 
+    // Random positions inside the bounds, drawn from the simulation's generator
     template<typename T>
     void Spawn(int boidsCount);
 
+    // Takes reserved as its handle when it came from ReserveHandle and is still unused
     template<typename T>
-    const Boid& Spawn(const float* position, const float* velocity);
+    BoidHandle Spawn(const float* position, const float* velocity, BoidHandle reserved = {});
+    // A handle that stays dead until a Spawn takes it, so a boid can be tracked before it exists
+    BoidHandle ReserveHandle();
     
+    // Tuning shared by every boid of type T, not meant to be changed while an update is running
+    template<typename T>
+    T& GetBehavior();
+    template<typename T>
+    const T& GetBehavior() const;
+
+    // The same seed and the same calls give bitwise identical boids
+    void SetSeed(uint64_t seed);
+
     void AddObstacle(const float* center, const float* extents);
     const float* GetPositionOf(int id) const;
+    // Null once the boid is gone
+    const float* GetPositionOf(BoidHandle handle) const;
+
+    // Null once the boid is gone. The pointer is only valid until the next update or spawn
+    const Boid* Resolve(BoidHandle handle) const;
+    bool IsAlive(BoidHandle handle) const;
+    // Handle of the boid currently at id in GetBoids()
+    BoidHandle GetHandle(int id) const;
+    // Every handle's slot is below it
+    size_t GetSlotCount() const;
 
     const vector<Boid>& GetBoids() const;
+    // Positions alpha of the way from before to after the last update, in GetBoids() order. Lets the simulation update
+    // at a lower rate than frames are drawn without stutter
+    void GetInterpolatedPositions(float alpha, vector<RVector3>& positions) const;
+
+    // Per-phase timings and counters over the last DefaultSimulationParams::FRAME_STATS_WINDOW updates
+    FrameStats GetFrameStats() const;
+
+    // Once updates take longer than milliseconds on average, prey and default boids steer by fewer neighbours and look
+    // for obstacles less often, then the updates are time sliced, one DefaultSimulationParams::LOD_LEVELS step at a time.
+    // The quality comes back as the cost drops well below the budget. 0 turns the governor off and restores it
+    void SetFrameBudget(float milliseconds);
+    float GetFrameBudget() const;
+    // Forces a level, the governor moves on from it
+    void SetLodLevel(int level);
+    int GetLodLevel() const;
+
+    // Only one in slices boids gathers neighbours and steers each update, taking turns by spawn order, while the others
+    // keep flying on their last velocity. 1 steers every boid every update
+    void SetTimeSlices(int slices);
+    int GetTimeSlices() const;
+    // Boids that steer every update whatever the slices: hunters, and boids that were steering away from an obstacle
+    // or the bounds at their last turn
+    void SetTimeSliceExemptions(bool hunters, bool nearObstacles);
+
+    // count xyz points the player sees the flock from, such as cameras. Boids fall in the DistanceBand of their distance
+    // to the nearest one, farther bands steer less often and can skip raycasts, the exemptions of the time slices still
+    // apply. No observers keeps every boid in the first band
+    void SetObservers(const float* positions, int count);
+    void SetDistanceBand(int band, const DistanceBand& distanceBand);
+    const DistanceBand& GetDistanceBand(int band) const;
+
+    void SetStorageMode(STORAGE_MODE mode);
+    STORAGE_MODE GetStorageMode() const;
+
+    // UPDATE_MODE::PARALLEL double-buffers the SoA state and switches the storage to STORAGE_MODE::SOA
+    void SetUpdateMode(UPDATE_MODE mode);
+    UPDATE_MODE GetUpdateMode() const;
+
+    // Verlet neighbour lists for the SoA updates: candidates within the view radius plus skin are searched once
+    // and filtered every update until some boid has moved half the skin. 0 searches every update
+    void SetNeighbourSkin(float skin);
+    float GetNeighbourSkin() const;
+
+    // Every interval updates the boids are reordered along a Morton curve, so neighbours in space are neighbours in memory.
+    // Ids change, handles keep resolving to the same boids. 0 keeps the spawn order
+    void SetSortInterval(int interval);
+    int GetSortInterval() const;
+
+    // STEERING_MODE::CELL_AGGREGATES approximates alignment and cohesion of the SoA updates from per-cell sums,
+    // hunters and topological behaviors keep the exact search
+    void SetSteeringMode(STEERING_MODE mode);
+    STEERING_MODE GetSteeringMode() const;
+
+    // Barnes–Hut opening angle of the far field behind Behavior::flockAttractionWeight, 0 sums it boid by boid
+    void SetFlockOpeningAngle(float angle);
+    float GetFlockOpeningAngle() const;
+
+    // Mean angle in degrees between the cell aggregate and the exact alignment and cohesion of up to sampleCount
+    // boids spread over the current SoA state. Both are 0 in STEERING_MODE::EXACT
+    ApproximationError MeasureApproximationError(int sampleCount);
+
+    // 0 uses every hardware thread
+    void SetWorkerCount(int count);
+    int GetWorkerCount() const;
+    // Runs the parallel update on a scheduler owned by the caller, shared with the rest of the game update. nullptr goes back to
+    // a pool of the simulation's own, sized by SetWorkerCount
+    void SetThreadPool(ThreadPool* pool);
+
+    // Spatial index behind the neighbour search and the neighbour list rebuilds, see INeighbourIndex
+    void SetNeighbourBackend(NEIGHBOUR_BACKEND backend);
+    NEIGHBOUR_BACKEND GetNeighbourBackend() const;
+    const INeighbourIndex& GetNeighbourIndex() const;
+
+    // OBSTACLE_BACKEND::PHYSICS keeps the rp3d raycast for obstacles that are not axis aligned boxes
+    void SetObstacleBackend(OBSTACLE_BACKEND backend);
+    OBSTACLE_BACKEND GetObstacleBackend() const;
+
+    // OBSTACLE_BACKEND::DISTANCE_FIELD node spacing, the field takes 4 bytes per node over the simulation bounds.
+    // It is rebuilt on the next update, the static index is used until the build is done
+    void SetObstacleFieldCellSize(float cellSize, bool background = DefaultSimulationParams::OBSTACLE_FIELD_BACKGROUND_BUILD);
+    const ObstacleField& GetObstacleField() const;
 
 #ifndef DEBUG
 // protected:
 #endif
     template<typename T>
     Boid CreateBoid() const;
+
+    float GetGridCellSize() const;
+    const ObstacleIndex* GetObstacleIndex() const;
+    const ObstacleField* GetActiveObstacleField() const;
+    void PrepareObstacles();
+    // Builds the far field while a behavior weighs the flock attraction, clears it otherwise
+    void PrepareFlockOctree();
+
+    void GenerateSpawnMotion(int boidsCount);
+
+    void UpdateAoS(float deltaTime);
+    // From the positions in boids, Behavior::GetNeighbours uses it until the next Invalidate. pendingStep is how far a boid
+    // can move before the last query, see INeighbourIndex::SetDrift
+    void BuildNeighbourIndexAoS(float pendingStep = 0.f);
+    void UpdateSoA(float deltaTime);
+    void UpdateParallel(float deltaTime);
+    // Builds the neighbour index, or the neighbour lists when they are on and outdated. pendingStep as in NeighbourLists::NeedsRebuild,
+    // the index queries are widened by it as well
+    void PrepareNeighbourSearch(ThreadPool* pool, float pendingStep);
+    void RebuildNeighbourLists(ThreadPool* pool);
+    // On the pool when there is one, on the calling thread as worker 0 otherwise
+    void RunRanges(ThreadPool* pool, int count, const ThreadPool::Task& task);
+    float GetMaxViewRadius() const;
+    float GetTopSpeed() const;
+    // Farthest a boid can move in one update, spawned boids may start out faster than their behavior allows
+    float GetLargestStep(float deltaTime) const;
+    // far adds the cells in view beyond separation reach to it instead of their boids to neighbours, see CellAggregates::Query
+    void GatherNeighbours(int id, const Behavior& behavior, NeighbourBuffer& neighbours, CellSums* far = nullptr) const;
+    // Into scratch, from the cell aggregates where the steering mode and behavior allow
+    void GatherNeighbours(int id, const Behavior& behavior, NeighbourScratch& scratch) const;
+    int UpdateBoidAt(int id, NeighbourScratch& scratch, float deltaTime);
+
+    // Per-type steering, picked by overload resolution. Returns the id of the eaten prey or -1
+    int UpdateBoidSoA(int id, const Behavior& behavior, NeighbourScratch& scratch, float deltaTime);
+    int UpdateBoidSoA(int id, const PreyBehavior& behavior, NeighbourScratch& scratch, float deltaTime);
+    int UpdateBoidSoA(int id, const HunterBehavior& behavior, NeighbourScratch& scratch, float deltaTime);
+
+    template<typename T>
+    void UpdatePartition(ThreadPool& pool, float deltaTime);
+    void ResolveHunterEvent(const HunterEvent& event);
+    void RemoveDead();
+    void SortBoids();
+    void UpdateGovernor(double milliseconds);
+    // Advances the boid's turn, false when it only integrates its velocity this update
+    bool TakesSteeringTurn(Boid& boid) const;
+    int GetBandOf(const RVector3& position) const;
+
+    ThreadPool& GetThreadPool();
     
     vector<Boid> boids;
+    BoidSlots slots;
     vector<CollisionBody*> obstacles;
 
+    Behavior defaultBehavior;
+    PreyBehavior preyBehavior;
+    HunterBehavior hunterBehavior;
+
+    STORAGE_MODE storageMode = DefaultSimulationParams::STORAGE;
+    BoidStorage storage;
+    BoidStorage backStorage;
+    TypePartitions partitions;
+
+    UPDATE_MODE updateMode = DefaultSimulationParams::UPDATE;
+    int workerCount = DefaultSimulationParams::WORKER_COUNT;
+    std::unique_ptr<ThreadPool> threadPool;
+    ThreadPool* sharedThreadPool = nullptr;
+    vector<WorkerState> workers = vector<WorkerState>(1);
+    vector<HunterEvent> hunterEvents;
+
+    FrameProfiler profiler{DefaultSimulationParams::FRAME_STATS_WINDOW};
+
+    float frameBudget = DefaultSimulationParams::FRAME_BUDGET_MS;
+    int lodLevel = 0;
+    double budgetWindowMs = 0.0;
+    int budgetWindowUpdates = 0;
+
+    int timeSlices = DefaultSimulationParams::TIME_SLICES;
+    // timeSlices or more as the governor asks, for the current update
+    int activeTimeSlices = 1;
+    bool huntersExempt = DefaultSimulationParams::TIME_SLICE_EXEMPT_HUNTERS;
+    bool nearObstaclesExempt = DefaultSimulationParams::TIME_SLICE_EXEMPT_NEAR_OBSTACLES;
+
+    vector<RVector3> observers;
+    DistanceBand distanceBands[DISTANCE_BAND_COUNT] = {
+        DefaultSimulationParams::DISTANCE_BANDS[0],
+        DefaultSimulationParams::DISTANCE_BANDS[1],
+        DefaultSimulationParams::DISTANCE_BANDS[2],
+        DefaultSimulationParams::DISTANCE_BANDS[3]
+    };
+
+    Random random{DefaultSimulationParams::RANDOM_SEED};
+    vector<float> spawnValues;
+    vector<RVector3> spawnPositions;
+    vector<RVector3> spawnVelocities;
+
+    std::unique_ptr<INeighbourIndex> neighbourIndex = CreateNeighbourIndex(DefaultSimulationParams::NEIGHBOURS);
+    // Positions the AoS update builds the index from
+    vector<float> indexX;
+    vector<float> indexY;
+    vector<float> indexZ;
+    bool useSpatialGrid = DefaultSimulationParams::USE_SPATIAL_GRID;
+
+    NeighbourLists neighbourLists;
+    float neighbourSkin = DefaultSimulationParams::NEIGHBOUR_SKIN;
+
+    MortonOrder mortonOrder;
+    int sortInterval = DefaultSimulationParams::SORT_INTERVAL;
+    int updatesSinceSort = 0;
+    vector<Boid> sortedBoids;
+    BoidStorage sortedStorage;
+
+    CellAggregates cellAggregates;
+    FlockOctree flockOctree;
+    STEERING_MODE steeringMode = DefaultSimulationParams::STEERING;
+
+    ObstacleIndex obstacleIndex;
+    OBSTACLE_BACKEND obstacleBackend = DefaultSimulationParams::OBSTACLES;
+    float obstacleCellSize = DefaultSimulationParams::OBSTACLE_CELL_SIZE;
+
+    ObstacleField obstacleField;
+    float obstacleFieldCellSize = DefaultSimulationParams::OBSTACLE_FIELD_CELL_SIZE;
+    bool obstacleFieldBackground = DefaultSimulationParams::OBSTACLE_FIELD_BACKGROUND_BUILD;
+
     const RVector3 minPoint = {-20.f, 0, -20.f};;
     const RVector3 maxPoint = {20.f, 20.0f, 20.f};;
 };
 
+template<typename T>
+T& FlockingSimulation::GetBehavior()
+{
+    return const_cast<T&>(static_cast<const FlockingSimulation*>(this)->GetBehavior<T>());
+}
+
+template<typename T>
+const T& FlockingSimulation::GetBehavior() const
+{
+    if constexpr(std::is_same_v<T, PreyBehavior>) {
+        return preyBehavior;
+    } else if constexpr(std::is_same_v<T, HunterBehavior>) {
+        return hunterBehavior;
+    } else {
+        static_assert(std::is_same_v<T, Behavior>, "not a flocking behavior");
+        return defaultBehavior;
+    }
+}
+
 template<typename T>
 void FlockingSimulation::Spawn(int boidsCount)
 {
-    boids.reserve(boidsCount);
+    GenerateSpawnMotion(boidsCount);
+    boids.reserve(boids.size() + boidsCount);
+    neighbourLists.Invalidate();
     
     for(int i = 0; i < boidsCount; ++i) {
-        boids.push_back(CreateBoid<T>());
+        Boid boid = CreateBoid<T>();
+        boid.position = spawnPositions[i];
+        boid.velocity = spawnVelocities[i];
+        boid.previousPosition = boid.position;
+        boid.avoidanceTick = static_cast<uint32_t>(boids.size());
+        boid.steeringTick = boid.avoidanceTick;
+        boids.emplace_back(std::move(boid));
+        slots.PushBack();
+
+        if(storageMode == STORAGE_MODE::SOA) {
+            storage.PushBack(boids.back());
+        }
     }
 }
 
 template<typename T>
-const Boid& FlockingSimulation::Spawn(const float* position, const float* velocity)
+BoidHandle FlockingSimulation::Spawn(const float* position, const float* velocity, BoidHandle reserved)
 {
     Boid boid = CreateBoid<T>();;
 
     boid.position = RVector3{position[0], position[1], position[2]};
     boid.velocity = RVector3{velocity[0], velocity[1], velocity[2]};
+    boid.previousPosition = boid.position;
+    boid.avoidanceTick = static_cast<uint32_t>(boids.size());
+    boid.steeringTick = boid.avoidanceTick;
 
     boids.emplace_back(std::move(boid));
+    neighbourLists.Invalidate();
+
+    if(storageMode == STORAGE_MODE::SOA) {
+        storage.PushBack(boids.back());
+    }
     
-    return boids.back();
+    return slots.PushBack(reserved);
+}
+
+template<typename T>
+void FlockingSimulation::UpdatePartition(ThreadPool& pool, float deltaTime)
+{
+    const vector<int>& ids = partitions.Of(T::TYPE);
+
+    pool.ParallelFor(static_cast<int>(ids.size()), [this, &ids, deltaTime](int begin, int end, int worker)
+    {
+        WorkerState& state = workers[worker];
+
+        for(int i = begin; i < end; ++i) {
+            const int id = ids[i];
+
+            if(storage.status[id] != STATUS::DEAD && !TakesSteeringTurn(boids[id])) {
+                boids[id].position += boids[id].velocity * deltaTime;
+            } else if(storage.status[id] != STATUS::DEAD) {
+                const T& behavior = static_cast<const T&>(*boids[id].behavior);
+
+                ArenaScope scope;
+                NeighbourScratch scratch;
+                GatherNeighbours(id, behavior, scratch);
+
+                const int eatenId = UpdateBoidSoA(id, behavior, scratch, deltaTime);
+                if(T::TYPE == BEHAVIOR_TYPE::HUNTER) {
+                    state.hunterEvents.push_back({id, eatenId});
+                }
+            }
+
+            backStorage.StoreMotion(id, boids[id]);
+        }
+    });
 }
 
 template<typename T>
@@ -72,11 +398,12 @@ Boid FlockingSimulation::CreateBoid() const
 
     boid.minPoint = &minPoint;
     boid.maxPoint = &maxPoint;
-    
-    boid.position = RVector3{ GetRandomFloat(minPoint.x, maxPoint.x), GetRandomFloat(minPoint.y, maxPoint.y), GetRandomFloat(minPoint.z, maxPoint.z)};
-    boid.velocity = GetRandomVector3().getUnit() * GetRandomFloat(1.f, 10.f);
+    boid.neighbourIndex = neighbourIndex.get();
+    boid.flockOctree = &flockOctree;
+    boid.obstacleIndex = GetObstacleIndex();
+    boid.obstacleField = GetActiveObstacleField();
 
-    boid.behavior = std::make_unique<T>();
+    boid.behavior = &GetBehavior<T>();
 
     return boid;
 }
@@ -0,0 +1,99 @@
+﻿#include "pch.h"
+#include "FrameArena.h"
+
+#include <cstdint>
+
+namespace
+{
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Blocks from new char[] are only aligned for the fundamental types, the address decides
+    size_t AlignOffset(const char* base, size_t offset, size_t alignment)
+    {
+        const uintptr_t address = reinterpret_cast<uintptr_t>(base);
+        return AlignUp(address + offset, alignment) - address;
+    }
+}
+
+FrameArena& FrameArena::Get()
+{
+    static thread_local FrameArena arena;
+    return arena;
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+    while(block < blocks.size()) {
+        const size_t start = AlignOffset(blocks[block].data.get(), offset, alignment);
+        if(start + bytes <= blocks[block].size) {
+            offset = start + bytes;
+            return blocks[block].data.get() + start;
+        }
+
+        ++block;
+        offset = 0;
+    }
+
+    // Blocks double, the arena settles on a handful of them once it has seen its peak
+    const size_t previous = blocks.empty() ? MIN_BLOCK_SIZE / 2 : blocks.back().size;
+    Block added;
+    added.size = std::max(previous * 2, bytes + alignment);
+    added.data.reset(new char[added.size]);
+    blocks.push_back(std::move(added));
+
+    block = blocks.size() - 1;
+    const size_t start = AlignOffset(blocks[block].data.get(), 0, alignment);
+    offset = start + bytes;
+    return blocks[block].data.get() + start;
+}
+
+bool FrameArena::TryExtend(const void* allocation, size_t oldBytes, size_t newBytes)
+{
+    if(block >= blocks.size()) {
+        return false;
+    }
+
+    const char* base = blocks[block].data.get();
+    const char* end = static_cast<const char*>(allocation) + oldBytes;
+    if(end != base + offset) {
+        return false;
+    }
+
+    const size_t start = static_cast<const char*>(allocation) - base;
+    if(start + newBytes > blocks[block].size) {
+        return false;
+    }
+
+    offset = start + newBytes;
+    return true;
+}
+
+FrameArena::Mark FrameArena::GetMark()
+{
+    return {block, offset};
+}
+
+void FrameArena::Rewind(Mark mark)
+{
+    block = mark.block;
+    offset = mark.offset;
+}
+
+size_t FrameArena::GetCapacity() const
+{
+    size_t capacity = 0;
+    for(const Block& each : blocks) {
+        capacity += each.size;
+    }
+    return capacity;
+}
+
+ArenaScope::ArenaScope() : arena(FrameArena::Get()), mark(arena.GetMark()) {}
+
+ArenaScope::~ArenaScope()
+{
+    arena.Rewind(mark);
+}
@@ -0,0 +1,155 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Per-thread linear allocator for update temporaries. Memory is never handed back one allocation at a time:
+// an ArenaScope rewinds everything allocated inside it. A frame is the scope its owner runs the update in
+// (FlockingSimulation::OnUpdate), so it only ever rewinds what that update allocated on its own thread, whatever
+// other code or simulations keep in the same arena. Blocks are only allocated while the arena grows to its peak,
+// steady updates do not touch the heap.
+class FrameArena
+{
+public:
+    struct Mark
+    {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    // The calling thread's arena
+    static FrameArena& Get();
+
+    void* Allocate(size_t bytes, size_t alignment);
+    // Grows the most recent allocation in place, false when it is not the most recent or does not fit
+    bool TryExtend(const void* allocation, size_t oldBytes, size_t newBytes);
+
+    Mark GetMark();
+    void Rewind(Mark mark);
+
+    size_t GetCapacity() const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    constexpr static size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks;
+    size_t block = 0;
+    size_t offset = 0;
+};
+
+// Rewinds the calling thread's arena to where it was on construction
+class ArenaScope
+{
+public:
+    ArenaScope();
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator =(const ArenaScope&) = delete;
+
+private:
+    FrameArena& arena;
+    FrameArena::Mark mark;
+};
+
+// Growable list in the calling thread's frame arena, only valid until the enclosing ArenaScope ends
+template<typename T, size_t ALIGNMENT = alignof(T)>
+class ArenaVector
+{
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "arena memory is copied and dropped without destructors");
+
+public:
+    ArenaVector() = default;
+    ArenaVector(ArenaVector&& other) noexcept;
+    ArenaVector& operator =(ArenaVector&& other) noexcept;
+
+    ArenaVector(const ArenaVector&) = delete;
+    ArenaVector& operator =(const ArenaVector&) = delete;
+
+    void push_back(const T& value);
+    void reserve(size_t capacity);
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* data() { return items; }
+    const T* data() const { return items; }
+    T& operator [](size_t index) { return items[index]; }
+    const T& operator [](size_t index) const { return items[index]; }
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+
+private:
+    constexpr static size_t INITIAL_CAPACITY = 32;
+
+    T* items = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+};
+
+template<typename T, size_t ALIGNMENT>
+ArenaVector<T, ALIGNMENT>::ArenaVector(ArenaVector&& other) noexcept : items(other.items), count(other.count), capacity(other.capacity)
+{
+    other.items = nullptr;
+    other.count = 0;
+    other.capacity = 0;
+}
+
+template<typename T, size_t ALIGNMENT>
+ArenaVector<T, ALIGNMENT>& ArenaVector<T, ALIGNMENT>::operator =(ArenaVector&& other) noexcept
+{
+    items = other.items;
+    count = other.count;
+    capacity = other.capacity;
+    other.items = nullptr;
+    other.count = 0;
+    other.capacity = 0;
+    return *this;
+}
+
+template<typename T, size_t ALIGNMENT>
+void ArenaVector<T, ALIGNMENT>::push_back(const T& value)
+{
+    if(count == capacity) {
+        reserve(capacity == 0 ? INITIAL_CAPACITY : capacity * 2);
+    }
+
+    items[count++] = value;
+}
+
+template<typename T, size_t ALIGNMENT>
+void ArenaVector<T, ALIGNMENT>::reserve(size_t newCapacity)
+{
+    if(newCapacity <= capacity) {
+        return;
+    }
+
+    FrameArena& arena = FrameArena::Get();
+    if(items == nullptr || !arena.TryExtend(items, capacity * sizeof(T), newCapacity * sizeof(T))) {
+        T* moved = static_cast<T*>(arena.Allocate(newCapacity * sizeof(T), ALIGNMENT));
+        if(count > 0) {
+            std::memcpy(moved, items, count * sizeof(T));
+        }
+        items = moved;
+    }
+
+    capacity = newCapacity;
+}
+
+template<typename T, size_t ALIGNMENT>
+void ArenaVector<T, ALIGNMENT>::clear()
+{
+    count = 0;
+}
@@ -0,0 +1,151 @@
+﻿#include "pch.h"
+#include "FrameStats.h"
+
+void PhaseSample::Add(const PhaseSample& other)
+{
+    for(int phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+        nanoseconds[phase] += other.nanoseconds[phase];
+    }
+
+    for(int counter = 0; counter < FRAME_COUNTER_COUNT; ++counter) {
+        counters[counter] += other.counters[counter];
+    }
+}
+
+PhaseSample& GetThreadSample()
+{
+    static thread_local PhaseSample sample;
+    return sample;
+}
+
+PhaseSample TakeThreadSample()
+{
+    PhaseSample& sample = GetThreadSample();
+    const PhaseSample taken = sample;
+    sample = PhaseSample{};
+    return taken;
+}
+
+PhaseTimer::PhaseTimer(FRAME_PHASE phase) : phase(phase), start(Clock::now()) {}
+
+PhaseTimer::~PhaseTimer()
+{
+    Switch(phase);
+}
+
+void PhaseTimer::Switch(FRAME_PHASE next)
+{
+    const Clock::time_point now = Clock::now();
+    GetThreadSample().nanoseconds[static_cast<int>(phase)] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+
+    phase = next;
+    start = now;
+}
+
+FrameProfiler::FrameProfiler(int window) : frames(std::max(1, window)), window(std::max(1, window))
+{
+    SetWorkerCount(1);
+}
+
+void FrameProfiler::SetWorkerCount(int count)
+{
+    while(static_cast<int>(rings.size()) < count) {
+        rings.push_back(std::make_unique<Ring>());
+    }
+}
+
+void FrameProfiler::Submit(int worker)
+{
+    if(!rings[worker]->Push(TakeThreadSample())) {
+        droppedSamples.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void FrameProfiler::EndFrame()
+{
+    PhaseSample frame;
+    PhaseSample sample;
+
+    for(const std::unique_ptr<Ring>& ring : rings) {
+        while(ring->Pop(sample)) {
+            frame.Add(sample);
+        }
+    }
+
+    frames[nextFrame] = frame;
+    nextFrame = (nextFrame + 1) % window;
+    framesCount = std::min(framesCount + 1, window);
+}
+
+void FrameProfiler::Clear()
+{
+    PhaseSample sample;
+    for(const std::unique_ptr<Ring>& ring : rings) {
+        while(ring->Pop(sample)) {}
+    }
+
+    nextFrame = 0;
+    framesCount = 0;
+    droppedSamples = 0;
+}
+
+FrameStats FrameProfiler::GetStats() const
+{
+    FrameStats stats;
+    stats.frames = framesCount;
+    stats.droppedSamples = droppedSamples.load(std::memory_order_relaxed);
+    if(framesCount == 0) {
+        return stats;
+    }
+
+    std::vector<double> phaseMs(framesCount);
+    for(int phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+        double sum = 0.0;
+        for(int frame = 0; frame < framesCount; ++frame) {
+            phaseMs[frame] = frames[frame].nanoseconds[phase] * 1e-6;
+            sum += phaseMs[frame];
+        }
+
+        // Nearest rank
+        const size_t p99Rank = static_cast<size_t>(std::ceil(0.99 * framesCount)) - 1;
+        std::nth_element(phaseMs.begin(), phaseMs.begin() + p99Rank, phaseMs.end());
+
+        PhaseStats& phaseStats = stats.phases[phase];
+        phaseStats.p99Ms = phaseMs[p99Rank];
+        phaseStats.minMs = *std::min_element(phaseMs.begin(), phaseMs.end());
+        phaseStats.meanMs = sum / framesCount;
+    }
+
+    uint64_t totals[FRAME_COUNTER_COUNT] = {};
+    for(int frame = 0; frame < framesCount; ++frame) {
+        for(int counter = 0; counter < FRAME_COUNTER_COUNT; ++counter) {
+            totals[counter] += frames[frame].counters[counter];
+        }
+    }
+
+    const uint64_t boids = totals[static_cast<int>(FRAME_COUNTER::BOIDS_UPDATED)];
+    stats.boidsPerFrame = static_cast<double>(boids) / framesCount;
+    stats.averageNeighbours = boids > 0 ? static_cast<double>(totals[static_cast<int>(FRAME_COUNTER::NEIGHBOURS)]) / boids : 0.0;
+    stats.raycastsPerFrame = static_cast<double>(totals[static_cast<int>(FRAME_COUNTER::RAYCASTS)]) / framesCount;
+    stats.neighbourListRebuildRate = static_cast<double>(totals[static_cast<int>(FRAME_COUNTER::NEIGHBOUR_LIST_REBUILDS)]) / framesCount;
+    stats.stealsPerFrame = static_cast<double>(totals[static_cast<int>(FRAME_COUNTER::STEALS)]) / framesCount;
+
+    const uint64_t capacity = totals[static_cast<int>(FRAME_COUNTER::WORKER_CAPACITY_NANOSECONDS)];
+    stats.workerUtilization = capacity > 0 ? static_cast<double>(totals[static_cast<int>(FRAME_COUNTER::WORKER_BUSY_NANOSECONDS)]) / capacity : 0.0;
+
+    // Everything a steering turn goes through, spread evenly over the turns taken
+    double steeringMs = 0.0;
+    for(FRAME_PHASE phase : {FRAME_PHASE::NEIGHBOUR_SEARCH, FRAME_PHASE::TYPE_FILTERING, FRAME_PHASE::STEERING, FRAME_PHASE::OBSTACLE_AVOIDANCE, FRAME_PHASE::INTEGRATION}) {
+        steeringMs += stats.phases[static_cast<int>(phase)].meanMs;
+    }
+    const double msPerTurn = stats.boidsPerFrame > 0.0 ? steeringMs / stats.boidsPerFrame : 0.0;
+
+    for(int band = 0; band < DISTANCE_BAND_COUNT; ++band) {
+        BandStats& bandStats = stats.bands[band];
+        bandStats.boidsPerFrame = static_cast<double>(totals[static_cast<int>(GetBandCounter(FRAME_COUNTER::BAND_BOIDS, band))]) / framesCount;
+        bandStats.steeredPerFrame = static_cast<double>(totals[static_cast<int>(GetBandCounter(FRAME_COUNTER::BAND_STEERED, band))]) / framesCount;
+        bandStats.savedMs = (bandStats.boidsPerFrame - bandStats.steeredPerFrame) * msPerTurn;
+    }
+
+    return stats;
+}
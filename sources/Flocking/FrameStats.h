@@ -0,0 +1,199 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "SimulationTypes.h"
+
+// Define FLOCKING_PROFILE=0 to compile the phase timers and counters out, GetFrameStats then reports zeros
+#ifndef FLOCKING_PROFILE
+#define FLOCKING_PROFILE 1
+#endif
+
+enum class FRAME_PHASE
+{
+    NEIGHBOUR_SEARCH,
+    TYPE_FILTERING,
+    STEERING,
+    OBSTACLE_AVOIDANCE,
+    INTEGRATION,
+    DEAD_COMPACTION,
+    SPATIAL_SORT
+};
+
+constexpr int FRAME_PHASE_COUNT = 7;
+
+enum class FRAME_COUNTER
+{
+    BOIDS_UPDATED,
+    NEIGHBOURS,
+    RAYCASTS,
+    NEIGHBOUR_LIST_REBUILDS,
+    // Scheduler of the parallel update, see SchedulerStats
+    STEALS,
+    WORKER_BUSY_NANOSECONDS,
+    WORKER_CAPACITY_NANOSECONDS,
+    // One counter per distance band from here, see GetBandCounter
+    BAND_BOIDS,
+    BAND_STEERED = BAND_BOIDS + DISTANCE_BAND_COUNT
+};
+
+constexpr int FRAME_COUNTER_COUNT = static_cast<int>(FRAME_COUNTER::BAND_STEERED) + DISTANCE_BAND_COUNT;
+
+inline FRAME_COUNTER GetBandCounter(FRAME_COUNTER first, int band)
+{
+    return static_cast<FRAME_COUNTER>(static_cast<int>(first) + band);
+}
+
+// Time and counters one thread spent on a frame
+struct PhaseSample
+{
+    void Add(const PhaseSample& other);
+
+    uint64_t nanoseconds[FRAME_PHASE_COUNT] = {};
+    uint64_t counters[FRAME_COUNTER_COUNT] = {};
+};
+
+// Accumulates into the calling thread's sample until TakeThreadSample hands it over
+PhaseSample& GetThreadSample();
+PhaseSample TakeThreadSample();
+
+// Charges the time since construction or the last Switch to the current phase
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(FRAME_PHASE phase);
+    ~PhaseTimer();
+
+    void Switch(FRAME_PHASE next);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    FRAME_PHASE phase;
+    Clock::time_point start;
+};
+
+#if FLOCKING_PROFILE
+#define FLOCKING_PHASE_TIMER(name, phase) PhaseTimer name(phase)
+#define FLOCKING_PHASE_SWITCH(name, phase) name.Switch(phase)
+#define FLOCKING_COUNT(counter, value) (GetThreadSample().counters[static_cast<int>(counter)] += static_cast<uint64_t>(value))
+#else
+#define FLOCKING_PHASE_TIMER(name, phase)
+#define FLOCKING_PHASE_SWITCH(name, phase)
+#define FLOCKING_COUNT(counter, value) ((void)0)
+#endif
+
+// Lock-free single producer, single consumer queue of a fixed capacity
+template<typename T, size_t CAPACITY>
+class SpscRing
+{
+public:
+    // False when full, the item is dropped
+    bool Push(const T& item);
+    bool Pop(T& item);
+    // From the producer, only it can fill the ring so a false answer holds until its next Push
+    bool IsFull() const;
+
+private:
+    T items[CAPACITY];
+    std::atomic<size_t> head = 0;
+    std::atomic<size_t> tail = 0;
+};
+
+struct PhaseStats
+{
+    double minMs = 0.0;
+    double meanMs = 0.0;
+    double p99Ms = 0.0;
+};
+
+struct BandStats
+{
+    double boidsPerFrame = 0.0;
+    // Boids of the band that took their steering turn
+    double steeredPerFrame = 0.0;
+    // Skipped steering turns of the band times the mean cost of a steering turn, CPU time like the phases
+    double savedMs = 0.0;
+};
+
+// Over the last frames of the window. Phase times are summed over all threads, so parallel updates report CPU time
+struct FrameStats
+{
+    PhaseStats phases[FRAME_PHASE_COUNT];
+
+    int frames = 0;
+    double boidsPerFrame = 0.0;
+    double averageNeighbours = 0.0;
+    double raycastsPerFrame = 0.0;
+    // Share of the updates that rebuilt the Verlet neighbour lists
+    double neighbourListRebuildRate = 0.0;
+    // Ranges the parallel update's workers took from each other, and the share of their time spent inside tasks
+    double stealsPerFrame = 0.0;
+    double workerUtilization = 0.0;
+    uint64_t droppedSamples = 0;
+    // Current level of the frame budget governor, 0 at full quality
+    int lodLevel = 0;
+    BandStats bands[DISTANCE_BAND_COUNT];
+};
+
+// Per-worker rings filled by the threads as they finish their share of a frame, drained once per frame
+class FrameProfiler
+{
+public:
+    explicit FrameProfiler(int window);
+
+    void SetWorkerCount(int count);
+    // Moves the calling thread's sample into the worker's ring
+    void Submit(int worker);
+    void EndFrame();
+    void Clear();
+
+    FrameStats GetStats() const;
+
+private:
+    constexpr static size_t RING_CAPACITY = 64;
+    using Ring = SpscRing<PhaseSample, RING_CAPACITY>;
+
+    std::vector<std::unique_ptr<Ring>> rings;
+
+    std::vector<PhaseSample> frames;
+    int window;
+    int nextFrame = 0;
+    int framesCount = 0;
+    std::atomic<uint64_t> droppedSamples = 0;
+};
+
+template<typename T, size_t CAPACITY>
+bool SpscRing<T, CAPACITY>::Push(const T& item)
+{
+    const size_t currentTail = tail.load(std::memory_order_relaxed);
+    if(currentTail - head.load(std::memory_order_acquire) == CAPACITY) {
+        return false;
+    }
+
+    items[currentTail % CAPACITY] = item;
+    tail.store(currentTail + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T, size_t CAPACITY>
+bool SpscRing<T, CAPACITY>::IsFull() const
+{
+    return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) == CAPACITY;
+}
+
+template<typename T, size_t CAPACITY>
+bool SpscRing<T, CAPACITY>::Pop(T& item)
+{
+    const size_t currentHead = head.load(std::memory_order_relaxed);
+    if(currentHead == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    item = items[currentHead % CAPACITY];
+    head.store(currentHead + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,234 @@
+﻿#include "pch.h"
+#include "KdTree.h"
+
+NEIGHBOUR_BACKEND KdTree::GetBackend() const
+{
+    return NEIGHBOUR_BACKEND::KD_TREE;
+}
+
+void KdTree::Build(const PositionLanes& positions, const RVector3& minPoint, const RVector3& maxPoint, float queryRadius)
+{
+    // Any partition of the ids stays correct once refitted, so a refit only needs the same set of ids
+    if(positions.count != static_cast<int>(ids.size()) || nodes.empty()) {
+        Split(positions);
+        return;
+    }
+
+    for(size_t i = 0; i < ids.size(); ++i) {
+        const int id = ids[i];
+        points[i] = {positions.x[id], positions.y[id], positions.z[id]};
+    }
+    Refit();
+
+    if(GetLeafVolume() > splitLeafVolume * MAX_LEAF_GROWTH) {
+        Split(positions);
+    }
+}
+
+void KdTree::Split(const PositionLanes& positions)
+{
+    const int count = positions.count;
+
+    depth = 0;
+    while((count >> depth) > LEAF_SIZE) {
+        ++depth;
+    }
+    nodes.resize((size_t{2} << depth) - 1);
+
+    ids.resize(count);
+    points.resize(count);
+    for(int id = 0; id < count; ++id) {
+        ids[id] = id;
+        points[id] = {positions.x[id], positions.y[id], positions.z[id]};
+    }
+
+    SplitNode(0, 0, count, 0);
+
+    // The split moved the ids, points follow them into tree order
+    for(int i = 0; i < count; ++i) {
+        const int id = ids[i];
+        points[i] = {positions.x[id], positions.y[id], positions.z[id]};
+    }
+    Refit();
+
+    splitLeafVolume = GetLeafVolume();
+    ++rebuildCount;
+}
+
+void KdTree::SplitNode(int node, int begin, int end, int level)
+{
+    nodes[node].begin = begin;
+    nodes[node].end = end;
+
+    if(level == depth) {
+        return;
+    }
+
+    RVector3 min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    RVector3 max = -min;
+    for(int i = begin; i < end; ++i) {
+        const RVector3& point = points[ids[i]];
+        for(int axis = 0; axis < 3; ++axis) {
+            min[axis] = std::min(min[axis], point[axis]);
+            max[axis] = std::max(max[axis], point[axis]);
+        }
+    }
+
+    const RVector3 size = max - min;
+    const int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+    const int middle = begin + (end - begin) / 2;
+    std::nth_element(ids.begin() + begin, ids.begin() + middle, ids.begin() + end, [this, axis](int a, int b)
+    {
+        return points[a][axis] < points[b][axis];
+    });
+
+    SplitNode(2 * node + 1, begin, middle, level + 1);
+    SplitNode(2 * node + 2, middle, end, level + 1);
+}
+
+void KdTree::Refit()
+{
+    const int firstLeaf = static_cast<int>(nodes.size() / 2);
+
+    for(int node = static_cast<int>(nodes.size()) - 1; node >= 0; --node) {
+        Node& current = nodes[node];
+
+        if(node >= firstLeaf) {
+            current.min = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+            current.max = -current.min;
+            for(int i = current.begin; i < current.end; ++i) {
+                for(int axis = 0; axis < 3; ++axis) {
+                    current.min[axis] = std::min(current.min[axis], points[i][axis]);
+                    current.max[axis] = std::max(current.max[axis], points[i][axis]);
+                }
+            }
+            continue;
+        }
+
+        const Node& left = nodes[2 * node + 1];
+        const Node& right = nodes[2 * node + 2];
+        for(int axis = 0; axis < 3; ++axis) {
+            current.min[axis] = std::min(left.min[axis], right.min[axis]);
+            current.max[axis] = std::max(left.max[axis], right.max[axis]);
+        }
+    }
+}
+
+float KdTree::GetLeafVolume() const
+{
+    float volume = 0.f;
+    for(size_t node = nodes.size() / 2; node < nodes.size(); ++node) {
+        const Node& leaf = nodes[node];
+        if(leaf.begin < leaf.end) {
+            const RVector3 size = leaf.max - leaf.min;
+            volume += size.x * size.y * size.z;
+        }
+    }
+
+    return volume;
+}
+
+void KdTree::Query(const RVector3& position, float radius, IdList& candidates) const
+{
+    if(nodes.empty()) {
+        return;
+    }
+
+    const float radius_2 = (radius + GetDrift()) * (radius + GetDrift());
+    const int firstLeaf = static_cast<int>(nodes.size() / 2);
+
+    // Heap order needs no child pointers, one slot per level is enough for the pending siblings
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    while(top > 0) {
+        const int index = stack[--top];
+        const Node& node = nodes[index];
+        if(GetDistanceSquare(node, position) > radius_2) {
+            continue;
+        }
+
+        if(index < firstLeaf) {
+            stack[top++] = 2 * index + 2;
+            stack[top++] = 2 * index + 1;
+            continue;
+        }
+
+        for(int i = node.begin; i < node.end; ++i) {
+            const RVector3 offset = points[i] - position;
+            if(offset.lengthSquare() <= radius_2) {
+                candidates.push_back(ids[i]);
+            }
+        }
+    }
+}
+
+void KdTree::QueryNearest(const RVector3& position, float radius, const CandidateTest& test, NearestNeighbours& nearest) const
+{
+    if(nodes.empty()) {
+        return;
+    }
+
+    const float radius_2 = radius * radius;
+    const int firstLeaf = static_cast<int>(nodes.size() / 2);
+
+    struct Pending
+    {
+        int node;
+        float distance_2;
+    };
+
+    Pending stack[64];
+    int top = 0;
+    // Nodes bound where their boids were at the build, the drift brings them closer
+    stack[top++] = {0, GetDriftedDistanceSquare(GetDistanceSquare(nodes[0], position))};
+
+    while(top > 0) {
+        const Pending pending = stack[--top];
+        if(pending.distance_2 > radius_2 || (nearest.IsFull() && pending.distance_2 > nearest.GetFarthest())) {
+            continue;
+        }
+
+        if(pending.node < firstLeaf) {
+            const int left = 2 * pending.node + 1;
+            const int right = left + 1;
+            const float leftDistance_2 = GetDriftedDistanceSquare(GetDistanceSquare(nodes[left], position));
+            const float rightDistance_2 = GetDriftedDistanceSquare(GetDistanceSquare(nodes[right], position));
+
+            // The nearer child goes on top, it is searched first and tightens the bound for the other one
+            if(leftDistance_2 <= rightDistance_2) {
+                stack[top++] = {right, rightDistance_2};
+                stack[top++] = {left, leftDistance_2};
+            } else {
+                stack[top++] = {left, leftDistance_2};
+                stack[top++] = {right, rightDistance_2};
+            }
+            continue;
+        }
+
+        const Node& leaf = nodes[pending.node];
+        for(int i = leaf.begin; i < leaf.end; ++i) {
+            const float distance_2 = test(ids[i]);
+            if(distance_2 >= 0.f) {
+                nearest.Offer(distance_2, ids[i]);
+            }
+        }
+    }
+}
+
+float KdTree::GetDistanceSquare(const Node& node, const RVector3& position) const
+{
+    float distance_2 = 0.f;
+    for(int axis = 0; axis < 3; ++axis) {
+        const float outside = std::max({node.min[axis] - position[axis], 0.f, position[axis] - node.max[axis]});
+        distance_2 += outside * outside;
+    }
+
+    return distance_2;
+}
+
+int KdTree::GetRebuildCount() const
+{
+    return rebuildCount;
+}
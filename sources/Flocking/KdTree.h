@@ -0,0 +1,54 @@
+﻿#pragma once
+#include "pch.h"
+#include "NeighbourIndex.h"
+
+using std::vector;
+
+// Balanced k-d tree with a fixed shape: every node halves its range of points along its longest axis.
+// Positions change little between updates, so a build only refits the node bounds over the previous
+// partition and splits anew once the refitted leaves have grown too loose. Adapts to any density,
+// sparse patrols and dense swarms alike, at the price of a tree walk per query.
+class KdTree : public INeighbourIndex
+{
+public:
+    NEIGHBOUR_BACKEND GetBackend() const override;
+    void Build(const PositionLanes& positions, const RVector3& minPoint, const RVector3& maxPoint, float queryRadius) override;
+    void Query(const RVector3& position, float radius, IdList& candidates) const override;
+    // Descends into the nearer child first and skips every node farther than the farthest kept boid
+    void QueryNearest(const RVector3& position, float radius, const CandidateTest& test, NearestNeighbours& nearest) const override;
+
+    // Full splits since construction, the other builds were refits
+    int GetRebuildCount() const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    constexpr static int LEAF_SIZE = 16;
+    // Split anew once the leaves cover this much more volume than right after the last split
+    constexpr static float MAX_LEAF_GROWTH = 2.f;
+
+    struct Node
+    {
+        RVector3 min;
+        RVector3 max;
+        int begin = 0;
+        int end = 0;
+    };
+
+    void Split(const PositionLanes& positions);
+    void SplitNode(int node, int begin, int end, int depth);
+    void Refit();
+    float GetLeafVolume() const;
+    float GetDistanceSquare(const Node& node, const RVector3& position) const;
+
+    // Nodes in heap order, the children of node n are 2n + 1 and 2n + 2, the last level are the leaves
+    vector<Node> nodes;
+    int depth = 0;
+
+    // Ids in tree order and their positions at the last build, so leaves read contiguous memory
+    vector<int> ids;
+    vector<RVector3> points;
+
+    float splitLeafVolume = 0.f;
+    int rebuildCount = 0;
+};
@@ -1,5 +1,9 @@
 ﻿#pragma once
+#ifdef _MSC_VER
 #include <corecrt_math_defines.h>
+#else
+#include <cmath>
+#endif
 #include <random>
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,68 @@
+﻿#include "pch.h"
+#include "MortonOrder.h"
+
+const vector<int>& MortonOrder::GetOrder() const
+{
+    return order;
+}
+
+const vector<uint32_t>& MortonOrder::GetCodes() const
+{
+    return codes;
+}
+
+uint32_t MortonOrder::SpreadBits(uint32_t value)
+{
+    // Two zero bits after every bit of the 10 bit value
+    value &= 0x000003ff;
+    value = (value | (value << 16)) & 0xff0000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+uint32_t MortonOrder::GetCode(const RVector3& position, const RVector3& minPoint, const RVector3& maxPoint)
+{
+    constexpr float CELLS = static_cast<float>(1 << BITS_PER_AXIS);
+
+    uint32_t cell[3];
+    for(int axis = 0; axis < 3; ++axis) {
+        const float size = maxPoint[axis] - minPoint[axis];
+        const float normalized = size > 0.f ? (position[axis] - minPoint[axis]) / size : 0.f;
+        cell[axis] = static_cast<uint32_t>(std::clamp(normalized * CELLS, 0.f, CELLS - 1.f));
+    }
+
+    return SpreadBits(cell[0]) | (SpreadBits(cell[1]) << 1) | (SpreadBits(cell[2]) << 2);
+}
+
+void MortonOrder::Sort()
+{
+    constexpr int BUCKETS = 1 << RADIX_BITS;
+
+    const size_t count = codes.size();
+    sortedCodes.resize(count);
+    sortedOrder.resize(count);
+
+    // Least significant digit first, every pass is stable so the order of the earlier ones survives
+    for(int pass = 0; pass < RADIX_PASSES; ++pass) {
+        const int shift = pass * RADIX_BITS;
+
+        size_t starts[BUCKETS + 1] = {};
+        for(uint32_t code : codes) {
+            ++starts[((code >> shift) & (BUCKETS - 1)) + 1];
+        }
+        for(int bucket = 1; bucket <= BUCKETS; ++bucket) {
+            starts[bucket] += starts[bucket - 1];
+        }
+
+        for(size_t i = 0; i < count; ++i) {
+            const size_t target = starts[(codes[i] >> shift) & (BUCKETS - 1)]++;
+            sortedCodes[target] = codes[i];
+            sortedOrder[target] = order[i];
+        }
+
+        codes.swap(sortedCodes);
+        order.swap(sortedOrder);
+    }
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+#include <cstdint>
+
+#include "pch.h"
+
+using std::vector;
+
+// Ids sorted along a Z-order curve through the simulation bounds, so boids close in space end up close in memory
+class MortonOrder
+{
+public:
+    // GetOrder()[i] is the id that goes to position i, boids with equal codes keep their relative order
+    template<typename GetPosition>
+    void Build(int count, GetPosition&& getPosition, const RVector3& minPoint, const RVector3& maxPoint);
+    // Same order for codes computed by the caller, codeOf(id) returns the code of id
+    template<typename CodeOf>
+    void BuildFromCodes(int count, CodeOf&& codeOf);
+    // Sorted codes, GetCodes()[i] belongs to GetOrder()[i]
+    const vector<uint32_t>& GetCodes() const;
+
+    const vector<int>& GetOrder() const;
+
+    // BITS_PER_AXIS bits of every axis interleaved, positions outside the bounds are clamped to them
+    static uint32_t GetCode(const RVector3& position, const RVector3& minPoint, const RVector3& maxPoint);
+
+#ifndef DEBUG
+// protected:
+#endif
+    constexpr static int BITS_PER_AXIS = 10;
+    constexpr static int RADIX_BITS = 8;
+    constexpr static int RADIX_PASSES = (3 * BITS_PER_AXIS + RADIX_BITS - 1) / RADIX_BITS;
+
+    static uint32_t SpreadBits(uint32_t value);
+    void Sort();
+
+    vector<uint32_t> codes;
+    vector<uint32_t> sortedCodes;
+    vector<int> order;
+    vector<int> sortedOrder;
+};
+
+template<typename GetPosition>
+void MortonOrder::Build(int count, GetPosition&& getPosition, const RVector3& minPoint, const RVector3& maxPoint)
+{
+    BuildFromCodes(count, [&](int id) { return GetCode(getPosition(id), minPoint, maxPoint); });
+}
+
+template<typename CodeOf>
+void MortonOrder::BuildFromCodes(int count, CodeOf&& codeOf)
+{
+    codes.resize(count);
+    order.resize(count);
+
+    for(int id = 0; id < count; ++id) {
+        codes[id] = codeOf(id);
+        order[id] = id;
+    }
+
+    Sort();
+}
@@ -0,0 +1,131 @@
+﻿#include "pch.h"
+#include "MortonSweep.h"
+
+namespace
+{
+    // Bits of every axis, x is bit 0 of each triple
+    constexpr uint32_t AXIS_BITS = 0x09249249;
+
+    // Bits of the same axis as bit below it
+    uint32_t GetLowerBitsOfAxis(int bit)
+    {
+        return (AXIS_BITS << (bit % 3)) & ((1u << bit) - 1);
+    }
+
+    // Sets bit and clears the lower bits of its axis: the lowest code of the upper half along that axis
+    uint32_t LoadUpperHalf(uint32_t value, int bit)
+    {
+        return (value | (1u << bit)) & ~GetLowerBitsOfAxis(bit);
+    }
+
+    // Clears bit and sets the lower bits of its axis: the highest code of the lower half along that axis
+    uint32_t LoadLowerHalf(uint32_t value, int bit)
+    {
+        return (value & ~(1u << bit)) | GetLowerBitsOfAxis(bit);
+    }
+}
+
+NEIGHBOUR_BACKEND MortonSweep::GetBackend() const
+{
+    return NEIGHBOUR_BACKEND::MORTON_SWEEP;
+}
+
+void MortonSweep::Build(const PositionLanes& positions, const RVector3& minPoint, const RVector3& maxPoint, float queryRadius)
+{
+    const RVector3 size = maxPoint - minPoint;
+    const float longestAxis = std::max({size.x, size.y, size.z});
+    const float cellSize = std::max({queryRadius / CELLS_PER_RADIUS, longestAxis / CELLS_PER_AXIS, std::numeric_limits<float>::min()});
+
+    origin = minPoint;
+    inverseCellSize = 1.f / cellSize;
+
+    const auto getPosition = [&positions](int id) { return RVector3{positions.x[id], positions.y[id], positions.z[id]}; };
+    order.BuildFromCodes(positions.count, [this, &getPosition](int id) { return GetCode(getPosition(id)); });
+
+    const vector<int>& sorted = order.GetOrder();
+    ids.assign(sorted.begin(), sorted.end());
+    points.resize(sorted.size());
+    for(size_t i = 0; i < sorted.size(); ++i) {
+        points[i] = getPosition(sorted[i]);
+    }
+}
+
+uint32_t MortonSweep::GetCellCoord(float value, int axis) const
+{
+    const int coord = static_cast<int>(std::floor((value - origin[axis]) * inverseCellSize));
+    return static_cast<uint32_t>(std::clamp(coord, 0, CELLS_PER_AXIS - 1));
+}
+
+uint32_t MortonSweep::GetCode(const RVector3& position) const
+{
+    return MortonOrder::SpreadBits(GetCellCoord(position.x, 0)) |
+           (MortonOrder::SpreadBits(GetCellCoord(position.y, 1)) << 1) |
+           (MortonOrder::SpreadBits(GetCellCoord(position.z, 2)) << 2);
+}
+
+void MortonSweep::Query(const RVector3& position, float radius, IdList& candidates) const
+{
+    const float reach = radius + GetDrift();
+    const float radius_2 = reach * reach;
+    const RVector3 extent{reach, reach, reach};
+    const uint32_t zmin = GetCode(position - extent);
+    const uint32_t zmax = GetCode(position + extent);
+
+    const vector<uint32_t>& codes = order.GetCodes();
+    auto it = std::lower_bound(codes.begin(), codes.end(), zmin);
+    while(it != codes.end() && *it <= zmax) {
+        if(!IsInBox(*it, zmin, zmax)) {
+            it = std::lower_bound(it + 1, codes.end(), GetNextInBox(*it, zmin, zmax));
+            continue;
+        }
+
+        const size_t i = it - codes.begin();
+        const RVector3 offset = points[i] - position;
+        if(offset.lengthSquare() <= radius_2) {
+            candidates.push_back(ids[i]);
+        }
+        ++it;
+    }
+}
+
+bool MortonSweep::IsInBox(uint32_t code, uint32_t zmin, uint32_t zmax)
+{
+    // Masking keeps the order of the coordinates along one axis, no need to compact the bits
+    for(int axis = 0; axis < 3; ++axis) {
+        const uint32_t mask = AXIS_BITS << axis;
+        const uint32_t coord = code & mask;
+        if(coord < (zmin & mask) || coord > (zmax & mask)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t MortonSweep::GetNextInBox(uint32_t code, uint32_t zmin, uint32_t zmax)
+{
+    uint32_t next = zmax;
+
+    for(int bit = 3 * MortonOrder::BITS_PER_AXIS - 1; bit >= 0; --bit) {
+        const uint32_t mask = 1u << bit;
+        const bool codeBit = (code & mask) != 0;
+        const bool minBit = (zmin & mask) != 0;
+        const bool maxBit = (zmax & mask) != 0;
+
+        if(!codeBit && !minBit && maxBit) {
+            // The box straddles the split, remember its upper half and keep searching the lower one
+            next = LoadUpperHalf(zmin, bit);
+            zmax = LoadLowerHalf(zmax, bit);
+        } else if(!codeBit && minBit && maxBit) {
+            // Code lies below the box
+            return zmin;
+        } else if(codeBit && !minBit && !maxBit) {
+            // Code lies above what is left of the box, the remembered upper half comes next
+            return next;
+        } else if(codeBit && !minBit && maxBit) {
+            zmin = LoadUpperHalf(zmin, bit);
+        }
+    }
+
+    return next;
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <cstdint>
+
+#include "pch.h"
+#include "MortonOrder.h"
+#include "NeighbourIndex.h"
+
+using std::vector;
+
+// Boids sorted by the Morton code of a fine grid over the simulation bounds. A query turns its bounding box
+// into the code range [zmin, zmax] and sweeps it with binary searches, jumping over the parts of the curve
+// that leave the box. No per-cell storage at all, so it stays small when the bounds are huge and sparse.
+class MortonSweep : public INeighbourIndex
+{
+public:
+    NEIGHBOUR_BACKEND GetBackend() const override;
+    void Build(const PositionLanes& positions, const RVector3& minPoint, const RVector3& maxPoint, float queryRadius) override;
+    void Query(const RVector3& position, float radius, IdList& candidates) const override;
+
+#ifndef DEBUG
+// protected:
+#endif
+    constexpr static int CELLS_PER_AXIS = 1 << MortonOrder::BITS_PER_AXIS;
+    // Cells of twice the query radius: a query box spans at most 2 cells per axis, so the sweep takes few jumps.
+    // Finer cells fit the sphere tighter but cost more jumps than the candidates they save
+    constexpr static float CELLS_PER_RADIUS = 0.5f;
+
+    uint32_t GetCellCoord(float value, int axis) const;
+    uint32_t GetCode(const RVector3& position) const;
+
+    static bool IsInBox(uint32_t code, uint32_t zmin, uint32_t zmax);
+    // Smallest code above code inside the box spanned by zmin and zmax (Tropf and Herzog)
+    static uint32_t GetNextInBox(uint32_t code, uint32_t zmin, uint32_t zmax);
+
+    RVector3 origin;
+    float inverseCellSize = 1.f;
+
+    MortonOrder order;
+    // In curve order, the codes are in order
+    vector<int> ids;
+    vector<RVector3> points;
+};
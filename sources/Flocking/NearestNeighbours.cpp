@@ -0,0 +1,22 @@
+﻿#include "pch.h"
+#include "NearestNeighbours.h"
+
+NearestNeighbours::NearestNeighbours(int count) : count(count)
+{
+    heap.reserve(count);
+}
+
+int NearestNeighbours::Size() const
+{
+    return static_cast<int>(heap.size());
+}
+
+bool NearestNeighbours::IsFull() const
+{
+    return static_cast<int>(heap.size()) >= count;
+}
+
+float NearestNeighbours::GetFarthest() const
+{
+    return heap.empty() ? std::numeric_limits<float>::max() : heap[0].distance_2;
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+#include <algorithm>
+
+#include "pch.h"
+#include "FrameArena.h"
+
+// Bounded max-heap keeping the count nearest of the boids offered to it. The farthest kept boid sits on top and
+// is the one replaced, so a boid costs count entries whatever the density around it.
+// Ties in distance go to the lower id, the kept set does not depend on the order candidates come in.
+class NearestNeighbours
+{
+public:
+    // The heap lives in the frame arena of the calling thread
+    explicit NearestNeighbours(int count);
+
+    void Offer(float distance_2, int id);
+
+    // Kept ids in ascending order, like a scan over every boid would find them. Leaves the heap unordered
+    template<typename Visitor>
+    void ForEachById(Visitor&& visitor);
+
+    int Size() const;
+    // Once full, a candidate farther than GetFarthest() can no longer get in, so a search can stop before it
+    bool IsFull() const;
+    float GetFarthest() const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    struct Entry
+    {
+        float distance_2;
+        int id;
+
+        bool operator <(const Entry& other) const
+        {
+            return distance_2 < other.distance_2 || (distance_2 == other.distance_2 && id < other.id);
+        }
+    };
+
+    ArenaVector<Entry> heap;
+    int count;
+};
+
+inline void NearestNeighbours::Offer(float distance_2, int id)
+{
+    const Entry entry{distance_2, id};
+
+    if(static_cast<int>(heap.size()) < count) {
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end());
+    } else if(count > 0 && entry < heap[0]) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap[heap.size() - 1] = entry;
+        std::push_heap(heap.begin(), heap.end());
+    }
+}
+
+template<typename Visitor>
+void NearestNeighbours::ForEachById(Visitor&& visitor)
+{
+    std::sort(heap.begin(), heap.end(), [](const Entry& a, const Entry& b) { return a.id < b.id; });
+
+    for(const Entry& entry : heap) {
+        visitor(entry.id);
+    }
+}
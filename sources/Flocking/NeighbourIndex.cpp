@@ -0,0 +1,69 @@
+﻿#include "pch.h"
+#include "NeighbourIndex.h"
+#include "KdTree.h"
+#include "MortonSweep.h"
+#include "SpatialGrid.h"
+
+void INeighbourIndex::SetSource(const void* source, size_t size)
+{
+    this->source = source;
+    sourceSize = size;
+}
+
+bool INeighbourIndex::IsBuiltFor(const void* source, size_t size) const
+{
+    return this->source == source && sourceSize == size;
+}
+
+void INeighbourIndex::Invalidate()
+{
+    source = nullptr;
+    sourceSize = 0;
+}
+
+void INeighbourIndex::SetDrift(float drift)
+{
+    this->drift = std::max(drift, 0.f);
+}
+
+float INeighbourIndex::GetDrift() const
+{
+    return drift;
+}
+
+float INeighbourIndex::GetDriftedDistanceSquare(float distance_2) const
+{
+    if(drift <= 0.f) {
+        return distance_2;
+    }
+
+    const float distance = std::max(std::sqrt(distance_2) - drift, 0.f);
+    return distance * distance;
+}
+
+void INeighbourIndex::QueryNearest(const RVector3& position, float radius, const CandidateTest& test, NearestNeighbours& nearest) const
+{
+    // The heap of nearest is reserved up front and never grows, rewinding the candidates leaves it alone
+    ArenaScope scope;
+    IdList candidates;
+    Query(position, radius, candidates);
+
+    for(int id : candidates) {
+        const float distance_2 = test(id);
+        if(distance_2 >= 0.f) {
+            nearest.Offer(distance_2, id);
+        }
+    }
+}
+
+std::unique_ptr<INeighbourIndex> CreateNeighbourIndex(NEIGHBOUR_BACKEND backend)
+{
+    switch(backend) {
+    case NEIGHBOUR_BACKEND::KD_TREE:
+        return std::make_unique<KdTree>();
+    case NEIGHBOUR_BACKEND::MORTON_SWEEP:
+        return std::make_unique<MortonSweep>();
+    default:
+        return std::make_unique<SpatialGrid>();
+    }
+}
@@ -0,0 +1,77 @@
+﻿#pragma once
+#include "pch.h"
+#include "FrameArena.h"
+#include "NearestNeighbours.h"
+#include "SimulationTypes.h"
+
+// Ids of candidate neighbours, only valid until the enclosing ArenaScope ends
+using IdList = ArenaVector<int>;
+
+// Positions an index is built from, one lane per axis
+struct PositionLanes
+{
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* z = nullptr;
+    int count = 0;
+};
+
+// Non-owning callable, called as test(int id) -> float: the squared distance of a candidate that counts,
+// negative for one that does not
+class CandidateTest
+{
+public:
+    template<typename Function>
+    CandidateTest(const Function& function) :
+        function(&function),
+        invoke([](const void* function, int id) { return (*static_cast<const Function*>(function))(id); })
+    {}
+
+    float operator ()(int id) const
+    {
+        return invoke(function, id);
+    }
+
+private:
+    const void* function;
+    float (*invoke)(const void* function, int id);
+};
+
+// Spatial index over a snapshot of the boid positions, rebuilt by FlockingSimulation before every update.
+// Between two builds Query is const and may be called from any number of threads.
+class INeighbourIndex
+{
+public:
+    virtual ~INeighbourIndex() = default;
+
+    virtual NEIGHBOUR_BACKEND GetBackend() const = 0;
+
+    // queryRadius is the largest radius the update will query with, engines size their cells for it
+    virtual void Build(const PositionLanes& positions, const RVector3& minPoint, const RVector3& maxPoint, float queryRadius) = 0;
+    // Appends the ids of every boid within radius of position, and possibly of a few further away. Boids are
+    // found by where they were at the build, engines widen the radius by the drift so moved boids are still found
+    virtual void Query(const RVector3& position, float radius, IdList& candidates) const = 0;
+    // Offers every candidate within radius that passes test to nearest. The default tests them all,
+    // engines that can visit space nearest first stop once nothing left can beat the farthest kept one
+    virtual void QueryNearest(const RVector3& position, float radius, const CandidateTest& test, NearestNeighbours& nearest) const;
+
+    // The positions the last Build was made from, so the AoS Perform can tell whether the index matches its boids
+    void SetSource(const void* source, size_t size);
+    bool IsBuiltFor(const void* source, size_t size) const;
+    void Invalidate();
+
+    // How far a boid may have moved since the build, the in-place updates query while boids move
+    void SetDrift(float drift);
+    float GetDrift() const;
+
+protected:
+    // Squared distance a boid stored distance_2 away from a query may have come as close as
+    float GetDriftedDistanceSquare(float distance_2) const;
+
+private:
+    const void* source = nullptr;
+    size_t sourceSize = 0;
+    float drift = 0.f;
+};
+
+std::unique_ptr<INeighbourIndex> CreateNeighbourIndex(NEIGHBOUR_BACKEND backend);
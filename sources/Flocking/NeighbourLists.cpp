@@ -0,0 +1,86 @@
+﻿#include "pch.h"
+#include "NeighbourLists.h"
+
+void NeighbourLists::Invalidate()
+{
+    valid = false;
+}
+
+bool NeighbourLists::IsValid() const
+{
+    return valid;
+}
+
+bool NeighbourLists::NeedsRebuild(const BoidStorage& storage, const BoidSlots& slots, float radius, float skin, float pendingStep) const
+{
+    if(!valid || radius != this->radius) {
+        return true;
+    }
+
+    // The two largest displacements bound how much closer any pair can have come
+    float largest_2 = 0.f;
+    float secondLargest_2 = 0.f;
+    for(int id = 0; id < storage.Size(); ++id) {
+        const RVector3& position = built[slots.GetSlot(id)];
+        const float dx = storage.px[id] - position.x;
+        const float dy = storage.py[id] - position.y;
+        const float dz = storage.pz[id] - position.z;
+        const float displacement_2 = dx * dx + dy * dy + dz * dz;
+
+        if(displacement_2 > largest_2) {
+            secondLargest_2 = largest_2;
+            largest_2 = displacement_2;
+        } else if(displacement_2 > secondLargest_2) {
+            secondLargest_2 = displacement_2;
+        }
+    }
+
+    // The gathering boid has not taken its pending step yet, the other end of the pair may have
+    return std::sqrt(largest_2) + std::sqrt(secondLargest_2) + pendingStep > skin;
+}
+
+void NeighbourLists::BeginRebuild(const BoidStorage& storage, const BoidSlots& slots, float radius, int workerCount)
+{
+    this->radius = radius;
+    valid = false;
+
+    const size_t slotCount = slots.GetSlotCount();
+    ranges.assign(slotCount, Range{});
+    built.resize(slotCount);
+
+    candidates.resize(workerCount);
+    for(vector<uint32_t>& workerCandidates : candidates) {
+        workerCandidates.clear();
+    }
+
+    for(int id = 0; id < storage.Size(); ++id) {
+        built[slots.GetSlot(id)] = storage.GetPosition(id);
+    }
+}
+
+void NeighbourLists::EndRebuild()
+{
+    valid = true;
+}
+
+const uint32_t* NeighbourLists::Begin(uint32_t slot) const
+{
+    const Range& range = ranges[slot];
+    return candidates[range.worker].data() + range.begin;
+}
+
+const uint32_t* NeighbourLists::End(uint32_t slot) const
+{
+    const Range& range = ranges[slot];
+    return candidates[range.worker].data() + range.begin + range.count;
+}
+
+int NeighbourLists::GetCount(uint32_t slot) const
+{
+    return ranges[slot].count;
+}
+
+float NeighbourLists::GetRadius() const
+{
+    return radius;
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+#include "BoidHandle.h"
+#include "BoidStorage.h"
+
+// Verlet lists: the candidates of every boid within the view radius plus a skin, reused over frames.
+// Two boids can only cross the skin once their combined motion since the build exceeds it,
+// so until then filtering the cached candidates finds the same neighbours as a fresh search.
+// Lists are kept per slot, compacting dead boids away leaves them valid, spawning does not.
+class NeighbourLists
+{
+public:
+    void Invalidate();
+    bool IsValid() const;
+
+    // True when the lists are missing, were built for another radius or the motion since the build may have crossed the skin.
+    // pendingStep is how far a boid can still move before the last gather using the lists
+    bool NeedsRebuild(const BoidStorage& storage, const BoidSlots& slots, float radius, float skin, float pendingStep) const;
+
+    // Between BeginRebuild and EndRebuild every slot is filled once, by any of workerCount threads at the same time
+    void BeginRebuild(const BoidStorage& storage, const BoidSlots& slots, float radius, int workerCount);
+    // Calls forEachCandidate(add) and stores the slots it adds as the list of slot
+    template<typename ForEachCandidate>
+    void Fill(int worker, uint32_t slot, ForEachCandidate&& forEachCandidate);
+    void EndRebuild();
+
+    // Slots of the candidates of the boid in slot
+    const uint32_t* Begin(uint32_t slot) const;
+    const uint32_t* End(uint32_t slot) const;
+    int GetCount(uint32_t slot) const;
+
+    float GetRadius() const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    // Where the list of a slot lies in the candidates of the worker that searched it
+    struct Range
+    {
+        int worker = 0;
+        int begin = 0;
+        int count = 0;
+    };
+
+    vector<Range> ranges;
+    // Per worker, so a parallel rebuild is one pass without any synchronisation
+    vector<vector<uint32_t>> candidates;
+
+    // Positions at the last build, per slot
+    vector<RVector3> built;
+    float radius = 0.f;
+    bool valid = false;
+};
+
+template<typename ForEachCandidate>
+void NeighbourLists::Fill(int worker, uint32_t slot, ForEachCandidate&& forEachCandidate)
+{
+    vector<uint32_t>& workerCandidates = candidates[worker];
+    const int begin = static_cast<int>(workerCandidates.size());
+
+    forEachCandidate([&workerCandidates](uint32_t candidate) { workerCandidates.push_back(candidate); });
+
+    ranges[slot] = {worker, begin, static_cast<int>(workerCandidates.size()) - begin};
+}
@@ -0,0 +1,171 @@
+﻿#include "pch.h"
+#include "ObstacleField.h"
+
+ObstacleField::~ObstacleField()
+{
+    Join();
+}
+
+void ObstacleField::Invalidate()
+{
+    dirty = true;
+    ready = false;
+}
+
+bool ObstacleField::NeedsBuild() const
+{
+    return dirty;
+}
+
+void ObstacleField::Build(const vector<RVector3>& boxMin, const vector<RVector3>& boxMax, const RVector3& minPoint, const RVector3& maxPoint, float cellSize, bool background)
+{
+    Join();
+    dirty = false;
+    ready = false;
+
+    pendingLayout.origin = minPoint;
+    pendingLayout.cellSize = cellSize;
+    pendingLayout.inverseCellSize = 1.f / cellSize;
+    for(int axis = 0; axis < 3; ++axis) {
+        pendingLayout.dimensions[axis] = std::max(2, static_cast<int>(std::ceil((maxPoint[axis] - minPoint[axis]) * pendingLayout.inverseCellSize)) + 1);
+    }
+
+    if(!background) {
+        Compute(pendingLayout, boxMin, boxMax, pendingDistances);
+        built = true;
+        TryPublish();
+        return;
+    }
+
+    builder = std::thread([this, boxMin, boxMax]()
+    {
+        Compute(pendingLayout, boxMin, boxMax, pendingDistances);
+        built.store(true, std::memory_order_release);
+    });
+}
+
+bool ObstacleField::TryPublish()
+{
+    if(built.load(std::memory_order_acquire)) {
+        Join();
+
+        layout = pendingLayout;
+        distances.swap(pendingDistances);
+        pendingDistances.clear();
+        built = false;
+        ready = true;
+    }
+
+    return ready;
+}
+
+void ObstacleField::Clear()
+{
+    Join();
+
+    distances.clear();
+    pendingDistances.clear();
+    built = false;
+    Invalidate();
+}
+
+bool ObstacleField::IsReady() const
+{
+    return ready;
+}
+
+size_t ObstacleField::GetMemoryUsage() const
+{
+    return distances.capacity() * sizeof(float);
+}
+
+bool ObstacleField::Sample(const RVector3& position, float& distance, RVector3& gradient) const
+{
+    if(!ready || distances.empty()) {
+        return false;
+    }
+
+    int cell[3];
+    float weight[3];
+    for(int axis = 0; axis < 3; ++axis) {
+        const float coord = (position[axis] - layout.origin[axis]) * layout.inverseCellSize;
+        cell[axis] = std::clamp(static_cast<int>(std::floor(coord)), 0, layout.dimensions[axis] - 2);
+        weight[axis] = std::clamp(coord - static_cast<float>(cell[axis]), 0.f, 1.f);
+    }
+
+    const int strideY = layout.dimensions[0];
+    const int strideZ = layout.dimensions[0] * layout.dimensions[1];
+    const float* base = &distances[layout.GetIndex(cell[0], cell[1], cell[2])];
+
+    const auto lerp = [](float a, float b, float t)
+    {
+        return a + (b - a) * t;
+    };
+
+    // Interpolated along x first, then y, then z. The gradient is the derivative of the same interpolation
+    const float x00 = lerp(base[0], base[1], weight[0]);
+    const float x10 = lerp(base[strideY], base[strideY + 1], weight[0]);
+    const float x01 = lerp(base[strideZ], base[strideZ + 1], weight[0]);
+    const float x11 = lerp(base[strideZ + strideY], base[strideZ + strideY + 1], weight[0]);
+
+    const float y0 = lerp(x00, x10, weight[1]);
+    const float y1 = lerp(x01, x11, weight[1]);
+    distance = lerp(y0, y1, weight[2]);
+
+    const float dx0 = lerp(base[1] - base[0], base[strideY + 1] - base[strideY], weight[1]);
+    const float dx1 = lerp(base[strideZ + 1] - base[strideZ], base[strideZ + strideY + 1] - base[strideZ + strideY], weight[1]);
+    gradient = RVector3{lerp(dx0, dx1, weight[2]), lerp(x10 - x00, x11 - x01, weight[2]), y1 - y0}.getUnit();
+    return true;
+}
+
+int ObstacleField::Layout::GetIndex(int x, int y, int z) const
+{
+    return (z * dimensions[1] + y) * dimensions[0] + x;
+}
+
+float ObstacleField::GetDistance(const RVector3& position, const vector<RVector3>& boxMin, const vector<RVector3>& boxMax)
+{
+    float closest = std::numeric_limits<float>::max();
+
+    for(size_t box = 0; box < boxMin.size(); ++box) {
+        const RVector3 center = (boxMin[box] + boxMax[box]) * 0.5f;
+        const RVector3 extents = (boxMax[box] - boxMin[box]) * 0.5f;
+        const RVector3 offset = position - center;
+
+        // Distance past each face, negative inside the box
+        const RVector3 outside = {std::abs(offset.x) - extents.x, std::abs(offset.y) - extents.y, std::abs(offset.z) - extents.z};
+        const RVector3 clamped = {std::max(outside.x, 0.f), std::max(outside.y, 0.f), std::max(outside.z, 0.f)};
+        const float insideDistance = std::min(std::max({outside.x, outside.y, outside.z}), 0.f);
+
+        closest = std::min(closest, clamped.length() + insideDistance);
+    }
+
+    return closest;
+}
+
+void ObstacleField::Compute(const Layout& layout, const vector<RVector3>& boxMin, const vector<RVector3>& boxMax, vector<float>& distances)
+{
+    // Without obstacles there is nothing to sample
+    if(boxMin.empty()) {
+        distances.clear();
+        return;
+    }
+
+    distances.resize(static_cast<size_t>(layout.dimensions[0]) * layout.dimensions[1] * layout.dimensions[2]);
+
+    for(int z = 0; z < layout.dimensions[2]; ++z) {
+        for(int y = 0; y < layout.dimensions[1]; ++y) {
+            for(int x = 0; x < layout.dimensions[0]; ++x) {
+                const RVector3 position = layout.origin + RVector3{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)} * layout.cellSize;
+                distances[layout.GetIndex(x, y, z)] = GetDistance(position, boxMin, boxMax);
+            }
+        }
+    }
+}
+
+void ObstacleField::Join()
+{
+    if(builder.joinable()) {
+        builder.join();
+    }
+}
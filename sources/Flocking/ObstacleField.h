@@ -0,0 +1,60 @@
+﻿#pragma once
+#include <atomic>
+#include <thread>
+
+#include "pch.h"
+
+using std::vector;
+
+// Signed distance to the closest static obstacle box, sampled on the nodes of a regular grid over the simulation
+// bounds and read back with trilinear interpolation. Smaller cells cost memory (4 bytes per node) and build time
+// for less rounding of the box corners.
+class ObstacleField
+{
+public:
+    ~ObstacleField();
+
+    void Invalidate();
+    bool NeedsBuild() const;
+
+    // With background the nodes are computed on a separate thread and only become visible through TryPublish
+    void Build(const vector<RVector3>& boxMin, const vector<RVector3>& boxMax, const RVector3& minPoint, const RVector3& maxPoint, float cellSize, bool background);
+    // Called from the update thread, makes a finished background build the active field
+    bool TryPublish();
+    void Clear();
+
+    bool IsReady() const;
+    size_t GetMemoryUsage() const;
+
+    // False until the field is ready, positions outside the bounds read the border nodes. The gradient points away from the closest obstacle
+    bool Sample(const RVector3& position, float& distance, RVector3& gradient) const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    struct Layout
+    {
+        RVector3 origin;
+        float cellSize = 1.f;
+        float inverseCellSize = 1.f;
+        int dimensions[3] = {0, 0, 0};
+
+        int GetIndex(int x, int y, int z) const;
+    };
+
+    static float GetDistance(const RVector3& position, const vector<RVector3>& boxMin, const vector<RVector3>& boxMax);
+    static void Compute(const Layout& layout, const vector<RVector3>& boxMin, const vector<RVector3>& boxMax, vector<float>& distances);
+    void Join();
+
+    bool dirty = true;
+    bool ready = false;
+
+    Layout layout;
+    vector<float> distances;
+
+    // Owned by the builder thread until built is set
+    Layout pendingLayout;
+    vector<float> pendingDistances;
+    std::thread builder;
+    std::atomic<bool> built = false;
+};
@@ -0,0 +1,219 @@
+﻿#include "pch.h"
+#include "ObstacleIndex.h"
+#include "SteeringKernels.h"
+
+#ifdef FLOCKING_X86
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Padding lane, far enough that no segment inside the simulation reaches it
+    constexpr float UNREACHABLE = 1e30f;
+
+    float GetInverse(float value)
+    {
+        // Axes parallel to the ray get a huge slope instead of a division by zero, same threshold as rp3d
+        if(std::abs(value) < reactphysics3d::MACHINE_EPSILON) {
+            value = value < 0.f ? -reactphysics3d::MACHINE_EPSILON : reactphysics3d::MACHINE_EPSILON;
+        }
+
+        return 1.f / value;
+    }
+}
+
+void ObstacleIndex::AddBox(const RVector3& center, const RVector3& extents)
+{
+    boxMin.push_back(center - extents);
+    boxMax.push_back(center + extents);
+    dirty = true;
+}
+
+void ObstacleIndex::Clear()
+{
+    boxMin.clear();
+    boxMax.clear();
+    cellStarts.clear();
+    dirty = false;
+}
+
+void ObstacleIndex::Build(float cellSize)
+{
+    dirty = false;
+    if(IsEmpty()) {
+        return;
+    }
+
+    float minPoint[2] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float maxPoint[2] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+    for(size_t box = 0; box < boxMin.size(); ++box) {
+        minPoint[0] = std::min(minPoint[0], boxMin[box].x);
+        minPoint[1] = std::min(minPoint[1], boxMin[box].z);
+        maxPoint[0] = std::max(maxPoint[0], boxMax[box].x);
+        maxPoint[1] = std::max(maxPoint[1], boxMax[box].z);
+    }
+
+    const float longestAxis = std::max(maxPoint[0] - minPoint[0], maxPoint[1] - minPoint[1]);
+    cellSize = std::max(cellSize, longestAxis / MAX_CELLS_PER_AXIS);
+    inverseCellSize = 1.f / cellSize;
+
+    for(int axis = 0; axis < 2; ++axis) {
+        origin[axis] = minPoint[axis];
+        dimensions[axis] = std::max(1, static_cast<int>(std::ceil((maxPoint[axis] - minPoint[axis]) * inverseCellSize)));
+    }
+
+    // A box lands in every cell its footprint overlaps
+    const auto forEachCell = [this](int box, auto&& visitor)
+    {
+        for(int z = GetCellCoord(boxMin[box].z, 1); z <= GetCellCoord(boxMax[box].z, 1); ++z) {
+            for(int x = GetCellCoord(boxMin[box].x, 0); x <= GetCellCoord(boxMax[box].x, 0); ++x) {
+                visitor(z * dimensions[0] + x);
+            }
+        }
+    };
+
+    const int cellsCount = dimensions[0] * dimensions[1];
+    vector<int> cellCounts(cellsCount, 0);
+    for(int box = 0; box < static_cast<int>(boxMin.size()); ++box) {
+        forEachCell(box, [&cellCounts](int cell) { ++cellCounts[cell]; });
+    }
+
+    cellStarts.assign(cellsCount + 1, 0);
+    for(int cell = 0; cell < cellsCount; ++cell) {
+        const int padded = (cellCounts[cell] + LANES - 1) / LANES * LANES;
+        cellStarts[cell + 1] = cellStarts[cell] + padded;
+    }
+
+    const size_t lanesCount = cellStarts.back();
+    minX.assign(lanesCount, UNREACHABLE);
+    minY.assign(lanesCount, UNREACHABLE);
+    minZ.assign(lanesCount, UNREACHABLE);
+    maxX.assign(lanesCount, UNREACHABLE);
+    maxY.assign(lanesCount, UNREACHABLE);
+    maxZ.assign(lanesCount, UNREACHABLE);
+
+    vector<int> cellCursors(cellStarts.begin(), cellStarts.end() - 1);
+    for(int box = 0; box < static_cast<int>(boxMin.size()); ++box) {
+        forEachCell(box, [this, box, &cellCursors](int cell)
+        {
+            const int lane = cellCursors[cell]++;
+            minX[lane] = boxMin[box].x;
+            minY[lane] = boxMin[box].y;
+            minZ[lane] = boxMin[box].z;
+            maxX[lane] = boxMax[box].x;
+            maxY[lane] = boxMax[box].y;
+            maxZ[lane] = boxMax[box].z;
+        });
+    }
+}
+
+bool ObstacleIndex::NeedsBuild() const
+{
+    return dirty;
+}
+
+bool ObstacleIndex::IsEmpty() const
+{
+    return boxMin.empty();
+}
+
+bool ObstacleIndex::Raycast(const RVector3& from, const RVector3& to, RVector3& hitPoint) const
+{
+    if(IsEmpty() || cellStarts.empty()) {
+        return false;
+    }
+
+    const RVector3 direction = to - from;
+    const RVector3 inverseDirection = {GetInverse(direction.x), GetInverse(direction.y), GetInverse(direction.z)};
+
+    const int minX = GetCellCoord(std::min(from.x, to.x), 0);
+    const int minZ = GetCellCoord(std::min(from.z, to.z), 1);
+    const int maxX = GetCellCoord(std::max(from.x, to.x), 0);
+    const int maxZ = GetCellCoord(std::max(from.z, to.z), 1);
+
+    // A box spanning several cells is tested once per cell, which is harmless for the closest hit
+    bool hit = false;
+    float bestFraction = 1.f;
+    for(int z = minZ; z <= maxZ; ++z) {
+        for(int x = minX; x <= maxX; ++x) {
+            hit |= RaycastCell(z * dimensions[0] + x, from, inverseDirection, bestFraction);
+        }
+    }
+
+    if(hit) {
+        hitPoint = from + direction * bestFraction;
+    }
+
+    return hit;
+}
+
+int ObstacleIndex::GetCellCoord(float value, int axis) const
+{
+    const int coord = static_cast<int>(std::floor((value - origin[axis]) * inverseCellSize));
+    return std::clamp(coord, 0, dimensions[axis] - 1);
+}
+
+#ifdef FLOCKING_X86
+bool ObstacleIndex::RaycastCell(int cell, const RVector3& from, const RVector3& inverseDirection, float& bestFraction) const
+{
+    const __m128 fromX = _mm_set1_ps(from.x);
+    const __m128 fromY = _mm_set1_ps(from.y);
+    const __m128 fromZ = _mm_set1_ps(from.z);
+    const __m128 inverseX = _mm_set1_ps(inverseDirection.x);
+    const __m128 inverseY = _mm_set1_ps(inverseDirection.y);
+    const __m128 inverseZ = _mm_set1_ps(inverseDirection.z);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 best = _mm_set1_ps(bestFraction);
+    int hitMask = 0;
+
+    for(int lane = cellStarts[cell]; lane < cellStarts[cell + 1]; lane += LANES) {
+        // Slab test, entry is the latest near plane and exit the earliest far plane over the three axes
+        const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&minX[lane]), fromX), inverseX);
+        const __m128 x2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&maxX[lane]), fromX), inverseX);
+        const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&minY[lane]), fromY), inverseY);
+        const __m128 y2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&maxY[lane]), fromY), inverseY);
+        const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&minZ[lane]), fromZ), inverseZ);
+        const __m128 z2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&maxZ[lane]), fromZ), inverseZ);
+
+        const __m128 entry = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), _mm_min_ps(z1, z2));
+        const __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2)), _mm_max_ps(z1, z2));
+
+        const __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(entry, exit), _mm_cmpge_ps(entry, zero)), _mm_cmple_ps(entry, best));
+        hitMask |= _mm_movemask_ps(hit);
+
+        // Lanes that missed keep the current best
+        best = _mm_min_ps(best, _mm_or_ps(_mm_and_ps(hit, entry), _mm_andnot_ps(hit, best)));
+    }
+
+    best = _mm_min_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm_min_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(2, 3, 0, 1)));
+    bestFraction = _mm_cvtss_f32(best);
+
+    return hitMask != 0;
+}
+#else
+bool ObstacleIndex::RaycastCell(int cell, const RVector3& from, const RVector3& inverseDirection, float& bestFraction) const
+{
+    bool hit = false;
+
+    for(int lane = cellStarts[cell]; lane < cellStarts[cell + 1]; ++lane) {
+        const float x1 = (minX[lane] - from.x) * inverseDirection.x;
+        const float x2 = (maxX[lane] - from.x) * inverseDirection.x;
+        const float y1 = (minY[lane] - from.y) * inverseDirection.y;
+        const float y2 = (maxY[lane] - from.y) * inverseDirection.y;
+        const float z1 = (minZ[lane] - from.z) * inverseDirection.z;
+        const float z2 = (maxZ[lane] - from.z) * inverseDirection.z;
+
+        const float entry = std::max({std::min(x1, x2), std::min(y1, y2), std::min(z1, z2)});
+        const float exit = std::min({std::max(x1, x2), std::max(y1, y2), std::max(z1, z2)});
+
+        if(entry <= exit && entry >= 0.f && entry <= bestFraction) {
+            bestFraction = entry;
+            hit = true;
+        }
+    }
+
+    return hit;
+}
+#endif
@@ -0,0 +1,48 @@
+﻿#pragma once
+#include "pch.h"
+#include "AlignedAllocator.h"
+
+using std::vector;
+
+// Static axis aligned obstacles bucketed into a uniform grid over the ground plane (x, z).
+// Every cell stores its boxes as 4-wide lanes padded with unreachable boxes, so a ray is tested against four boxes at once.
+class ObstacleIndex
+{
+public:
+    void AddBox(const RVector3& center, const RVector3& extents);
+    void Clear();
+    void Build(float cellSize);
+
+    bool NeedsBuild() const;
+    bool IsEmpty() const;
+
+    // Closest point where the segment from -> to enters a box. Like rp3d, a segment starting inside a box does not hit it
+    bool Raycast(const RVector3& from, const RVector3& to, RVector3& hitPoint) const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    int GetCellCoord(float value, int axis) const;
+    bool RaycastCell(int cell, const RVector3& from, const RVector3& inverseDirection, float& bestFraction) const;
+
+    constexpr static int MAX_CELLS_PER_AXIS = 64;
+    constexpr static int LANES = 4;
+
+    vector<RVector3> boxMin;
+    vector<RVector3> boxMax;
+    bool dirty = false;
+
+    // x and z of the grid, boxes span the whole y range of their column
+    float origin[2] = {0.f, 0.f};
+    float inverseCellSize = 1.f;
+    int dimensions[2] = {1, 1};
+
+    vector<int> cellStarts;
+
+    AlignedVector<float> minX;
+    AlignedVector<float> minY;
+    AlignedVector<float> minZ;
+    AlignedVector<float> maxX;
+    AlignedVector<float> maxY;
+    AlignedVector<float> maxZ;
+};
@@ -9,6 +9,7 @@ struct Physics
 {
     PhysicsCommon physicsCommon;
     PhysicsWorld* physicsWorld;
+    std::mutex mutex;
     
     Physics()
     {
@@ -36,4 +37,9 @@ extern PhysicsWorld& GetPhysicsWorld() noexcept
 {
     assert ( physics.physicsWorld );
     return *physics.physicsWorld;
+}
+
+extern std::mutex& GetPhysicsMutex() noexcept
+{
+    return physics.mutex;
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+﻿#include "pch.h"
+#include "Random.h"
+#include "SteeringKernels.h"
+
+#ifdef FLOCKING_X86
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // 24 random bits fill the float mantissa exactly
+    constexpr float UNIT = 1.f / 16777216.f;
+
+    uint64_t SplitMix64(uint64_t& state)
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+}
+
+Random::Random(uint64_t seed)
+{
+    Seed(seed);
+}
+
+void Random::Seed(uint64_t seed)
+{
+    uint64_t state = seed;
+
+    for(int lane = 0; lane < LANES; ++lane) {
+        const uint64_t a = SplitMix64(state);
+        const uint64_t b = SplitMix64(state);
+        s0[lane] = static_cast<uint32_t>(a);
+        s1[lane] = static_cast<uint32_t>(a >> 32);
+        s2[lane] = static_cast<uint32_t>(b);
+        s3[lane] = static_cast<uint32_t>(b >> 32);
+    }
+}
+
+void Random::FillUniform(float* values, int count, float min, float max)
+{
+    const float range = max - min;
+
+    int i = 0;
+    for(; i + LANES <= count; i += LANES) {
+        NextBlock(values + i, min, range);
+    }
+
+    if(i < count) {
+        float block[LANES];
+        NextBlock(block, min, range);
+        std::copy(block, block + (count - i), values + i);
+    }
+}
+
+float Random::NextFloat(float min, float max)
+{
+    float value;
+    FillUniform(&value, 1, min, max);
+    return value;
+}
+
+#ifdef FLOCKING_X86
+void Random::NextBlock(float* values, float min, float range)
+{
+    __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(s0));
+    __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(s1));
+    __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(s2));
+    __m128i d = _mm_load_si128(reinterpret_cast<const __m128i*>(s3));
+
+    const __m128i result = _mm_add_epi32(a, d);
+    const __m128i t = _mm_slli_epi32(b, 9);
+
+    c = _mm_xor_si128(c, a);
+    d = _mm_xor_si128(d, b);
+    b = _mm_xor_si128(b, c);
+    a = _mm_xor_si128(a, d);
+    c = _mm_xor_si128(c, t);
+    d = _mm_or_si128(_mm_slli_epi32(d, 11), _mm_srli_epi32(d, 21));
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(s0), a);
+    _mm_store_si128(reinterpret_cast<__m128i*>(s1), b);
+    _mm_store_si128(reinterpret_cast<__m128i*>(s2), c);
+    _mm_store_si128(reinterpret_cast<__m128i*>(s3), d);
+
+    // The top 24 bits are below 2^24, the signed conversion is exact
+    const __m128 unit = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), _mm_set1_ps(UNIT));
+    _mm_storeu_ps(values, _mm_add_ps(_mm_mul_ps(unit, _mm_set1_ps(range)), _mm_set1_ps(min)));
+}
+#else
+void Random::NextBlock(float* values, float min, float range)
+{
+    for(int lane = 0; lane < LANES; ++lane) {
+        const uint32_t result = s0[lane] + s3[lane];
+        const uint32_t t = s1[lane] << 9;
+
+        s2[lane] ^= s0[lane];
+        s3[lane] ^= s1[lane];
+        s1[lane] ^= s2[lane];
+        s0[lane] ^= s3[lane];
+        s2[lane] ^= t;
+        s3[lane] = (s3[lane] << 11) | (s3[lane] >> 21);
+
+        // Separate multiply and add, a fused one would round differently from the SSE2 path
+        const float unit = static_cast<float>(result >> 8) * UNIT;
+        const float scaled = unit * range;
+        values[lane] = scaled + min;
+    }
+}
+#endif
@@ -0,0 +1,28 @@
+﻿#pragma once
+#include <cstdint>
+
+// xoshiro128+ running four independent streams side by side, one per SSE lane.
+// Values are bitwise identical for a seed whether the lanes run as SSE2 or as the scalar fallback.
+class Random
+{
+public:
+    explicit Random(uint64_t seed);
+
+    void Seed(uint64_t seed);
+
+    // Uniform in [min, max). Values are produced in blocks of LANES, what is left of the last block is discarded
+    void FillUniform(float* values, int count, float min, float max);
+    float NextFloat(float min = 0.f, float max = 1.f);
+
+#ifndef DEBUG
+// protected:
+#endif
+    void NextBlock(float* values, float min, float range);
+
+    constexpr static int LANES = 4;
+
+    alignas(16) uint32_t s0[LANES];
+    alignas(16) uint32_t s1[LANES];
+    alignas(16) uint32_t s2[LANES];
+    alignas(16) uint32_t s3[LANES];
+};
@@ -0,0 +1,200 @@
+﻿#include "pch.h"
+#include "SimulationThread.h"
+
+RVector3 SimulationSnapshot::GetPosition(size_t i, float alpha) const
+{
+    return previousPositions[i] + (positions[i] - previousPositions[i]) * alpha;
+}
+
+bool SimulationSnapshot::IsAlive(BoidHandle handle) const
+{
+    return handle.slot < generations.size() && generations[handle.slot] == handle.generation;
+}
+
+SimulationThread::SimulationThread(FlockingSimulation& simulation) : simulation(simulation) {}
+
+SimulationThread::~SimulationThread()
+{
+    Stop();
+}
+
+void SimulationThread::Start(float stepSeconds)
+{
+    Stop();
+
+    this->stepSeconds = stepSeconds;
+    stopping = false;
+    // Handles are there from the first frame on, not only after the first step
+    ReserveHandles();
+    thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop()
+{
+    if(!thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stopRequested.notify_one();
+    thread.join();
+}
+
+bool SimulationThread::IsRunning() const
+{
+    return thread.joinable();
+}
+
+void SimulationThread::Step(float deltaTime)
+{
+    ApplyCommands();
+    ReserveHandles();
+    simulation.OnUpdate(deltaTime);
+    ++steps;
+    PublishSnapshot();
+}
+
+bool SimulationThread::Push(const SimulationCommand& command)
+{
+    return commands.Push(command);
+}
+
+BoidHandle SimulationThread::ReserveHandle()
+{
+    BoidHandle handle;
+    reservedHandles.Pop(handle);
+    return handle;
+}
+
+BoidHandle SimulationThread::PushSpawn(SimulationCommand command)
+{
+    if(commands.IsFull()) {
+        return {};
+    }
+
+    command.command = SIMULATION_COMMAND::SPAWN;
+    command.handle = ReserveHandle();
+    commands.Push(command);
+    return command.handle;
+}
+
+const SimulationSnapshot& SimulationThread::AcquireSnapshot()
+{
+    snapshots.Acquire();
+    return snapshots.GetFront();
+}
+
+float SimulationThread::GetInterpolationAlpha(const SimulationSnapshot& snapshot) const
+{
+    if(snapshot.step == 0 || stepSeconds <= 0.f) {
+        return 1.f;
+    }
+
+    const float elapsed = std::chrono::duration<float>(Clock::now() - snapshot.publishedAt).count();
+    return std::min(elapsed / stepSeconds, 1.f);
+}
+
+void SimulationThread::Run()
+{
+    const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(stepSeconds));
+    Clock::time_point next = Clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!stopping) {
+        lock.unlock();
+        Step(stepSeconds);
+        lock.lock();
+
+        // Past a few late steps the simulation runs slower than real time rather than spiral further behind
+        next += step;
+        const Clock::time_point now = Clock::now();
+        if(now - next > step * MAX_CATCH_UP_STEPS) {
+            next = now;
+        }
+
+        stopRequested.wait_until(lock, next, [this] { return stopping; });
+    }
+}
+
+void SimulationThread::ApplyCommands()
+{
+    SimulationCommand command;
+    while(commands.Pop(command)) {
+        switch(command.command) {
+        case SIMULATION_COMMAND::SPAWN:
+            switch(command.type) {
+            case BEHAVIOR_TYPE::PREY:
+                simulation.Spawn<PreyBehavior>(command.position, command.velocity, command.handle);
+                break;
+            case BEHAVIOR_TYPE::HUNTER:
+                simulation.Spawn<HunterBehavior>(command.position, command.velocity, command.handle);
+                break;
+            default:
+                simulation.Spawn<Behavior>(command.position, command.velocity, command.handle);
+                break;
+            }
+            break;
+        case SIMULATION_COMMAND::SPAWN_RANDOM:
+            switch(command.type) {
+            case BEHAVIOR_TYPE::PREY:
+                simulation.Spawn<PreyBehavior>(command.count);
+                break;
+            case BEHAVIOR_TYPE::HUNTER:
+                simulation.Spawn<HunterBehavior>(command.count);
+                break;
+            default:
+                simulation.Spawn<Behavior>(command.count);
+                break;
+            }
+            break;
+        case SIMULATION_COMMAND::SET_OBSERVER:
+            simulation.SetObservers(command.position, 1);
+            break;
+        }
+    }
+}
+
+void SimulationThread::ReserveHandles()
+{
+    while(true) {
+        if(pendingHandle.slot == BoidHandle::INVALID_SLOT) {
+            pendingHandle = simulation.ReserveHandle();
+        }
+        if(!reservedHandles.Push(pendingHandle)) {
+            return;
+        }
+        pendingHandle = {};
+    }
+}
+
+void SimulationThread::PublishSnapshot()
+{
+    // The back buffer keeps its capacity from two publishes ago, a steady flock copies without allocating
+    SimulationSnapshot& snapshot = snapshots.GetBack();
+    snapshot.positions.clear();
+    snapshot.previousPositions.clear();
+    snapshot.radii.clear();
+    snapshot.types.clear();
+    snapshot.generations.assign(simulation.GetSlotCount(), SimulationSnapshot::NO_BOID);
+
+    const vector<Boid>& boids = simulation.GetBoids();
+    for(size_t id = 0; id < boids.size(); ++id) {
+        const Boid& boid = boids[id];
+        snapshot.positions.push_back(boid.position);
+        snapshot.previousPositions.push_back(boid.previousPosition);
+        snapshot.radii.push_back(boid.radius);
+        snapshot.types.push_back(boid.behavior->GetType());
+
+        if(boid.status == STATUS::ALIVE) {
+            const BoidHandle handle = simulation.GetHandle(static_cast<int>(id));
+            snapshot.generations[handle.slot] = handle.generation;
+        }
+    }
+    snapshot.step = steps;
+    snapshot.publishedAt = Clock::now();
+
+    snapshots.Publish();
+}
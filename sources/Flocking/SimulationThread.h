@@ -0,0 +1,117 @@
+﻿#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "FlockingSimulation.h"
+#include "TripleBuffer.h"
+
+enum class SIMULATION_COMMAND
+{
+    // One boid of the type at position, moving at velocity
+    SPAWN,
+    // count boids of the type at random positions
+    SPAWN_RANDOM,
+    // position becomes the only observer, see FlockingSimulation::SetObservers
+    SET_OBSERVER
+};
+
+// Request from the game thread, applied by the simulation thread before its next step
+struct SimulationCommand
+{
+    SIMULATION_COMMAND command = SIMULATION_COMMAND::SPAWN;
+    BEHAVIOR_TYPE type = BEHAVIOR_TYPE::DEFAULT;
+    int count = 1;
+    float position[3] = {};
+    float velocity[3] = {};
+    // SPAWN only, from SimulationThread::ReserveHandle. The boid takes it as its handle
+    BoidHandle handle;
+};
+
+// What rendering needs of the boids after a step, never written again once published
+struct SimulationSnapshot
+{
+    // alpha of the way from the position before the step to the one after it
+    RVector3 GetPosition(size_t i, float alpha) const;
+    // As of the step the snapshot was taken after
+    bool IsAlive(BoidHandle handle) const;
+
+    constexpr static uint32_t NO_BOID = UINT32_MAX;
+
+    vector<RVector3> positions;
+    vector<RVector3> previousPositions;
+    vector<float> radii;
+    vector<BEHAVIOR_TYPE> types;
+    // Generation of the boid in every slot, NO_BOID for the free and the reserved ones
+    vector<uint32_t> generations;
+    // Steps taken when it was published, 0 before the first one
+    uint64_t step = 0;
+    std::chrono::steady_clock::time_point publishedAt;
+};
+
+// Steps a FlockingSimulation at a fixed rate on a thread of its own, so a heavy step never holds up the frame. The game
+// thread talks to it through a queue of commands and reads the boids back from snapshots, both without locks
+class SimulationThread
+{
+public:
+    explicit SimulationThread(FlockingSimulation& simulation);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator =(const SimulationThread&) = delete;
+
+    // Every stepSeconds of wall time the thread applies the queued commands, updates by stepSeconds and publishes a snapshot.
+    // Nothing else may touch the simulation until Stop
+    void Start(float stepSeconds);
+    void Stop();
+    bool IsRunning() const;
+
+    // The same step on the calling thread, for when no thread is running
+    void Step(float deltaTime);
+
+    // From one thread at a time. False when the queue is full and the command is dropped
+    bool Push(const SimulationCommand& command);
+    // From the thread that pushes. A handle for a SPAWN command to carry, so the boid can be told apart in the snapshots
+    // before it exists. Invalid when the thread has none reserved, it reserves more with every step. A handle that
+    // never reaches the queue is lost for good, PushSpawn only reserves once the command is sure to fit
+    BoidHandle ReserveHandle();
+    // Pushes command as a SPAWN carrying a reserved handle and returns the handle, invalid when the queue is full
+    BoidHandle PushSpawn(SimulationCommand command);
+    // Never blocks, the snapshot stays as it is until the next call from the same thread
+    const SimulationSnapshot& AcquireSnapshot();
+    // While running, the share of a step elapsed since the snapshot was published, clamped to 1. Drawing the
+    // snapshot that far between its two positions trails the simulation by a step but moves smoothly
+    float GetInterpolationAlpha(const SimulationSnapshot& snapshot) const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    using Clock = std::chrono::steady_clock;
+
+    constexpr static size_t COMMAND_CAPACITY = 256;
+    constexpr static size_t RESERVED_HANDLE_CAPACITY = 32;
+    // Steps the thread may fall behind its schedule before it gives up on catching up
+    constexpr static int MAX_CATCH_UP_STEPS = 4;
+
+    void Run();
+    void ApplyCommands();
+    // Refills the reserved handles, on the thread that steps
+    void ReserveHandles();
+    void PublishSnapshot();
+
+    FlockingSimulation& simulation;
+    uint64_t steps = 0;
+
+    SpscRing<SimulationCommand, COMMAND_CAPACITY> commands;
+    SpscRing<BoidHandle, RESERVED_HANDLE_CAPACITY> reservedHandles;
+    // Reserved but not taken by the full ring, it goes in first next time
+    BoidHandle pendingHandle;
+    TripleBuffer<SimulationSnapshot> snapshots;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable stopRequested;
+    bool stopping = false;
+    float stepSeconds = 0.f;
+};
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+enum class STORAGE_MODE
+{
+    AOS,
+    SOA
+};
+
+enum class UPDATE_MODE
+{
+    SEQUENTIAL,
+    PARALLEL
+};
+
+// How the SoA updates find what alignment and cohesion steer by
+enum class STEERING_MODE
+{
+    EXACT,
+    // Approximate: cells in view beyond separation reach count through their sums, see CellAggregates
+    CELL_AGGREGATES
+};
+
+// Spatial index the neighbour search queries, see INeighbourIndex
+enum class NEIGHBOUR_BACKEND
+{
+    GRID,
+    KD_TREE,
+    MORTON_SWEEP
+};
+
+enum class OBSTACLE_BACKEND
+{
+    STATIC_INDEX,
+    DISTANCE_FIELD,
+    PHYSICS
+};
+
+enum class SIMD_LEVEL
+{
+    SCALAR,
+    SSE41,
+    AVX2
+};
+
+// Distance bands from the observers, see FlockingSimulation::SetObservers
+constexpr int DISTANCE_BAND_COUNT = 4;
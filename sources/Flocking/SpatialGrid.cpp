@@ -0,0 +1,102 @@
+﻿#include "pch.h"
+#include "SpatialGrid.h"
+
+NEIGHBOUR_BACKEND SpatialGrid::GetBackend() const
+{
+    return NEIGHBOUR_BACKEND::GRID;
+}
+
+void SpatialGrid::Build(const PositionLanes& positions, const RVector3& minPoint, const RVector3& maxPoint, float queryRadius)
+{
+    Build(positions.count, [&positions](int i) { return RVector3{positions.x[i], positions.y[i], positions.z[i]}; }, minPoint, maxPoint, queryRadius);
+}
+
+void SpatialGrid::Query(const RVector3& position, float radius, IdList& candidates) const
+{
+    ForEachCandidate(position, radius + GetDrift(), [&candidates](int index) { candidates.push_back(index); });
+}
+
+void SpatialGrid::QueryNearest(const RVector3& position, float radius, const CandidateTest& test, NearestNeighbours& nearest) const
+{
+    struct Cell
+    {
+        float distance_2;
+        int index;
+    };
+
+    const float reach = radius + GetDrift();
+    const int minCoords[3] = {GetCellCoord(position.x - reach, 0), GetCellCoord(position.y - reach, 1), GetCellCoord(position.z - reach, 2)};
+    const int maxCoords[3] = {GetCellCoord(position.x + reach, 0), GetCellCoord(position.y + reach, 1), GetCellCoord(position.z + reach, 2)};
+
+    // Distance along one axis from position to the slab of a cell, border cells reach out to infinity as they hold the clamped boids
+    const auto getAxisDistance = [this, &position](int coord, int axis)
+    {
+        const float low = coord > 0 ? origin[axis] + coord * cellSize : -std::numeric_limits<float>::max();
+        const float high = coord < dimensions[axis] - 1 ? origin[axis] + (coord + 1) * cellSize : std::numeric_limits<float>::max();
+        return std::max({low - position[axis], 0.f, position[axis] - high});
+    };
+
+    ArenaScope scope;
+    ArenaVector<Cell> cells;
+    for(int z = minCoords[2]; z <= maxCoords[2]; ++z) {
+        const float dz = getAxisDistance(z, 2);
+        for(int y = minCoords[1]; y <= maxCoords[1]; ++y) {
+            const float dy = getAxisDistance(y, 1);
+            for(int x = minCoords[0]; x <= maxCoords[0]; ++x) {
+                const float dx = getAxisDistance(x, 0);
+                cells.push_back({GetDriftedDistanceSquare(dx * dx + dy * dy + dz * dz), (z * dimensions[1] + y) * dimensions[0] + x});
+            }
+        }
+    }
+    std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) { return a.distance_2 < b.distance_2; });
+
+    for(const Cell& cell : cells) {
+        if(nearest.IsFull() && cell.distance_2 > nearest.GetFarthest()) {
+            break;
+        }
+
+        for(int i = cellStarts[cell.index]; i < cellStarts[cell.index + 1]; ++i) {
+            const int id = indices[i];
+            const float distance_2 = test(id);
+            if(distance_2 >= 0.f) {
+                nearest.Offer(distance_2, id);
+            }
+        }
+    }
+}
+
+float SpatialGrid::GetCellSize() const
+{
+    return cellSize;
+}
+
+void SpatialGrid::Resize(const RVector3& minPoint, const RVector3& maxPoint, float cellSize)
+{
+    const RVector3 size = maxPoint - minPoint;
+    const float longestAxis = std::max({size.x, size.y, size.z});
+
+    this->cellSize = std::max(cellSize, longestAxis / MAX_CELLS_PER_AXIS);
+    inverseCellSize = 1.f / this->cellSize;
+    origin = minPoint;
+
+    for(int axis = 0; axis < 3; ++axis) {
+        dimensions[axis] = std::max(1, static_cast<int>(std::ceil(size[axis] * inverseCellSize)));
+    }
+
+    cellStarts.assign(dimensions[0] * dimensions[1] * dimensions[2] + 1, 0);
+    Invalidate();
+}
+
+int SpatialGrid::GetCellCoord(float value, int axis) const
+{
+    const int coord = static_cast<int>(std::floor((value - origin[axis]) * inverseCellSize));
+    return std::clamp(coord, 0, dimensions[axis] - 1);
+}
+
+int SpatialGrid::GetCellIndex(const RVector3& position) const
+{
+    const int x = GetCellCoord(position.x, 0);
+    const int y = GetCellCoord(position.y, 1);
+    const int z = GetCellCoord(position.z, 2);
+    return (z * dimensions[1] + y) * dimensions[0] + x;
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+#include "pch.h"
+#include "NeighbourIndex.h"
+
+using std::vector;
+
+// Uniform grid over the simulation bounds. Boids outside the bounds are clamped into the border cells,
+// so a query never misses them, it only visits a few more candidates.
+// Cheapest to build, best while the density is even, dense swarms pile up in a few cells.
+class SpatialGrid : public INeighbourIndex
+{
+public:
+    NEIGHBOUR_BACKEND GetBackend() const override;
+    // Cells of queryRadius, a query visits the 3x3x3 cells around it
+    void Build(const PositionLanes& positions, const RVector3& minPoint, const RVector3& maxPoint, float queryRadius) override;
+    void Query(const RVector3& position, float radius, IdList& candidates) const override;
+    // Visits the cells nearest first
+    void QueryNearest(const RVector3& position, float radius, const CandidateTest& test, NearestNeighbours& nearest) const override;
+
+    float GetCellSize() const;
+
+    // Calls visitor(int index) for every boid stored in a cell overlapping the cube around position
+    template<typename Visitor>
+    void ForEachCandidate(const RVector3& position, float radius, Visitor&& visitor) const;
+
+#ifndef DEBUG
+// protected:
+#endif
+    template<typename GetPosition>
+    void Build(int count, GetPosition&& getPosition, const RVector3& minPoint, const RVector3& maxPoint, float cellSize);
+
+    void Resize(const RVector3& minPoint, const RVector3& maxPoint, float cellSize);
+    int GetCellCoord(float value, int axis) const;
+    int GetCellIndex(const RVector3& position) const;
+
+    constexpr static int MAX_CELLS_PER_AXIS = 128;
+
+    RVector3 origin;
+    float inverseCellSize = 1.f;
+    float cellSize = 1.f;
+    int dimensions[3] = {1, 1, 1};
+
+    vector<int> cellStarts;
+    vector<int> cellCursors;
+    vector<int> cellOfBoid;
+    vector<int> indices;
+};
+
+template<typename GetPosition>
+void SpatialGrid::Build(int count, GetPosition&& getPosition, const RVector3& minPoint, const RVector3& maxPoint, float cellSize)
+{
+    Resize(minPoint, maxPoint, cellSize);
+
+    cellOfBoid.resize(count);
+    indices.resize(count);
+
+    for(int i = 0; i < count; ++i) {
+        const int cell = GetCellIndex(getPosition(i));
+        cellOfBoid[i] = cell;
+        ++cellStarts[cell + 1];
+    }
+
+    for(size_t cell = 1; cell < cellStarts.size(); ++cell) {
+        cellStarts[cell] += cellStarts[cell - 1];
+    }
+
+    cellCursors.assign(cellStarts.begin(), cellStarts.end() - 1);
+    for(int i = 0; i < count; ++i) {
+        indices[cellCursors[cellOfBoid[i]]++] = i;
+    }
+}
+
+template<typename Visitor>
+void SpatialGrid::ForEachCandidate(const RVector3& position, float radius, Visitor&& visitor) const
+{
+    const int minX = GetCellCoord(position.x - radius, 0);
+    const int minY = GetCellCoord(position.y - radius, 1);
+    const int minZ = GetCellCoord(position.z - radius, 2);
+    const int maxX = GetCellCoord(position.x + radius, 0);
+    const int maxY = GetCellCoord(position.y + radius, 1);
+    const int maxZ = GetCellCoord(position.z + radius, 2);
+
+    for(int z = minZ; z <= maxZ; ++z) {
+        for(int y = minY; y <= maxY; ++y) {
+            const int row = (z * dimensions[1] + y) * dimensions[0];
+            const int begin = cellStarts[row + minX];
+            const int end = cellStarts[row + maxX + 1];
+
+            for(int i = begin; i < end; ++i) {
+                visitor(indices[i]);
+            }
+        }
+    }
+}
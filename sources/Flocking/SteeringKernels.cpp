@@ -0,0 +1,128 @@
+﻿#include "pch.h"
+#include "SteeringKernels.h"
+#include "BoidStorage.h"
+
+#if defined(FLOCKING_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    RVector3 SumVelocitiesScalar(const NeighbourBuffer& neighbours)
+    {
+        RVector3 sum;
+        for(int i = 0; i < neighbours.Size(); ++i) {
+            sum += RVector3{neighbours.vx[i], neighbours.vy[i], neighbours.vz[i]};
+        }
+
+        return sum;
+    }
+
+    RVector3 SumPositionsScalar(const NeighbourBuffer& neighbours)
+    {
+        RVector3 sum;
+        for(int i = 0; i < neighbours.Size(); ++i) {
+            sum += RVector3{neighbours.px[i], neighbours.py[i], neighbours.pz[i]};
+        }
+
+        return sum;
+    }
+
+    RVector3 SumSeparationScalar(const RVector3& position, float minDistance_2, const NeighbourBuffer& neighbours)
+    {
+        RVector3 shift;
+        for(int i = 0; i < neighbours.Size(); ++i) {
+            const RVector3 direction = position - RVector3{neighbours.px[i], neighbours.py[i], neighbours.pz[i]};
+            const float distance_2 = direction.lengthSquare();
+            if(distance_2 > minDistance_2 || distance_2 < SEPARATION_EPSILON_2) {
+                continue;
+            }
+
+            shift += direction.getUnit();
+        }
+
+        return shift;
+    }
+
+    SIMD_LEVEL DetectSimdLevel()
+    {
+#if defined(FLOCKING_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool sse41 = (info[2] & (1 << 19)) != 0;
+        const bool fma = (info[2] & (1 << 12)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+
+        bool avx2 = false;
+        if(maxLeaf >= 7) {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+
+        // The OS has to save the ymm registers on context switches
+        const bool ymmEnabled = osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+
+        if(avx2 && fma && ymmEnabled) {
+            return SIMD_LEVEL::AVX2;
+        }
+        return sse41 ? SIMD_LEVEL::SSE41 : SIMD_LEVEL::SCALAR;
+#elif defined(FLOCKING_X86)
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return SIMD_LEVEL::AVX2;
+        }
+        return __builtin_cpu_supports("sse4.1") ? SIMD_LEVEL::SSE41 : SIMD_LEVEL::SCALAR;
+#else
+        return SIMD_LEVEL::SCALAR;
+#endif
+    }
+
+    SIMD_LEVEL& ActiveSimdLevel()
+    {
+        static SIMD_LEVEL level = GetSupportedSimdLevel();
+        return level;
+    }
+}
+
+const SteeringKernels& GetScalarSteeringKernels()
+{
+    static const SteeringKernels kernels = {SumVelocitiesScalar, SumPositionsScalar, SumSeparationScalar};
+    return kernels;
+}
+
+const SteeringKernels& GetSteeringKernels(SIMD_LEVEL level)
+{
+    switch(std::min(level, GetSupportedSimdLevel())) {
+    case SIMD_LEVEL::AVX2:
+        return GetAvx2SteeringKernels();
+    case SIMD_LEVEL::SSE41:
+        return GetSse41SteeringKernels();
+    default:
+        return GetScalarSteeringKernels();
+    }
+}
+
+const SteeringKernels& GetSteeringKernels()
+{
+    return GetSteeringKernels(ActiveSimdLevel());
+}
+
+SIMD_LEVEL GetSupportedSimdLevel()
+{
+    static const SIMD_LEVEL level = DetectSimdLevel();
+    return level;
+}
+
+SIMD_LEVEL GetSimdLevel()
+{
+    return ActiveSimdLevel();
+}
+
+void SetSimdLevel(SIMD_LEVEL level)
+{
+    ActiveSimdLevel() = std::min(level, GetSupportedSimdLevel());
+}
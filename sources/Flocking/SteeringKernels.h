@@ -0,0 +1,42 @@
+﻿#pragma once
+#include "pch.h"
+#include "SimulationTypes.h"
+
+struct NeighbourBuffer;
+
+// Raw neighbour sums behind GetAlignment, GetCohesion and GetSeparation, one table per instruction set.
+// The scalar table is the reference, the vector ones process 8 neighbours per iteration and may differ in rounding.
+struct SteeringKernels
+{
+    RVector3 (*sumVelocities)(const NeighbourBuffer& neighbours);
+    RVector3 (*sumPositions)(const NeighbourBuffer& neighbours);
+    // Sum of unit directions away from the neighbours closer than sqrt(minDistance_2), see SEPARATION_EPSILON_2
+    RVector3 (*sumSeparation)(const RVector3& position, float minDistance_2, const NeighbourBuffer& neighbours);
+};
+
+// Neighbours closer than sqrt of this have no direction to push away along, every kernel and lane skips them
+constexpr float SEPARATION_EPSILON_2 = std::numeric_limits<float>::epsilon() * std::numeric_limits<float>::epsilon();
+
+const SteeringKernels& GetScalarSteeringKernels();
+const SteeringKernels& GetSse41SteeringKernels();
+const SteeringKernels& GetAvx2SteeringKernels();
+
+const SteeringKernels& GetSteeringKernels(SIMD_LEVEL level);
+const SteeringKernels& GetSteeringKernels();
+
+SIMD_LEVEL GetSupportedSimdLevel();
+SIMD_LEVEL GetSimdLevel();
+// Clamped to the supported level, not meant to be changed while an update is running
+void SetSimdLevel(SIMD_LEVEL level);
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FLOCKING_X86 1
+#endif
+
+// Only the kernels are built for their instruction set, the inline code they share with the rest of the program is not.
+// MSVC takes the intrinsics without /arch, which would build every inline function of the file for AVX2
+#if defined(__GNUC__) || defined(__clang__)
+#define FLOCKING_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FLOCKING_TARGET(isa)
+#endif
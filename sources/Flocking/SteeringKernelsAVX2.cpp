@@ -0,0 +1,128 @@
+﻿#include "pch.h"
+#include "SteeringKernels.h"
+#include "BoidStorage.h"
+
+#ifdef FLOCKING_X86
+#include <immintrin.h>
+
+namespace
+{
+    FLOCKING_TARGET("avx2,fma") float HorizontalSum(__m256 value)
+    {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+        sum = _mm_hadd_ps(sum, sum);
+        sum = _mm_hadd_ps(sum, sum);
+        return _mm_cvtss_f32(sum);
+    }
+
+    // All bits set in the first remaining lanes, masked loads read zeros into the others and never touch their memory
+    FLOCKING_TARGET("avx2,fma") __m256i GetTailMask(int remaining)
+    {
+        return _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+
+    FLOCKING_TARGET("avx2,fma") RVector3 SumLanes(const float* x, const float* y, const float* z, int count)
+    {
+        __m256 sumX = _mm256_setzero_ps();
+        __m256 sumY = _mm256_setzero_ps();
+        __m256 sumZ = _mm256_setzero_ps();
+
+        int i = 0;
+        for(; i + 8 <= count; i += 8) {
+            sumX = _mm256_add_ps(sumX, _mm256_loadu_ps(x + i));
+            sumY = _mm256_add_ps(sumY, _mm256_loadu_ps(y + i));
+            sumZ = _mm256_add_ps(sumZ, _mm256_loadu_ps(z + i));
+        }
+
+        if(i < count) {
+            const __m256i tail = GetTailMask(count - i);
+            sumX = _mm256_add_ps(sumX, _mm256_maskload_ps(x + i, tail));
+            sumY = _mm256_add_ps(sumY, _mm256_maskload_ps(y + i, tail));
+            sumZ = _mm256_add_ps(sumZ, _mm256_maskload_ps(z + i, tail));
+        }
+
+        return {HorizontalSum(sumX), HorizontalSum(sumY), HorizontalSum(sumZ)};
+    }
+
+    FLOCKING_TARGET("avx2,fma") RVector3 SumVelocitiesAvx2(const NeighbourBuffer& neighbours)
+    {
+        return SumLanes(neighbours.vx.data(), neighbours.vy.data(), neighbours.vz.data(), neighbours.Size());
+    }
+
+    FLOCKING_TARGET("avx2,fma") RVector3 SumPositionsAvx2(const NeighbourBuffer& neighbours)
+    {
+        return SumLanes(neighbours.px.data(), neighbours.py.data(), neighbours.pz.data(), neighbours.Size());
+    }
+
+    // lanes masks off the tail past the count, a zeroed lane would otherwise count as a neighbour at the origin
+    FLOCKING_TARGET("avx2,fma") void AccumulateSeparation(__m256 x, __m256 y, __m256 z, __m256 lanes, __m256 positionX, __m256 positionY, __m256 positionZ, __m256 limit, __m256& sumX, __m256& sumY, __m256& sumZ)
+    {
+        const __m256 epsilon_2 = _mm256_set1_ps(SEPARATION_EPSILON_2);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+        const __m256 dx = _mm256_sub_ps(positionX, x);
+        const __m256 dy = _mm256_sub_ps(positionY, y);
+        const __m256 dz = _mm256_sub_ps(positionZ, z);
+        const __m256 distance_2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+
+        // Lanes out of range, or too short to normalize, contribute nothing
+        const __m256 inRange = _mm256_and_ps(_mm256_cmp_ps(distance_2, limit, _CMP_LE_OQ), _mm256_cmp_ps(distance_2, epsilon_2, _CMP_GE_OQ));
+        const __m256 mask = _mm256_and_ps(inRange, lanes);
+
+        // rsqrt refined with one Newton-Raphson step instead of a sqrt and a divide per neighbour
+        __m256 inverseLength = _mm256_rsqrt_ps(distance_2);
+        const __m256 correction = _mm256_fnmadd_ps(_mm256_mul_ps(half, distance_2), _mm256_mul_ps(inverseLength, inverseLength), threeHalves);
+        inverseLength = _mm256_and_ps(_mm256_mul_ps(inverseLength, correction), mask);
+
+        sumX = _mm256_fmadd_ps(dx, inverseLength, sumX);
+        sumY = _mm256_fmadd_ps(dy, inverseLength, sumY);
+        sumZ = _mm256_fmadd_ps(dz, inverseLength, sumZ);
+    }
+
+    FLOCKING_TARGET("avx2,fma") RVector3 SumSeparationAvx2(const RVector3& position, float minDistance_2, const NeighbourBuffer& neighbours)
+    {
+        const int count = neighbours.Size();
+        const float* px = neighbours.px.data();
+        const float* py = neighbours.py.data();
+        const float* pz = neighbours.pz.data();
+
+        const __m256 positionX = _mm256_set1_ps(position.x);
+        const __m256 positionY = _mm256_set1_ps(position.y);
+        const __m256 positionZ = _mm256_set1_ps(position.z);
+        const __m256 limit = _mm256_set1_ps(minDistance_2);
+
+        __m256 sumX = _mm256_setzero_ps();
+        __m256 sumY = _mm256_setzero_ps();
+        __m256 sumZ = _mm256_setzero_ps();
+
+        const __m256 allLanes = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        int i = 0;
+        for(; i + 8 <= count; i += 8) {
+            AccumulateSeparation(_mm256_loadu_ps(px + i), _mm256_loadu_ps(py + i), _mm256_loadu_ps(pz + i), allLanes, positionX, positionY, positionZ, limit, sumX, sumY, sumZ);
+        }
+
+        if(i < count) {
+            const __m256i tail = GetTailMask(count - i);
+            AccumulateSeparation(_mm256_maskload_ps(px + i, tail), _mm256_maskload_ps(py + i, tail), _mm256_maskload_ps(pz + i, tail), _mm256_castsi256_ps(tail),
+                positionX, positionY, positionZ, limit, sumX, sumY, sumZ);
+        }
+
+        return {HorizontalSum(sumX), HorizontalSum(sumY), HorizontalSum(sumZ)};
+    }
+}
+
+const SteeringKernels& GetAvx2SteeringKernels()
+{
+    static const SteeringKernels kernels = {SumVelocitiesAvx2, SumPositionsAvx2, SumSeparationAvx2};
+    return kernels;
+}
+
+#else
+
+const SteeringKernels& GetAvx2SteeringKernels()
+{
+    return GetScalarSteeringKernels();
+}
+
+#endif
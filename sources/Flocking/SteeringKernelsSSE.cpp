@@ -0,0 +1,126 @@
+﻿#include "pch.h"
+#include "SteeringKernels.h"
+#include "BoidStorage.h"
+
+#ifdef FLOCKING_X86
+#include <smmintrin.h>
+
+namespace
+{
+    FLOCKING_TARGET("sse4.1") float HorizontalSum(__m128 value)
+    {
+        __m128 sum = _mm_add_ps(value, _mm_movehl_ps(value, value));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+        return _mm_cvtss_f32(sum);
+    }
+
+    // Two 4-wide halves per iteration keep 8 neighbours in flight like the AVX2 kernels
+    FLOCKING_TARGET("sse4.1") RVector3 SumLanes(const float* x, const float* y, const float* z, int count)
+    {
+        __m128 sumX = _mm_setzero_ps();
+        __m128 sumY = _mm_setzero_ps();
+        __m128 sumZ = _mm_setzero_ps();
+        __m128 sumX_1 = _mm_setzero_ps();
+        __m128 sumY_1 = _mm_setzero_ps();
+        __m128 sumZ_1 = _mm_setzero_ps();
+
+        int i = 0;
+        for(; i + 8 <= count; i += 8) {
+            sumX = _mm_add_ps(sumX, _mm_loadu_ps(x + i));
+            sumY = _mm_add_ps(sumY, _mm_loadu_ps(y + i));
+            sumZ = _mm_add_ps(sumZ, _mm_loadu_ps(z + i));
+            sumX_1 = _mm_add_ps(sumX_1, _mm_loadu_ps(x + i + 4));
+            sumY_1 = _mm_add_ps(sumY_1, _mm_loadu_ps(y + i + 4));
+            sumZ_1 = _mm_add_ps(sumZ_1, _mm_loadu_ps(z + i + 4));
+        }
+
+        RVector3 sum = {HorizontalSum(_mm_add_ps(sumX, sumX_1)), HorizontalSum(_mm_add_ps(sumY, sumY_1)), HorizontalSum(_mm_add_ps(sumZ, sumZ_1))};
+        for(; i < count; ++i) {
+            sum += RVector3{x[i], y[i], z[i]};
+        }
+
+        return sum;
+    }
+
+    FLOCKING_TARGET("sse4.1") RVector3 SumVelocitiesSse41(const NeighbourBuffer& neighbours)
+    {
+        return SumLanes(neighbours.vx.data(), neighbours.vy.data(), neighbours.vz.data(), neighbours.Size());
+    }
+
+    FLOCKING_TARGET("sse4.1") RVector3 SumPositionsSse41(const NeighbourBuffer& neighbours)
+    {
+        return SumLanes(neighbours.px.data(), neighbours.py.data(), neighbours.pz.data(), neighbours.Size());
+    }
+
+    FLOCKING_TARGET("sse4.1") void AccumulateSeparation(const float* px, const float* py, const float* pz, __m128 positionX, __m128 positionY, __m128 positionZ, __m128 limit, __m128& sumX, __m128& sumY, __m128& sumZ)
+    {
+        const __m128 epsilon_2 = _mm_set1_ps(SEPARATION_EPSILON_2);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+        const __m128 dx = _mm_sub_ps(positionX, _mm_loadu_ps(px));
+        const __m128 dy = _mm_sub_ps(positionY, _mm_loadu_ps(py));
+        const __m128 dz = _mm_sub_ps(positionZ, _mm_loadu_ps(pz));
+        const __m128 distance_2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        const __m128 mask = _mm_and_ps(_mm_cmple_ps(distance_2, limit), _mm_cmpge_ps(distance_2, epsilon_2));
+
+        __m128 inverseLength = _mm_rsqrt_ps(distance_2);
+        const __m128 correction = _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, distance_2), _mm_mul_ps(inverseLength, inverseLength)));
+        inverseLength = _mm_and_ps(_mm_mul_ps(inverseLength, correction), mask);
+
+        sumX = _mm_add_ps(sumX, _mm_mul_ps(dx, inverseLength));
+        sumY = _mm_add_ps(sumY, _mm_mul_ps(dy, inverseLength));
+        sumZ = _mm_add_ps(sumZ, _mm_mul_ps(dz, inverseLength));
+    }
+
+    FLOCKING_TARGET("sse4.1") RVector3 SumSeparationSse41(const RVector3& position, float minDistance_2, const NeighbourBuffer& neighbours)
+    {
+        const int count = neighbours.Size();
+        const float* px = neighbours.px.data();
+        const float* py = neighbours.py.data();
+        const float* pz = neighbours.pz.data();
+
+        const __m128 positionX = _mm_set1_ps(position.x);
+        const __m128 positionY = _mm_set1_ps(position.y);
+        const __m128 positionZ = _mm_set1_ps(position.z);
+        const __m128 limit = _mm_set1_ps(minDistance_2);
+
+        __m128 sumX = _mm_setzero_ps();
+        __m128 sumY = _mm_setzero_ps();
+        __m128 sumZ = _mm_setzero_ps();
+
+        int i = 0;
+        for(; i + 8 <= count; i += 8) {
+            AccumulateSeparation(px + i, py + i, pz + i, positionX, positionY, positionZ, limit, sumX, sumY, sumZ);
+            AccumulateSeparation(px + i + 4, py + i + 4, pz + i + 4, positionX, positionY, positionZ, limit, sumX, sumY, sumZ);
+        }
+
+        // No masked loads before AVX, the last few go through the same rule one by one
+        RVector3 shift = {HorizontalSum(sumX), HorizontalSum(sumY), HorizontalSum(sumZ)};
+        for(; i < count; ++i) {
+            const RVector3 direction = position - RVector3{px[i], py[i], pz[i]};
+            const float distance_2 = direction.lengthSquare();
+            if(distance_2 <= minDistance_2 && distance_2 >= SEPARATION_EPSILON_2) {
+                shift += direction.getUnit();
+            }
+        }
+
+        return shift;
+    }
+}
+
+const SteeringKernels& GetSse41SteeringKernels()
+{
+    static const SteeringKernels kernels = {SumVelocitiesSse41, SumPositionsSse41, SumSeparationSse41};
+    return kernels;
+}
+
+#else
+
+const SteeringKernels& GetSse41SteeringKernels()
+{
+    return GetScalarSteeringKernels();
+}
+
+#endif
@@ -0,0 +1,224 @@
+﻿#include "pch.h"
+#include "ThreadPool.h"
+
+double SchedulerStats::GetUtilization() const
+{
+    return capacityNanoseconds > 0 ? static_cast<double>(busyNanoseconds) / capacityNanoseconds : 0.0;
+}
+
+ThreadPool::ThreadPool(int workerCount)
+{
+    if(workerCount <= 0) {
+        workerCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    this->workerCount = std::max(1, workerCount);
+    queues = std::vector<WorkQueue>(this->workerCount);
+
+    threads.reserve(this->workerCount - 1);
+    for(int worker = 1; worker < this->workerCount; ++worker) {
+        threads.emplace_back(&ThreadPool::WorkerLoop, this, worker);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+int ThreadPool::GetWorkerCount() const
+{
+    return workerCount;
+}
+
+void ThreadPool::ParallelFor(int count, const Task& task)
+{
+    if(count <= 0) {
+        return;
+    }
+
+    const Clock::time_point start = Clock::now();
+
+    if(workerCount == 1 || count == 1) {
+        task(0, count, 0);
+
+        const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        queues[0].busyNanoseconds += elapsed;
+        ++queues[0].chunks;
+        capacityNanoseconds += elapsed * workerCount;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->count = count;
+        broadcast = false;
+        grain = std::max(1, count / (workerCount * CHUNKS_PER_WORKER));
+        remaining.store(count, std::memory_order_relaxed);
+        pending = workerCount - 1;
+        ++generation;
+    }
+    wakeUp.notify_all();
+
+    Run(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+    this->task = nullptr;
+
+    capacityNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() * workerCount;
+}
+
+void ThreadPool::ForEachWorker(const Task& task)
+{
+    if(workerCount == 1) {
+        task(0, 1, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        broadcast = true;
+        pending = workerCount - 1;
+        ++generation;
+    }
+    wakeUp.notify_all();
+
+    task(0, 1, 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+    this->task = nullptr;
+}
+
+SchedulerStats ThreadPool::TakeStats()
+{
+    SchedulerStats stats;
+    stats.capacityNanoseconds = capacityNanoseconds;
+    capacityNanoseconds = 0;
+
+    // Only called between two ParallelFor, no worker is touching its counters
+    for(WorkQueue& queue : queues) {
+        stats.steals += queue.steals;
+        stats.chunks += queue.chunks;
+        stats.busyNanoseconds += queue.busyNanoseconds;
+        queue.steals = 0;
+        queue.chunks = 0;
+        queue.busyNanoseconds = 0;
+    }
+    return stats;
+}
+
+void ThreadPool::WorkerLoop(int worker)
+{
+    unsigned seenGeneration = 0;
+
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this, seenGeneration] { return stopping || generation != seenGeneration; });
+            if(stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        if(broadcast) {
+            (*task)(worker, worker + 1, worker);
+        } else {
+            Run(worker);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --pending;
+        }
+        finished.notify_one();
+    }
+}
+
+void ThreadPool::Run(int worker)
+{
+    Range range;
+    range.begin = static_cast<int>(static_cast<long long>(count) * worker / workerCount);
+    range.end = static_cast<int>(static_cast<long long>(count) * (worker + 1) / workerCount);
+    if(range.begin < range.end) {
+        RunRange(worker, range);
+    }
+
+    while(remaining.load(std::memory_order_acquire) > 0) {
+        if(Pop(worker, range) || Steal(worker, range)) {
+            RunRange(worker, range);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ThreadPool::Pop(int worker, Range& range)
+{
+    WorkQueue& queue = queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.front == queue.back) {
+        return false;
+    }
+
+    range = queue.ranges[--queue.back];
+    if(queue.front == queue.back) {
+        queue.front = queue.back = 0;
+    }
+    return true;
+}
+
+bool ThreadPool::Steal(int worker, Range& range)
+{
+    for(int offset = 1; offset < workerCount; ++offset) {
+        WorkQueue& victim = queues[(worker + offset) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(victim.front == victim.back) {
+            continue;
+        }
+
+        range = victim.ranges[victim.front++];
+        if(victim.front == victim.back) {
+            victim.front = victim.back = 0;
+        }
+
+        ++queues[worker].steals;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::RunRange(int worker, Range range)
+{
+    WorkQueue& queue = queues[worker];
+
+    // Halve down to the grain and run the lowest chunk first, what is left waits at the back of the queue in ascending order
+    while(range.end - range.begin > grain) {
+        const int middle = range.begin + (range.end - range.begin) / 2;
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.back == QUEUE_CAPACITY) {
+            break;
+        }
+        queue.ranges[queue.back++] = {middle, range.end};
+        range.end = middle;
+    }
+
+    const Clock::time_point start = Clock::now();
+    (*task)(range.begin, range.end, worker);
+    queue.busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    ++queue.chunks;
+
+    remaining.fetch_sub(range.end - range.begin, std::memory_order_release);
+}
@@ -0,0 +1,122 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// What the workers did since the last TakeStats
+struct SchedulerStats
+{
+    // Time workers spent inside tasks over the time they were available to them
+    double GetUtilization() const;
+
+    uint64_t steals = 0;
+    uint64_t chunks = 0;
+    uint64_t busyNanoseconds = 0;
+    // Wall time of every ParallelFor times the worker count
+    uint64_t capacityNanoseconds = 0;
+};
+
+// Fixed set of worker threads running one work-stealing ParallelFor at a time.
+// The calling thread takes part in the work as worker 0.
+class ThreadPool
+{
+public:
+    // Borrows the callable for the duration of ParallelFor, so handing work to the pool never allocates
+    class Task
+    {
+    public:
+        // Called as function(int begin, int end, int worker)
+        template<typename Function>
+        Task(const Function& function) :
+            function(&function),
+            invoke([](const void* function, int begin, int end, int worker) { (*static_cast<const Function*>(function))(begin, end, worker); })
+        {}
+
+        void operator ()(int begin, int end, int worker) const
+        {
+            invoke(function, begin, end, worker);
+        }
+
+    private:
+        const void* function;
+        void (*invoke)(const void* function, int begin, int end, int worker);
+    };
+
+    explicit ThreadPool(int workerCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator =(const ThreadPool&) = delete;
+
+    int GetWorkerCount() const;
+
+    // Runs every index of [0, count) once and returns when all are done. Each worker starts on its own contiguous share
+    // and runs it in chunks, handing the upper half over to its queue whenever the queue is empty, so a worker that
+    // runs out steals the biggest pending range of another. Ranges and their worker vary from call to call.
+    // Not reentrant: one thread calls it at a time and a task must not call back into the pool
+    void ParallelFor(int count, const Task& task);
+    // Runs task(worker, worker + 1, worker) once on every worker, to flush what the threads keep for themselves.
+    // Same single caller rule as ParallelFor
+    void ForEachWorker(const Task& task);
+
+    // Resets the counters, not to be called while a ParallelFor is running
+    SchedulerStats TakeStats();
+
+#ifndef DEBUG
+// protected:
+#endif
+    using Clock = std::chrono::steady_clock;
+
+    // Chunk size is the count over this many chunks per worker, small enough for the tail to balance
+    constexpr static int CHUNKS_PER_WORKER = 16;
+    // Halving a range of int indices can not go deeper
+    constexpr static int QUEUE_CAPACITY = 64;
+
+    struct Range
+    {
+        int begin = 0;
+        int end = 0;
+    };
+
+    // The owner pushes and pops at the back, thieves take the oldest and biggest range from the front
+    struct alignas(64) WorkQueue
+    {
+        std::mutex mutex;
+        Range ranges[QUEUE_CAPACITY];
+        int front = 0;
+        int back = 0;
+
+        uint64_t steals = 0;
+        uint64_t chunks = 0;
+        uint64_t busyNanoseconds = 0;
+    };
+
+    void WorkerLoop(int worker);
+    void Run(int worker);
+    bool Pop(int worker, Range& range);
+    bool Steal(int worker, Range& range);
+    void RunRange(int worker, Range range);
+
+    std::vector<std::thread> threads;
+    int workerCount = 1;
+    std::vector<WorkQueue> queues;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable finished;
+
+    const Task* task = nullptr;
+    bool broadcast = false;
+    int count = 0;
+    int grain = 1;
+    std::atomic<int> remaining = 0;
+    int pending = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+
+    uint64_t capacityNanoseconds = 0;
+};
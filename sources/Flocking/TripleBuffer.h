@@ -0,0 +1,57 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest of a stream of values from one writer thread to one reader thread, neither side ever waits.
+// The writer fills the back buffer and swaps it with the middle one, the reader swaps the middle one with its
+// front buffer when it holds something newer. Values the reader did not get to in time are overwritten
+template<typename T>
+class TripleBuffer
+{
+public:
+    // Writer side, reused from two publishes ago, so it still holds whatever was written there
+    T& GetBack();
+    void Publish();
+
+    // Reader side, false when nothing was published since the last call and the front buffer is unchanged
+    bool Acquire();
+    const T& GetFront() const;
+
+private:
+    constexpr static uint8_t INDEX_MASK = 3;
+    constexpr static uint8_t FRESH = 4;
+
+    T buffers[3];
+    std::atomic<uint8_t> middle = 1;
+    uint8_t back = 0;
+    uint8_t front = 2;
+};
+
+template<typename T>
+T& TripleBuffer<T>::GetBack()
+{
+    return buffers[back];
+}
+
+template<typename T>
+void TripleBuffer<T>::Publish()
+{
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+template<typename T>
+bool TripleBuffer<T>::Acquire()
+{
+    if((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+        return false;
+    }
+
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+}
+
+template<typename T>
+const T& TripleBuffer<T>::GetFront() const
+{
+    return buffers[front];
+}
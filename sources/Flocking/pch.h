@@ -1,11 +1,14 @@
 ﻿#pragma once
 
+#include <mutex>
+
 #include <reactphysics3d/reactphysics3d.h>
 
 #include "MathExtension.h"
 
 extern reactphysics3d::PhysicsCommon& GetCommonPhysics() noexcept;
 extern reactphysics3d::PhysicsWorld& GetPhysicsWorld() noexcept;
+extern std::mutex& GetPhysicsMutex() noexcept;
 
 using reactphysics3d::CollisionBody;
 using reactphysics3d::RaycastInfo;
@@ -0,0 +1,101 @@
+#include "CacheCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+    int OpenReadMisses(uint64_t cache)
+    {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    uint64_t Read(int counter)
+    {
+        uint64_t value = 0;
+        if(counter < 0 || read(counter, &value, sizeof(value)) != sizeof(value)) {
+            return 0;
+        }
+        return value;
+    }
+#endif
+}
+
+CacheCounters::CacheCounters()
+{
+#ifdef __linux__
+    l1Data = OpenReadMisses(PERF_COUNT_HW_CACHE_L1D);
+    lastLevel = OpenReadMisses(PERF_COUNT_HW_CACHE_LL);
+#endif
+}
+
+CacheCounters::~CacheCounters()
+{
+#ifdef __linux__
+    if(l1Data >= 0) {
+        close(l1Data);
+    }
+    if(lastLevel >= 0) {
+        close(lastLevel);
+    }
+#endif
+}
+
+bool CacheCounters::IsAvailable() const
+{
+    return l1Data >= 0 && lastLevel >= 0;
+}
+
+void CacheCounters::Start()
+{
+#ifdef __linux__
+    if(IsAvailable()) {
+        ioctl(l1Data, PERF_EVENT_IOC_RESET, 0);
+        ioctl(lastLevel, PERF_EVENT_IOC_RESET, 0);
+        ioctl(l1Data, PERF_EVENT_IOC_ENABLE, 0);
+        ioctl(lastLevel, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void CacheCounters::Stop()
+{
+#ifdef __linux__
+    if(IsAvailable()) {
+        ioctl(l1Data, PERF_EVENT_IOC_DISABLE, 0);
+        ioctl(lastLevel, PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+}
+
+uint64_t CacheCounters::GetL1DataMisses() const
+{
+#ifdef __linux__
+    return Read(l1Data);
+#else
+    return 0;
+#endif
+}
+
+uint64_t CacheCounters::GetLastLevelMisses() const
+{
+#ifdef __linux__
+    return Read(lastLevel);
+#else
+    return 0;
+#endif
+}
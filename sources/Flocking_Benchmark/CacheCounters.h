@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+// L1 data and last level cache read misses of the process, through perf_event_open on Linux.
+// Threads started after construction are counted too. Elsewhere, or when the kernel does not expose
+// the hardware counters (virtual machines, perf_event_paranoid), IsAvailable is false.
+class CacheCounters
+{
+public:
+    CacheCounters();
+    ~CacheCounters();
+
+    CacheCounters(const CacheCounters&) = delete;
+    CacheCounters& operator =(const CacheCounters&) = delete;
+
+    bool IsAvailable() const;
+
+    void Start();
+    void Stop();
+
+    uint64_t GetL1DataMisses() const;
+    uint64_t GetLastLevelMisses() const;
+
+private:
+    int l1Data = -1;
+    int lastLevel = -1;
+};
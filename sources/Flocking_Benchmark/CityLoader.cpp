@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "CityLoader.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+namespace
+{
+    struct JsonValue
+    {
+        enum class TYPE
+        {
+            NUMBER,
+            STRING,
+            ARRAY,
+            OBJECT,
+            LITERAL
+        };
+
+        TYPE type = TYPE::LITERAL;
+        double number = 0.0;
+        std::string text;
+        std::vector<JsonValue> items;
+        std::map<std::string, JsonValue> members;
+    };
+
+    class JsonReader
+    {
+    public:
+        explicit JsonReader(const std::string& text) : text(text) {}
+
+        bool Read(JsonValue& value)
+        {
+            return ReadValue(value) && (SkipSpaces(), position == text.size());
+        }
+
+    private:
+        void SkipSpaces()
+        {
+            while(position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+                ++position;
+            }
+        }
+
+        bool Consume(char expected)
+        {
+            SkipSpaces();
+            if(position < text.size() && text[position] == expected) {
+                ++position;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool ReadValue(JsonValue& value)
+        {
+            SkipSpaces();
+            if(position >= text.size()) {
+                return false;
+            }
+
+            switch(text[position]) {
+            case '{':
+                return ReadObject(value);
+            case '[':
+                return ReadArray(value);
+            case '"':
+                value.type = JsonValue::TYPE::STRING;
+                return ReadString(value.text);
+            default:
+                return ReadScalar(value);
+            }
+        }
+
+        bool ReadObject(JsonValue& value)
+        {
+            value.type = JsonValue::TYPE::OBJECT;
+            Consume('{');
+            if(Consume('}')) {
+                return true;
+            }
+
+            do {
+                std::string key;
+                SkipSpaces();
+                if(!ReadString(key) || !Consume(':') || !ReadValue(value.members[key])) {
+                    return false;
+                }
+            } while(Consume(','));
+
+            return Consume('}');
+        }
+
+        bool ReadArray(JsonValue& value)
+        {
+            value.type = JsonValue::TYPE::ARRAY;
+            Consume('[');
+            if(Consume(']')) {
+                return true;
+            }
+
+            do {
+                value.items.emplace_back();
+                if(!ReadValue(value.items.back())) {
+                    return false;
+                }
+            } while(Consume(','));
+
+            return Consume(']');
+        }
+
+        bool ReadString(std::string& out)
+        {
+            if(position >= text.size() || text[position] != '"') {
+                return false;
+            }
+
+            // Escapes are kept as they are, the city file has none
+            const size_t end = text.find('"', position + 1);
+            if(end == std::string::npos) {
+                return false;
+            }
+
+            out = text.substr(position + 1, end - position - 1);
+            position = end + 1;
+            return true;
+        }
+
+        bool ReadScalar(JsonValue& value)
+        {
+            for(const char* literal : {"true", "false", "null"}) {
+                if(text.compare(position, std::strlen(literal), literal) == 0) {
+                    value.type = JsonValue::TYPE::LITERAL;
+                    value.text = literal;
+                    position += std::strlen(literal);
+                    return true;
+                }
+            }
+
+            const char* begin = text.c_str() + position;
+            char* end = nullptr;
+            value.type = JsonValue::TYPE::NUMBER;
+            value.number = std::strtod(begin, &end);
+            position += end - begin;
+            return end != begin;
+        }
+
+        const std::string& text;
+        size_t position = 0;
+    };
+
+    bool GetNumber(const JsonValue& object, const char* name, float& out)
+    {
+        const auto member = object.members.find(name);
+        if(member == object.members.end() || member->second.type != JsonValue::TYPE::NUMBER) {
+            return false;
+        }
+
+        out = static_cast<float>(member->second.number);
+        return true;
+    }
+}
+
+bool LoadCity(const std::string& path, std::vector<CityObstacle>& obstacles, std::string& error)
+{
+    std::ifstream stream(path);
+    if(!stream) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    const std::string fileData((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    JsonValue document;
+    if(!JsonReader(fileData).Read(document) || document.type != JsonValue::TYPE::OBJECT) {
+        error = "cannot parse " + path;
+        return false;
+    }
+
+    const auto skyscrapers = document.members.find("skyscrapers");
+    if(skyscrapers == document.members.end() || skyscrapers->second.type != JsonValue::TYPE::ARRAY) {
+        error = "no skyscrapers array in " + path;
+        return false;
+    }
+
+    for(const JsonValue& skyscraper : skyscrapers->second.items) {
+        float x, z, width, length, height;
+        if(!GetNumber(skyscraper, "pos_x", x) || !GetNumber(skyscraper, "pos_z", z) || !GetNumber(skyscraper, "width", width)
+            || !GetNumber(skyscraper, "length", length) || !GetNumber(skyscraper, "height", height)) {
+            error = "incomplete skyscraper in " + path;
+            return false;
+        }
+
+        // Same box as the game, which uses the width for both horizontal extents
+        obstacles.push_back({{x, height * 0.5f, z}, {width / 2.f, height / 2.f, width / 2.f}});
+    }
+
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "pch.h"
+
+struct CityObstacle
+{
+    RVector3 center;
+    RVector3 extents;
+};
+
+// Reads the skyscrapers of data/city/city.json into the boxes Game::OnInitialize registers with AddObstacle.
+// Only the small part of JSON the city file uses is understood, so the benchmark needs no JSON library.
+bool LoadCity(const std::string& path, std::vector<CityObstacle>& obstacles, std::string& error);
@@ -0,0 +1,420 @@
+#include "pch.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "CacheCounters.h"
+#include "CityLoader.h"
+#include "FlockingSimulation.h"
+
+// Headless run of FlockingSimulation over the city obstacles, the result is printed as a single JSON object.
+// Flocking_Benchmark [--scenario small|medium|large|collapsed] [--prey N] [--hunters M] [--frames F] [--warmup W] [--seed S]
+//                    [--storage aos|soa] [--update sequential|parallel] [--workers K] [--obstacles index|field|physics]
+//                    [--neighbours grid|kdtree|sweep] [--nearest K] [--steering exact|aggregates] [--attraction W] [--opening-angle A]
+//                    [--skin S] [--sort K] [--budget MS] [--slices N] [--observer x,y,z] [--city path/to/city.json]
+//                    [--output result.json]
+
+namespace
+{
+    struct Scenario
+    {
+        const char* name;
+        int prey;
+        int hunters;
+        // Radius of the ball around the centre of the bounds the boids start in, 0 spreads them over the whole bounds
+        float spread;
+    };
+
+    constexpr Scenario SCENARIOS[] = {
+        {"small", 1000, 10, 0.f},
+        {"medium", 10000, 100, 0.f},
+        {"large", 50000, 500, 0.f},
+        // The whole flock in one clump, the worst case of the metric neighbourhood
+        {"collapsed", 10000, 100, 3.f},
+    };
+
+    constexpr int APPROXIMATION_ERROR_SAMPLES = 2000;
+
+    struct Options
+    {
+        std::string scenario = "medium";
+        int prey = SCENARIOS[1].prey;
+        int hunters = SCENARIOS[1].hunters;
+        float spread = SCENARIOS[1].spread;
+        int frames = 300;
+        int warmup = 30;
+        unsigned seed = 1;
+        float deltaTime = 1.f / 60.f;
+
+        STORAGE_MODE storage = STORAGE_MODE::SOA;
+        UPDATE_MODE update = UPDATE_MODE::SEQUENTIAL;
+        int workers = DefaultSimulationParams::WORKER_COUNT;
+        OBSTACLE_BACKEND obstacles = DefaultSimulationParams::OBSTACLES;
+        NEIGHBOUR_BACKEND neighbours = DefaultSimulationParams::NEIGHBOURS;
+        int nearest = DefaultBehaviorParams::MAX_NEIGHBOURS;
+        STEERING_MODE steering = DefaultSimulationParams::STEERING;
+        float attraction = DefaultBehaviorParams::FLOCK_ATTRACTION_WEIGHT;
+        float openingAngle = DefaultSimulationParams::FLOCK_OPENING_ANGLE;
+        float skin = DefaultSimulationParams::NEIGHBOUR_SKIN;
+        int sortInterval = DefaultSimulationParams::SORT_INTERVAL;
+        float budget = DefaultSimulationParams::FRAME_BUDGET_MS;
+        int slices = DefaultSimulationParams::TIME_SLICES;
+        // Distance bands only apply with an observer
+        bool hasObserver = false;
+        RVector3 observer;
+
+        std::string city = FLOCKING_CITY_PATH;
+        std::string output;
+    };
+
+    const char* ToString(STORAGE_MODE mode)
+    {
+        return mode == STORAGE_MODE::SOA ? "soa" : "aos";
+    }
+
+    const char* ToString(UPDATE_MODE mode)
+    {
+        return mode == UPDATE_MODE::PARALLEL ? "parallel" : "sequential";
+    }
+
+    const char* ToString(NEIGHBOUR_BACKEND backend)
+    {
+        switch(backend) {
+        case NEIGHBOUR_BACKEND::KD_TREE:
+            return "kdtree";
+        case NEIGHBOUR_BACKEND::MORTON_SWEEP:
+            return "sweep";
+        default:
+            return "grid";
+        }
+    }
+
+    const char* ToString(STEERING_MODE mode)
+    {
+        return mode == STEERING_MODE::CELL_AGGREGATES ? "aggregates" : "exact";
+    }
+
+    const char* ToString(OBSTACLE_BACKEND backend)
+    {
+        switch(backend) {
+        case OBSTACLE_BACKEND::DISTANCE_FIELD:
+            return "field";
+        case OBSTACLE_BACKEND::PHYSICS:
+            return "physics";
+        default:
+            return "index";
+        }
+    }
+
+    // Uniform in the ball of radius spread around (0, 10, 0), the centre of the simulation bounds
+    template<typename T>
+    void SpawnCollapsed(FlockingSimulation& simulation, int count, float spread, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+        for(int i = 0; i < count; ++i) {
+            RVector3 offset;
+            do {
+                offset = {unit(generator), unit(generator), unit(generator)};
+            } while(offset.lengthSquare() > 1.f);
+
+            const RVector3 position = RVector3{0.f, 10.f, 0.f} + offset * spread;
+            const RVector3 velocity{unit(generator), unit(generator), unit(generator)};
+            simulation.Spawn<T>(&position.x, &velocity.x);
+        }
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for(int i = 1; i < argc; ++i) {
+            const std::string name = argv[i];
+            if(i + 1 >= argc) {
+                std::fprintf(stderr, "missing value for %s\n", name.c_str());
+                return false;
+            }
+            const std::string value = argv[++i];
+
+            if(name == "--scenario") {
+                bool found = false;
+                for(const Scenario& scenario : SCENARIOS) {
+                    if(value == scenario.name) {
+                        options.scenario = scenario.name;
+                        options.prey = scenario.prey;
+                        options.hunters = scenario.hunters;
+                        options.spread = scenario.spread;
+                        found = true;
+                    }
+                }
+                if(!found) {
+                    std::fprintf(stderr, "unknown scenario %s\n", value.c_str());
+                    return false;
+                }
+            } else if(name == "--prey") {
+                options.prey = std::stoi(value);
+                options.scenario = "custom";
+            } else if(name == "--hunters") {
+                options.hunters = std::stoi(value);
+                options.scenario = "custom";
+            } else if(name == "--frames") {
+                options.frames = std::max(1, std::stoi(value));
+            } else if(name == "--warmup") {
+                options.warmup = std::max(0, std::stoi(value));
+            } else if(name == "--seed") {
+                options.seed = static_cast<unsigned>(std::stoul(value));
+            } else if(name == "--storage") {
+                options.storage = value == "aos" ? STORAGE_MODE::AOS : STORAGE_MODE::SOA;
+            } else if(name == "--update") {
+                options.update = value == "parallel" ? UPDATE_MODE::PARALLEL : UPDATE_MODE::SEQUENTIAL;
+            } else if(name == "--workers") {
+                options.workers = std::stoi(value);
+            } else if(name == "--obstacles") {
+                options.obstacles = value == "physics" ? OBSTACLE_BACKEND::PHYSICS : (value == "field" ? OBSTACLE_BACKEND::DISTANCE_FIELD : OBSTACLE_BACKEND::STATIC_INDEX);
+            } else if(name == "--neighbours") {
+                options.neighbours = value == "kdtree" ? NEIGHBOUR_BACKEND::KD_TREE : (value == "sweep" ? NEIGHBOUR_BACKEND::MORTON_SWEEP : NEIGHBOUR_BACKEND::GRID);
+            } else if(name == "--nearest") {
+                options.nearest = std::max(0, std::stoi(value));
+            } else if(name == "--steering") {
+                options.steering = value == "aggregates" ? STEERING_MODE::CELL_AGGREGATES : STEERING_MODE::EXACT;
+            } else if(name == "--attraction") {
+                options.attraction = std::stof(value);
+            } else if(name == "--opening-angle") {
+                options.openingAngle = std::stof(value);
+            } else if(name == "--budget") {
+                options.budget = std::stof(value);
+            } else if(name == "--slices") {
+                options.slices = std::stoi(value);
+            } else if(name == "--observer") {
+                if(std::sscanf(value.c_str(), "%f,%f,%f", &options.observer.x, &options.observer.y, &options.observer.z) != 3) {
+                    std::fprintf(stderr, "observer %s is not x,y,z\n", value.c_str());
+                    return false;
+                }
+                options.hasObserver = true;
+            } else if(name == "--skin") {
+                options.skin = std::stof(value);
+            } else if(name == "--sort") {
+                options.sortInterval = std::stoi(value);
+            } else if(name == "--city") {
+                options.city = value;
+            } else if(name == "--output") {
+                options.output = value;
+            } else {
+                std::fprintf(stderr, "unknown option %s\n", name.c_str());
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    size_t GetPeakRssKiB()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters = {};
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.PeakWorkingSetSize / 1024;
+#else
+        rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+        // Linux reports kilobytes, macOS bytes
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+        return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+    }
+
+    const char* ToString(FRAME_PHASE phase)
+    {
+        switch(phase) {
+            case FRAME_PHASE::NEIGHBOUR_SEARCH: return "neighbour_search";
+            case FRAME_PHASE::TYPE_FILTERING: return "type_filtering";
+            case FRAME_PHASE::STEERING: return "steering";
+            case FRAME_PHASE::OBSTACLE_AVOIDANCE: return "obstacle_avoidance";
+            case FRAME_PHASE::INTEGRATION: return "integration";
+            case FRAME_PHASE::DEAD_COMPACTION: return "dead_compaction";
+            case FRAME_PHASE::SPATIAL_SORT: return "spatial_sort";
+        }
+        return "unknown";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::vector<CityObstacle> obstacles;
+    std::string error;
+    if(!LoadCity(options.city, obstacles, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    // Opened before the simulation starts any thread, so the workers are counted as well
+    CacheCounters cacheCounters;
+
+    FlockingSimulation simulation;
+    simulation.SetStorageMode(options.storage);
+    simulation.SetUpdateMode(options.update);
+    simulation.SetWorkerCount(options.workers);
+    simulation.SetNeighbourBackend(options.neighbours);
+    simulation.SetNeighbourSkin(options.skin);
+    simulation.SetSteeringMode(options.steering);
+    simulation.SetFlockOpeningAngle(options.openingAngle);
+    simulation.SetSortInterval(options.sortInterval);
+    simulation.SetFrameBudget(options.budget);
+    simulation.SetTimeSlices(options.slices);
+    simulation.SetObservers(&options.observer.x, options.hasObserver ? 1 : 0);
+    // Built synchronously so the first measured frame does not race the field build
+    simulation.SetObstacleBackend(options.obstacles);
+    simulation.SetObstacleFieldCellSize(DefaultSimulationParams::OBSTACLE_FIELD_CELL_SIZE, false);
+
+    for(const CityObstacle& obstacle : obstacles) {
+        simulation.AddObstacle(&obstacle.center.x, &obstacle.extents.x);
+    }
+
+    simulation.GetBehavior<Behavior>().maxNeighbours = options.nearest;
+    simulation.GetBehavior<PreyBehavior>().maxNeighbours = options.nearest;
+    simulation.GetBehavior<HunterBehavior>().maxNeighbours = options.nearest;
+    simulation.GetBehavior<Behavior>().flockAttractionWeight = options.attraction;
+    simulation.GetBehavior<PreyBehavior>().flockAttractionWeight = options.attraction;
+
+    simulation.SetSeed(options.seed);
+    if(options.spread > 0.f) {
+        SpawnCollapsed<PreyBehavior>(simulation, options.prey, options.spread, options.seed);
+        SpawnCollapsed<HunterBehavior>(simulation, options.hunters, options.spread, options.seed + 1);
+    } else {
+        simulation.Spawn<PreyBehavior>(options.prey);
+        simulation.Spawn<HunterBehavior>(options.hunters);
+    }
+
+    for(int frame = 0; frame < options.warmup; ++frame) {
+        simulation.OnUpdate(options.deltaTime);
+    }
+
+    const size_t boidsAtStart = simulation.GetBoids().size();
+    double boidFrames = 0.0;
+
+    cacheCounters.Start();
+    double worstFrameNs = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    for(int frame = 0; frame < options.frames; ++frame) {
+        boidFrames += static_cast<double>(simulation.GetBoids().size());
+        const auto frameStart = std::chrono::steady_clock::now();
+        simulation.OnUpdate(options.deltaTime);
+        worstFrameNs = std::max(worstFrameNs, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - frameStart).count());
+    }
+    const auto end = std::chrono::steady_clock::now();
+    cacheCounters.Stop();
+
+    // On the final state, outside the measured frames
+    const ApproximationError approximationError = simulation.MeasureApproximationError(APPROXIMATION_ERROR_SAMPLES);
+
+    const double totalNs = std::chrono::duration<double, std::nano>(end - start).count();
+    const double nsPerBoidFrame = boidFrames > 0.0 ? totalNs / boidFrames : 0.0;
+    const double framesPerSecond = options.frames / (totalNs * 1e-9);
+
+    FILE* out = stdout;
+    if(!options.output.empty()) {
+        out = std::fopen(options.output.c_str(), "w");
+        if(out == nullptr) {
+            std::fprintf(stderr, "cannot write %s\n", options.output.c_str());
+            return 1;
+        }
+    }
+
+    std::fprintf(out, "{\n");
+    std::fprintf(out, "  \"scenario\": \"%s\",\n", options.scenario.c_str());
+    std::fprintf(out, "  \"prey\": %d,\n", options.prey);
+    std::fprintf(out, "  \"hunters\": %d,\n", options.hunters);
+    std::fprintf(out, "  \"obstacles\": %zu,\n", obstacles.size());
+    std::fprintf(out, "  \"seed\": %u,\n", options.seed);
+    std::fprintf(out, "  \"storage\": \"%s\",\n", ToString(options.storage));
+    std::fprintf(out, "  \"update\": \"%s\",\n", ToString(simulation.GetUpdateMode()));
+    std::fprintf(out, "  \"workers\": %d,\n", simulation.GetWorkerCount());
+    std::fprintf(out, "  \"obstacle_backend\": \"%s\",\n", ToString(options.obstacles));
+    std::fprintf(out, "  \"neighbour_backend\": \"%s\",\n", ToString(simulation.GetNeighbourBackend()));
+    std::fprintf(out, "  \"max_neighbours\": %d,\n", options.nearest);
+    std::fprintf(out, "  \"steering\": \"%s\",\n", ToString(simulation.GetSteeringMode()));
+    std::fprintf(out, "  \"alignment_error_deg\": %.3f,\n", approximationError.alignmentDegrees);
+    std::fprintf(out, "  \"cohesion_error_deg\": %.3f,\n", approximationError.cohesionDegrees);
+    std::fprintf(out, "  \"flock_attraction\": %.3f,\n", options.attraction);
+    std::fprintf(out, "  \"opening_angle\": %.3f,\n", simulation.GetFlockOpeningAngle());
+    std::fprintf(out, "  \"neighbour_skin\": %.3f,\n", simulation.GetNeighbourSkin());
+    std::fprintf(out, "  \"sort_interval\": %d,\n", simulation.GetSortInterval());
+    std::fprintf(out, "  \"frame_budget_ms\": %.3f,\n", simulation.GetFrameBudget());
+    std::fprintf(out, "  \"lod_level\": %d,\n", simulation.GetLodLevel());
+    std::fprintf(out, "  \"time_slices\": %d,\n", simulation.GetTimeSlices());
+    if(options.hasObserver) {
+        std::fprintf(out, "  \"observer\": [%.3f, %.3f, %.3f],\n", options.observer.x, options.observer.y, options.observer.z);
+    } else {
+        std::fprintf(out, "  \"observer\": null,\n");
+    }
+    std::fprintf(out, "  \"warmup_frames\": %d,\n", options.warmup);
+    std::fprintf(out, "  \"frames\": %d,\n", options.frames);
+    std::fprintf(out, "  \"boids_start\": %zu,\n", boidsAtStart);
+    std::fprintf(out, "  \"boids_end\": %zu,\n", simulation.GetBoids().size());
+    std::fprintf(out, "  \"total_ms\": %.3f,\n", totalNs * 1e-6);
+    std::fprintf(out, "  \"ns_per_boid_frame\": %.3f,\n", nsPerBoidFrame);
+    std::fprintf(out, "  \"frames_per_second\": %.3f,\n", framesPerSecond);
+    std::fprintf(out, "  \"worst_frame_ms\": %.3f,\n", worstFrameNs * 1e-6);
+    std::fprintf(out, "  \"peak_rss_kib\": %zu,\n", GetPeakRssKiB());
+    if(cacheCounters.IsAvailable() && boidFrames > 0.0) {
+        std::fprintf(out, "  \"l1d_misses_per_boid_frame\": %.3f,\n", cacheCounters.GetL1DataMisses() / boidFrames);
+        std::fprintf(out, "  \"llc_misses_per_boid_frame\": %.3f,\n", cacheCounters.GetLastLevelMisses() / boidFrames);
+    } else {
+        std::fprintf(out, "  \"l1d_misses_per_boid_frame\": null,\n");
+        std::fprintf(out, "  \"llc_misses_per_boid_frame\": null,\n");
+    }
+
+    // Over the profiler window, the last DefaultSimulationParams::FRAME_STATS_WINDOW frames
+    const FrameStats stats = simulation.GetFrameStats();
+    std::fprintf(out, "  \"profile\": {\n");
+    std::fprintf(out, "    \"frames\": %d,\n", stats.frames);
+    std::fprintf(out, "    \"boids_per_frame\": %.3f,\n", stats.boidsPerFrame);
+    std::fprintf(out, "    \"average_neighbours\": %.3f,\n", stats.averageNeighbours);
+    std::fprintf(out, "    \"raycasts_per_frame\": %.3f,\n", stats.raycastsPerFrame);
+    std::fprintf(out, "    \"neighbour_list_rebuild_rate\": %.3f,\n", stats.neighbourListRebuildRate);
+    std::fprintf(out, "    \"steals_per_frame\": %.3f,\n", stats.stealsPerFrame);
+    std::fprintf(out, "    \"worker_utilization\": %.3f,\n", stats.workerUtilization);
+    std::fprintf(out, "    \"dropped_samples\": %llu,\n", static_cast<unsigned long long>(stats.droppedSamples));
+    std::fprintf(out, "    \"distance_bands\": [\n");
+    for(int band = 0; band < DISTANCE_BAND_COUNT; ++band) {
+        const DistanceBand& distanceBand = simulation.GetDistanceBand(band);
+        const BandStats& bandStats = stats.bands[band];
+        std::fprintf(out, "      {\"from\": %.1f, \"interval\": %d, \"raycasts\": %s, \"boids_per_frame\": %.3f, \"steered_per_frame\": %.3f, \"saved_ms\": %.4f}%s\n",
+            distanceBand.distance, distanceBand.updateInterval, distanceBand.raycasts ? "true" : "false", bandStats.boidsPerFrame,
+            bandStats.steeredPerFrame, bandStats.savedMs, band + 1 < DISTANCE_BAND_COUNT ? "," : "");
+    }
+    std::fprintf(out, "    ],\n");
+    std::fprintf(out, "    \"phases_ms\": {\n");
+    for(int phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+        const PhaseStats& phaseStats = stats.phases[phase];
+        std::fprintf(out, "      \"%s\": {\"min\": %.4f, \"mean\": %.4f, \"p99\": %.4f}%s\n", ToString(static_cast<FRAME_PHASE>(phase)),
+            phaseStats.minMs, phaseStats.meanMs, phaseStats.p99Ms, phase + 1 < FRAME_PHASE_COUNT ? "," : "");
+    }
+    std::fprintf(out, "    }\n");
+    std::fprintf(out, "  }\n");
+    std::fprintf(out, "}\n");
+
+    if(out != stdout) {
+        std::fclose(out);
+    }
+
+    return 0;
+}
@@ -159,7 +159,7 @@ namespace cdp_framework
 		DrawGrid( xaxis, yaxis, g_XMZero, 20, 20, Colors::DarkSlateGray );
 
 		// Render Game
-		m_game->OnRender( m_RenderContext );
+		m_game->OnRender( m_RenderContext, static_cast< float >( m_timer.GetInterpolationAlpha() ) );
 
 		// Render FPS
 		m_sprites->Begin();
@@ -1,9 +1,11 @@
 ﻿#include "pch.h"
 #include "FlockingManager.h"
 
-void FlockingManager::OnInitialize()
+void FlockingManager::OnInitialize(ThreadPool& scheduler)
 {
     flockingSimulation.OnInitialize();
+    flockingSimulation.SetThreadPool(&scheduler);
+    flockingSimulation.SetUpdateMode(UPDATE_MODE::PARALLEL);
 
     renderObjects[BEHAVIOR_TYPE::DEFAULT] = GetEngine().CreateSpherePrimitive(1.f);
     renderObjects[BEHAVIOR_TYPE::PREY] = GetEngine().CreateSpherePrimitive(1.f);
@@ -16,7 +18,9 @@ void FlockingManager::OnInitialize()
 
 void FlockingManager::OnUpdate(float deltaTime)
 {
-    flockingSimulation.OnUpdate(deltaTime);
+    if(!simulationThread.IsRunning()) {
+        simulationThread.Step(deltaTime);
+    }
 }
 
 void FlockingManager::OnUpdate(float deltaTime, DirectX::Keyboard& keyboard, DirectX::Mouse& mouse, DirectX::GamePad& gamepad)
@@ -27,15 +31,26 @@ void FlockingManager::OnUpdate(float deltaTime, DirectX::Keyboard& keyboard, Dir
     OnUpdate(deltaTime);
 }
 
-void FlockingManager::OnRender(cdp_framework::RenderContextPtr& renderContext) const
+void FlockingManager::OnRender(cdp_framework::RenderContextPtr& renderContext, float interpolationAlpha)
 {
-    for(const Boid& boid : flockingSimulation.GetBoids()) {
-        renderContext->RenderPrimitive(renderObjects.at(boid.behavior->GetType()), {boid.radius, boid.radius, boid.radius}, Vector3{&boid.position.x}, Vector3::Zero, colors.at(boid.behavior->GetType()));
+    const SimulationSnapshot& snapshot = simulationThread.AcquireSnapshot();
+    const float alpha = simulationThread.IsRunning() ? simulationThread.GetInterpolationAlpha(snapshot) : interpolationAlpha;
+
+    for(size_t i = 0; i < snapshot.positions.size(); ++i) {
+        const float radius = snapshot.radii[i];
+        const RVector3 position = snapshot.GetPosition(i, alpha);
+        renderContext->RenderPrimitive(renderObjects.at(snapshot.types[i]), {radius, radius, radius}, Vector3{&position.x}, Vector3::Zero, colors.at(snapshot.types[i]));
     }
 }
 
+void FlockingManager::StartSimulationThread(float stepSeconds)
+{
+    simulationThread.Start(stepSeconds);
+}
+
 void FlockingManager::OnShutdown()
 {
+    simulationThread.Stop();
     renderObjects.clear();
     colors.clear();
 }
@@ -47,11 +62,32 @@ void FlockingManager::AddObstacle(const Vector3& position, const Vector3& extent
 
 void FlockingManager::Spawn(int boidsCount)
 {
-    flockingSimulation.Spawn<PreyBehavior>(boidsCount);
+    SimulationCommand command;
+    command.command = SIMULATION_COMMAND::SPAWN_RANDOM;
+    command.type = BEHAVIOR_TYPE::PREY;
+    command.count = boidsCount;
+    simulationThread.Push(command);
+}
+
+BoidHandle FlockingManager::SpawnHunter(const Vector3& position, const Vector3& direction)
+{
+    SimulationCommand command;
+    command.type = BEHAVIOR_TYPE::HUNTER;
+    std::copy(&position.x, &position.x + 3, command.position);
+    std::copy(&direction.x, &direction.x + 3, command.velocity);
+    return simulationThread.PushSpawn(command);
+}
+
+bool FlockingManager::IsAlive(BoidHandle handle)
+{
+    return simulationThread.AcquireSnapshot().IsAlive(handle);
 }
 
-void FlockingManager::SpawnHunter(const Vector3& position, const Vector3& direction)
+void FlockingManager::SetObserver(const Vector3& position)
 {
-    flockingSimulation.Spawn<HunterBehavior>(&position.x, &direction.x);
+    SimulationCommand command;
+    command.command = SIMULATION_COMMAND::SET_OBSERVER;
+    std::copy(&position.x, &position.x + 3, command.position);
+    simulationThread.Push(command);
 }
 
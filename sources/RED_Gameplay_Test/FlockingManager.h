@@ -3,23 +3,42 @@
 
 #include "IRenderContext.h"
 #include "../Flocking/FlockingSimulation.h"
+#include "../Flocking/SimulationThread.h"
 
 
 class FlockingManager
 {
 public:
-    void OnInitialize();
+    // The simulation updates in parallel on the game's scheduler
+    void OnInitialize(ThreadPool& scheduler);
     void OnUpdate(float deltaTime);
     void OnUpdate(float deltaTime, DirectX::Keyboard& keyboard, DirectX::Mouse& mouse, DirectX::GamePad& gamepad);
     void OnShutdown();
-    void OnRender(cdp_framework::RenderContextPtr& renderContext) const;
+    // Draws the latest snapshot the simulation published, interpolated by the thread's own timing while it runs and
+    // by interpolationAlpha of the game's fixed step otherwise
+    void OnRender(cdp_framework::RenderContextPtr& renderContext, float interpolationAlpha);
 
+    // From here on the simulation steps at its own fixed rate on a thread of its own and OnUpdate leaves it alone
+    void StartSimulationThread(float stepSeconds);
+
+    // Only before StartSimulationThread
     void AddObstacle(const Vector3& position, const Vector3& extents);
+    // Queued, the boids appear with the next simulation step
     void Spawn(int boidsCount);
-    void SpawnHunter(const Vector3& position, const Vector3& direction);
+    // The handle stays valid across updates, invalid when none was reserved or the queue was full. IsAlive tells when
+    // the hunter is gone
+    BoidHandle SpawnHunter(const Vector3& position, const Vector3& direction);
+    // From the latest snapshot, so false until the step that spawns the boid has been published
+    bool IsAlive(BoidHandle handle);
+    // Boids far from the observer steer less often and skip obstacle raycasts, queued like the spawns
+    void SetObserver(const Vector3& position);
+
+    // Flocking steps at a lower rate than frames are drawn, the rendering interpolation hides it
+    constexpr static float SIMULATION_STEP = 1.f / 30.f;
 
 protected:
     FlockingSimulation flockingSimulation;
+    SimulationThread simulationThread{flockingSimulation};
     std::unordered_map<BEHAVIOR_TYPE, PrimitivePtr> renderObjects;
     std::unordered_map<BEHAVIOR_TYPE, Color> colors;
 };
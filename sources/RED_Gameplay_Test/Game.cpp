@@ -11,6 +11,7 @@
 
 Game::Game()
 {
+    m_scheduler = std::make_unique< ThreadPool >();
     m_camera = std::make_unique< Camera >();
     m_city = std::make_unique< City >();
     m_flocking_manager = std::make_unique< FlockingManager >();
@@ -23,30 +24,32 @@ Game::~Game() = default;
 void Game::OnInitialize()
 {
     m_city->OnInitialize();
-   	m_flocking_manager->OnInitialize();
+   	m_flocking_manager->OnInitialize( *m_scheduler );
 	m_crosshair->OnInitialize();
 
 	for(const Skyscraper& obstacle : m_city->GetSkyscrapers()) {
 		m_flocking_manager->AddObstacle(obstacle.position, Vector3{obstacle.width / 2.f, obstacle.height / 2.f, obstacle.width / 2.f});
 	}
 	m_flocking_manager->Spawn(100);
+	m_flocking_manager->StartSimulationThread( FlockingManager::SIMULATION_STEP );
 }
 
 void Game::OnUpdate( float deltaTime, DirectX::Keyboard& keyboard, DirectX::Mouse& mouse, DirectX::GamePad& gamepad )
 {
 	m_camera->OnUpdate( deltaTime, keyboard, mouse, gamepad );
 	m_city->OnUpdate( deltaTime );
+	m_flocking_manager->SetObserver( m_camera->GetPosition() );
 	m_flocking_manager->OnUpdate(deltaTime);
     m_crosshair->OnUpdate( deltaTime, mouse, gamepad );
     m_shooting_manager->OnUpdate( deltaTime, *m_camera.get(), *m_flocking_manager.get(), keyboard, mouse, gamepad );
 }
 
-void Game::OnRender( cdp_framework::RenderContextPtr& renderContext )
+void Game::OnRender( cdp_framework::RenderContextPtr& renderContext, float interpolationAlpha )
 {
 #ifndef DEBUG
 	m_city->OnRender( renderContext );
 #endif
-    m_flocking_manager->OnRender(renderContext);
+    m_flocking_manager->OnRender(renderContext, interpolationAlpha);
 	m_crosshair->OnRender( renderContext );
 }
 
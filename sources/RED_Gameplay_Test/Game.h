@@ -26,10 +26,12 @@ public:
 
 	void OnInitialize() override;
 	void OnUpdate( float deltaTime, DirectX::Keyboard& keyboard, DirectX::Mouse& mouse, DirectX::GamePad& gamepad ) override;
-	void OnRender( cdp_framework::RenderContextPtr& renderContext ) override;
+	void OnRender( cdp_framework::RenderContextPtr& renderContext, float interpolationAlpha ) override;
 	void OnShutdown() override;
 
 private:
+	// Work-stealing workers, driven by the flocking simulation thread. Declared first so it outlives them
+	std::unique_ptr< ThreadPool >			                m_scheduler;
 	std::unique_ptr< Camera >				                m_camera;
     std::unique_ptr< City >					                m_city;
     std::unique_ptr< FlockingManager >			            m_flocking_manager;
@@ -13,7 +13,8 @@ namespace cdp_framework
 		virtual ~IGame() = default;
 		virtual void OnInitialize() = 0;
 		virtual void OnUpdate( float deltaTime, DirectX::Keyboard& keyboard, DirectX::Mouse& mouse, DirectX::GamePad& gamepad ) = 0;
-		virtual void OnRender( RenderContextPtr& renderContext ) = 0;
+		// interpolationAlpha is how far the frame is between the last fixed update and the next one
+		virtual void OnRender( RenderContextPtr& renderContext, float interpolationAlpha ) = 0;
 		virtual void OnShutdown() = 0;
 	};
 }
\ No newline at end of file
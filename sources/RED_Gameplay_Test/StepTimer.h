@@ -50,6 +50,9 @@ namespace DX
 		// Get the current framerate.
 		uint32_t GetFramesPerSecond() const noexcept { return m_framesPerSecond; }
 
+		// Get how far the leftover ticks of a fixed timestep are into the next update, from 0 to 1.
+		double GetInterpolationAlpha() const noexcept { return m_isFixedTimeStep ? static_cast< double >( m_leftOverTicks ) / m_targetElapsedTicks : 1.0; }
+
 		// Set whether to use fixed or variable timestep mode.
 		void SetFixedTimeStep( bool isFixedTimestep ) noexcept { m_isFixedTimeStep = isFixedTimestep; }
 
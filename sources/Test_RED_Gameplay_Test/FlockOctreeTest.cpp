@@ -0,0 +1,51 @@
+﻿#include "pch.h"
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <FlockOctree.h>
+
+TEST( FlockOctreeTest, MatchesDirectSum )
+{
+    constexpr int COUNT = 2000;
+    constexpr float NEAR = 1.5f;
+    constexpr float FAR = 15.f;
+
+    vector<RVector3> positions(COUNT);
+    vector<RVector3> velocities(COUNT);
+    for(int i = 0; i < COUNT; ++i) {
+        positions[i] = {std::fmod(i * 0.618f, 1.f) * 40.f - 20.f, std::fmod(i * 0.414f, 1.f) * 20.f, std::fmod(i * 0.732f, 1.f) * 40.f - 20.f};
+        velocities[i] = {std::fmod(i * 0.271f, 1.f), 1.f, 0.f};
+    }
+
+    FlockOctree octree;
+    octree.Build(COUNT, [](int i) { return i % 10 != 0; }, [&](int i) { return positions[i]; }, [&](int i) { return velocities[i]; });
+
+    for(const RVector3& position : {RVector3{5.f, 4.f, -10.f}, RVector3{-18.f, 1.f, 15.f}, positions[3]}) {
+        FarField expected;
+        for(int i = 0; i < COUNT; ++i) {
+            const float distance_2 = (positions[i] - position).lengthSquare();
+            if(i % 10 != 0 && distance_2 > NEAR * NEAR && distance_2 < FAR * FAR) {
+                const float pull = 1.f / std::sqrt(distance_2) - 1.f / FAR;
+                expected.center += positions[i] * pull;
+                expected.velocity += velocities[i] * pull;
+                expected.weight += pull;
+            }
+        }
+        expected.center /= expected.weight;
+        expected.velocity /= expected.weight;
+
+        // Opening nothing is the direct sum
+        octree.SetOpeningAngle(0.f);
+        const FarField exact = octree.Query(position, NEAR, FAR);
+        ASSERT_NEAR(exact.weight, expected.weight, expected.weight * 1e-4f);
+        ASSERT_NEAR((exact.center - expected.center).length(), 0.f, 1e-3f);
+        ASSERT_NEAR((exact.velocity - expected.velocity).length(), 0.f, 1e-3f);
+
+        octree.SetOpeningAngle(DefaultSimulationParams::FLOCK_OPENING_ANGLE);
+        const FarField approximate = octree.Query(position, NEAR, FAR);
+        ASSERT_NEAR(approximate.weight, expected.weight, expected.weight * 0.05f);
+        ASSERT_LT(GetAngleBetween(approximate.center - position, expected.center - position), 2.f);
+        ASSERT_NEAR((approximate.velocity - expected.velocity).length(), 0.f, 0.01f);
+    }
+}
@@ -0,0 +1,189 @@
+﻿#include "pch.h"
+#include <chrono>
+#include <reactphysics3d/reactphysics3d.h>
+
+#include <FlockingSimulation.h>
+
+// Benchmarks are disabled by default, run them with --gtest_also_run_disabled_tests --gtest_filter=FlockingBenchmark.*
+
+namespace
+{
+    constexpr int WARMUP_FRAMES = 2;
+    constexpr int MEASURED_FRAMES = 10;
+    constexpr float DELTA_TIME = 1.f / 60.f;
+
+    double MeasureUpdateMs(FlockingSimulation& simulation)
+    {
+        for(int i = 0; i < WARMUP_FRAMES; ++i) {
+            simulation.OnUpdate(DELTA_TIME);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < MEASURED_FRAMES; ++i) {
+            simulation.OnUpdate(DELTA_TIME);
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::milli>(end - start).count() / MEASURED_FRAMES;
+    }
+}
+
+TEST( FlockingBenchmark, DISABLED_NeighboursGridVsBruteForce )
+{
+    constexpr int BOIDS_COUNTS[] = {250, 500, 1000, 2000, 4000, 8000};
+
+    std::printf("%8s %16s %16s %8s\n", "boids", "brute force ms", "grid ms", "speedup");
+    for(const int boidsCount : BOIDS_COUNTS) {
+        FlockingSimulation bruteForce;
+        bruteForce.useSpatialGrid = false;
+        bruteForce.Spawn<PreyBehavior>(boidsCount);
+
+        FlockingSimulation grid;
+        grid.useSpatialGrid = true;
+        grid.Spawn<PreyBehavior>(boidsCount);
+
+        const double bruteForceMs = MeasureUpdateMs(bruteForce);
+        const double gridMs = MeasureUpdateMs(grid);
+
+        std::printf("%8d %16.3f %16.3f %7.1fx\n", boidsCount, bruteForceMs, gridMs, bruteForceMs / gridMs);
+    }
+}
+
+TEST( FlockingBenchmark, DISABLED_AoSVsSoA )
+{
+    constexpr int BOIDS_COUNTS[] = {2000, 8000, 32000};
+
+    std::printf("%8s %16s %16s %8s\n", "boids", "AoS ms", "SoA ms", "speedup");
+    for(const int boidsCount : BOIDS_COUNTS) {
+        FlockingSimulation aos;
+        aos.Spawn<PreyBehavior>(boidsCount);
+
+        FlockingSimulation soa;
+        soa.SetStorageMode(STORAGE_MODE::SOA);
+        soa.Spawn<PreyBehavior>(boidsCount);
+
+        const double aosMs = MeasureUpdateMs(aos);
+        const double soaMs = MeasureUpdateMs(soa);
+
+        std::printf("%8d %16.3f %16.3f %7.1fx\n", boidsCount, aosMs, soaMs, aosMs / soaMs);
+    }
+}
+
+TEST( FlockingBenchmark, DISABLED_ParallelScaling )
+{
+    constexpr int BOIDS_COUNT = 32000;
+    const int maxWorkers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    FlockingSimulation sequential;
+    sequential.SetStorageMode(STORAGE_MODE::SOA);
+    sequential.Spawn<PreyBehavior>(BOIDS_COUNT);
+    const double sequentialMs = MeasureUpdateMs(sequential);
+
+    std::printf("%8s %16s %8s\n", "workers", "ms", "speedup");
+    std::printf("%8s %16.3f %7.1fx\n", "seq", sequentialMs, 1.0);
+    for(int workers = 1; workers <= maxWorkers; workers *= 2) {
+        FlockingSimulation parallel;
+        parallel.SetUpdateMode(UPDATE_MODE::PARALLEL);
+        parallel.SetWorkerCount(workers);
+        parallel.Spawn<PreyBehavior>(BOIDS_COUNT);
+
+        const double parallelMs = MeasureUpdateMs(parallel);
+        std::printf("%8d %16.3f %7.1fx\n", workers, parallelMs, sequentialMs / parallelMs);
+    }
+}
+
+TEST( FlockingBenchmark, DISABLED_VirtualVsPartitioned )
+{
+    constexpr int PREY_COUNT = 9000;
+    constexpr int HUNTERS_COUNT = 1000;
+
+    // Same flock in every mode, a single worker so only the dispatch differs
+    FlockingSimulation virtualDispatch;
+    virtualDispatch.Spawn<PreyBehavior>(PREY_COUNT);
+    virtualDispatch.Spawn<HunterBehavior>(HUNTERS_COUNT);
+
+    FlockingSimulation tagDispatch;
+    tagDispatch.SetStorageMode(STORAGE_MODE::SOA);
+
+    FlockingSimulation partitioned;
+    partitioned.SetUpdateMode(UPDATE_MODE::PARALLEL);
+    partitioned.SetWorkerCount(1);
+
+    for(const Boid& boid : virtualDispatch.GetBoids()) {
+        if(boid.behavior->GetType() == BEHAVIOR_TYPE::HUNTER) {
+            tagDispatch.Spawn<HunterBehavior>(&boid.position.x, &boid.velocity.x);
+            partitioned.Spawn<HunterBehavior>(&boid.position.x, &boid.velocity.x);
+        } else {
+            tagDispatch.Spawn<PreyBehavior>(&boid.position.x, &boid.velocity.x);
+            partitioned.Spawn<PreyBehavior>(&boid.position.x, &boid.velocity.x);
+        }
+    }
+
+    const double virtualMs = MeasureUpdateMs(virtualDispatch);
+    const double tagMs = MeasureUpdateMs(tagDispatch);
+    const double partitionedMs = MeasureUpdateMs(partitioned);
+
+    std::printf("%16s %16s %8s\n", "dispatch", "ms", "speedup");
+    std::printf("%16s %16.3f %7.1fx\n", "virtual", virtualMs, 1.0);
+    std::printf("%16s %16.3f %7.1fx\n", "type tag", tagMs, virtualMs / tagMs);
+    std::printf("%16s %16.3f %7.1fx\n", "partitioned", partitionedMs, virtualMs / partitionedMs);
+}
+
+TEST( FlockingBenchmark, DISABLED_ObstacleBackends )
+{
+    constexpr int BOIDS_COUNT = 4000;
+
+    std::printf("%16s %16s %8s\n", "backend", "ms", "speedup");
+    double physicsMs = 0.0;
+    constexpr const char* NAMES[] = {"static index", "distance field", "physics"};
+    for(const OBSTACLE_BACKEND backend : {OBSTACLE_BACKEND::PHYSICS, OBSTACLE_BACKEND::STATIC_INDEX, OBSTACLE_BACKEND::DISTANCE_FIELD}) {
+        FlockingSimulation simulation;
+        simulation.SetStorageMode(STORAGE_MODE::SOA);
+        simulation.SetObstacleBackend(backend);
+        simulation.SetObstacleFieldCellSize(DefaultSimulationParams::OBSTACLE_FIELD_CELL_SIZE, false);
+
+        // Same 5x5 skyscraper layout as data/city/city.json
+        for(int x = -2; x <= 2; ++x) {
+            for(int z = -2; z <= 2; ++z) {
+                const float center[] = {x * 8.f, 5.f, z * 8.f};
+                const float extents[] = {1.5f, 5.f, 1.5f};
+                simulation.AddObstacle(center, extents);
+            }
+        }
+        simulation.Spawn<PreyBehavior>(BOIDS_COUNT);
+
+        const double ms = MeasureUpdateMs(simulation);
+        if(backend == OBSTACLE_BACKEND::PHYSICS) {
+            physicsMs = ms;
+        }
+
+        std::printf("%16s %16.3f %7.1fx\n", NAMES[static_cast<int>(backend)], ms, physicsMs / ms);
+    }
+}
+
+TEST( FlockingBenchmark, DISABLED_ObstacleFieldResolution )
+{
+    constexpr float CELL_SIZES[] = {1.f, 0.5f, 0.25f, 0.125f};
+
+    std::printf("%10s %12s %16s\n", "cell size", "memory KiB", "build ms");
+    for(const float cellSize : CELL_SIZES) {
+        FlockingSimulation simulation;
+        simulation.SetObstacleBackend(OBSTACLE_BACKEND::DISTANCE_FIELD);
+        simulation.SetObstacleFieldCellSize(cellSize, false);
+
+        for(int x = -2; x <= 2; ++x) {
+            for(int z = -2; z <= 2; ++z) {
+                const float center[] = {x * 8.f, 5.f, z * 8.f};
+                const float extents[] = {1.5f, 5.f, 1.5f};
+                simulation.AddObstacle(center, extents);
+            }
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        simulation.OnUpdate(DELTA_TIME);
+        const auto end = std::chrono::steady_clock::now();
+
+        const double buildMs = std::chrono::duration<double, std::milli>(end - start).count();
+        std::printf("%10.3f %12zu %16.3f\n", cellSize, simulation.GetObstacleField().GetMemoryUsage() / 1024, buildMs);
+    }
+}
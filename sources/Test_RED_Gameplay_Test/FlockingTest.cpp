@@ -5,6 +5,7 @@
 
 #include <Boid.h>
 #include <FlockingSimulation.h>
+#include <SimulationThread.h>
 
 using reactphysics3d::CollisionBody;
 using reactphysics3d::Vector3;
@@ -39,7 +40,7 @@ public:
     template<typename T>
     const Boid& AddBoid(Vector3 position, Vector3 velocity)
     {
-        return flockingSimulation.Spawn<T>(&position.x, &velocity.x);
+        return *flockingSimulation.Resolve(flockingSimulation.Spawn<T>(&position.x, &velocity.x));
     }
 
     vector<Boid>& boids;
@@ -98,7 +99,7 @@ TEST_F( FlockingTest , CheckAlignment )
     AddBoid<Behavior>(position_0, velocity_0);
     AddBoid<Behavior>(position_1, velocity_1);
 
-    vector<const Boid*> neighbours = boids[0].behavior->GetNeighbours(boids[0], boids);
+    BoidList neighbours = boids[0].behavior->GetNeighbours(boids[0], boids);
     
     Vector3 alignment = boids[0].behavior->GetAlignment(boids[0], neighbours);
     ASSERT_EQ(alignment, velocity_1.getUnit());
@@ -132,7 +133,7 @@ TEST_F( FlockingTest, CheckCohesion )
     AddBoid<Behavior>(position_0, velocity_0);
     AddBoid<Behavior>(position_1, velocity_1);
 
-    vector<const Boid*> neighbours = boids[0].behavior->GetNeighbours(boids[0], boids);
+    BoidList neighbours = boids[0].behavior->GetNeighbours(boids[0], boids);
 
     Vector3 cohesion = boids[0].behavior->GetCohesion(boids[0], neighbours);
     ASSERT_EQ(cohesion, (position_1 - position_0).getUnit());
@@ -178,9 +179,9 @@ TEST_F( FlockingTest, CheckCohesionCentered )
     AddBoid<Behavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
 
     Boid& boid = flockingSimulation.boids[CHECK_ID];
-    boid.behavior->viewAngle = 360.f;
+    flockingSimulation.GetBehavior<Behavior>().viewAngle = 360.f;
 
-    vector<const Boid*> neigbours = boid.behavior->GetNeighbours(boid, boids);
+    BoidList neigbours = boid.behavior->GetNeighbours(boid, boids);
     const Vector3 cohesion = boid.behavior->GetCohesion(boid, neigbours);
     ASSERT_EQ(cohesion, Vector3::zero());
     ASSERT_EQ(cohesion.length(), 0.f);
@@ -198,7 +199,7 @@ TEST_F( FlockingTest, CheckSeparation )
     AddBoid<Behavior>(position_0, velocity_0);
     AddBoid<Behavior>(position_1, velocity_1);
 
-    vector<const Boid*> neighbours = boids[0].behavior->GetNeighbours(boids[0], boids);
+    BoidList neighbours = boids[0].behavior->GetNeighbours(boids[0], boids);
     Vector3 separation = boids[0].behavior->GetSeparation(boids[0], neighbours);
     ASSERT_EQ(separation, (position_0 - position_1).getUnit());
     ASSERT_EQ(separation.length(), 1.f);
@@ -253,7 +254,7 @@ TEST_F( FlockingTest, CheckNeighbours )
     flockingSimulation.Spawn<Behavior>(100);
 
     const Boid& boid = boids[33];
-    const vector<const Boid*> neighbours = boid.behavior->GetNeighbours(boid, boids);
+    const BoidList neighbours = boid.behavior->GetNeighbours(boid, boids);
 
     for(const Boid* other : neighbours) {
         ASSERT_TRUE(GetDistanceBetween(other->position, boid.position) <= DefaultBehaviorParams::VIEW_DISTANCE);
@@ -263,6 +264,322 @@ TEST_F( FlockingTest, CheckNeighbours )
     flockingSimulation.ClearAll();
 }
 
+TEST_F( FlockingTest, NeighbourBackendsMatchBruteForce )
+{
+    constexpr int FRAMES = 3;
+    constexpr NEIGHBOUR_BACKEND BACKENDS[] = {NEIGHBOUR_BACKEND::GRID, NEIGHBOUR_BACKEND::KD_TREE, NEIGHBOUR_BACKEND::MORTON_SWEEP};
+
+    const auto sorted = [](BoidList list)
+    {
+        std::sort(list.begin(), list.end());
+        return vector<const Boid*>(list.begin(), list.end());
+    };
+
+    const auto gather = [this](int id)
+    {
+        ArenaScope scope;
+        NeighbourBuffer neighbours;
+        flockingSimulation.GatherNeighbours(id, *boids[id].behavior, neighbours);
+
+        vector<int> ids(neighbours.id.begin(), neighbours.id.end());
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    for(NEIGHBOUR_BACKEND backend : BACKENDS) {
+        flockingSimulation.SetNeighbourBackend(backend);
+        flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+
+        // A sparse flock over the whole bounds, a dense swarm and a few strays outside the bounds
+        flockingSimulation.Spawn<PreyBehavior>(300);
+        flockingSimulation.Spawn<HunterBehavior>(30);
+        for(int i = 0; i < 300; ++i) {
+            AddBoid<Behavior>({3.f + std::fmod(i * 0.618f, 1.5f), 4.f + std::fmod(i * 0.414f, 1.5f), -2.f + std::fmod(i * 0.732f, 1.5f)}, {1.f, 0.f, 0.f});
+        }
+        for(int i = 0; i < 10; ++i) {
+            AddBoid<Behavior>({25.f, -1.f - i * 0.3f, 0.f}, {0.f, 1.f, 0.f});
+        }
+
+        for(int frame = 0; frame < FRAMES; ++frame) {
+            flockingSimulation.PrepareNeighbourSearch(nullptr, 0.f);
+            for(int id = 0; id < boids.size(); ++id) {
+                const vector<int> indexed = gather(id);
+
+                flockingSimulation.useSpatialGrid = false;
+                const vector<int> bruteForce = gather(id);
+                flockingSimulation.useSpatialGrid = true;
+
+                ASSERT_EQ(indexed, bruteForce) << static_cast<int>(backend) << " " << id;
+            }
+
+            vector<vector<const Boid*>> expected;
+            flockingSimulation.neighbourIndex->Invalidate();
+            for(const Boid& boid : boids) {
+                expected.push_back(sorted(boid.behavior->GetNeighbours(boid, boids)));
+            }
+
+            flockingSimulation.BuildNeighbourIndexAoS();
+            for(int id = 0; id < boids.size(); ++id) {
+                ASSERT_EQ(sorted(boids[id].behavior->GetNeighbours(boids[id], boids)), expected[id]) << static_cast<int>(backend) << " " << id;
+            }
+
+            // Later frames run on moved boids, the k-d tree refits instead of splitting again
+            flockingSimulation.neighbourIndex->Invalidate();
+            flockingSimulation.OnUpdate(1.f / 60.f);
+        }
+
+        flockingSimulation.ClearAll();
+        flockingSimulation.SetStorageMode(STORAGE_MODE::AOS);
+    }
+}
+
+TEST_F( FlockingTest, InPlaceUpdateFindsMovedNeighbours )
+{
+    // Long enough for boids to cross cells while the others still gather
+    constexpr float DELTA_TIME = 0.25f;
+    constexpr NEIGHBOUR_BACKEND BACKENDS[] = {NEIGHBOUR_BACKEND::GRID, NEIGHBOUR_BACKEND::KD_TREE, NEIGHBOUR_BACKEND::MORTON_SWEEP};
+
+    const auto sorted = [](const BoidList& list)
+    {
+        vector<const Boid*> boids(list.begin(), list.end());
+        std::sort(boids.begin(), boids.end());
+        return boids;
+    };
+
+    for(NEIGHBOUR_BACKEND backend : BACKENDS) {
+        flockingSimulation.SetNeighbourBackend(backend);
+        flockingSimulation.Spawn<PreyBehavior>(300);
+        flockingSimulation.Spawn<HunterBehavior>(30);
+        for(int i = 0; i < 300; ++i) {
+            AddBoid<Behavior>({3.f + std::fmod(i * 0.618f, 3.f), 4.f + std::fmod(i * 0.414f, 3.f), -2.f + std::fmod(i * 0.732f, 3.f)}, {1.f, 0.f, 0.f});
+        }
+
+        // As UpdateAoS does, the index is built once and every boid moves right after its gather
+        flockingSimulation.BuildNeighbourIndexAoS(flockingSimulation.GetLargestStep(DELTA_TIME));
+        for(int id = 0; id < boids.size(); ++id) {
+            Boid& boid = boids[id];
+            ArenaScope scope;
+            const vector<const Boid*> indexed = sorted(boid.behavior->GetNeighbours(boid, boids));
+
+            boid.neighbourIndex = nullptr;
+            const vector<const Boid*> bruteForce = sorted(boid.behavior->GetNeighbours(boid, boids));
+            boid.neighbourIndex = flockingSimulation.neighbourIndex.get();
+
+            ASSERT_EQ(indexed, bruteForce) << static_cast<int>(backend) << " " << id;
+            boid.Update(DELTA_TIME, boids);
+        }
+
+        flockingSimulation.ClearAll();
+    }
+}
+
+TEST_F( FlockingTest, InPlaceSoAUpdateFindsMovedNeighbours )
+{
+    constexpr float DELTA_TIME = 0.25f;
+    constexpr NEIGHBOUR_BACKEND BACKENDS[] = {NEIGHBOUR_BACKEND::GRID, NEIGHBOUR_BACKEND::KD_TREE, NEIGHBOUR_BACKEND::MORTON_SWEEP};
+
+    const auto gather = [this](int id)
+    {
+        ArenaScope scope;
+        NeighbourBuffer neighbours;
+        flockingSimulation.GatherNeighbours(id, *boids[id].behavior, neighbours);
+
+        vector<int> ids(neighbours.id.begin(), neighbours.id.end());
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    for(NEIGHBOUR_BACKEND backend : BACKENDS) {
+        flockingSimulation.SetNeighbourBackend(backend);
+        flockingSimulation.Spawn<PreyBehavior>(300);
+        flockingSimulation.Spawn<HunterBehavior>(30);
+        for(int i = 0; i < 300; ++i) {
+            AddBoid<Behavior>({3.f + std::fmod(i * 0.618f, 3.f), 4.f + std::fmod(i * 0.414f, 3.f), -2.f + std::fmod(i * 0.732f, 3.f)}, {1.f, 0.f, 0.f});
+        }
+
+        // As UpdateSoA does, the storage takes every new position right after the boid's gather
+        flockingSimulation.PrepareNeighbourSearch(nullptr, flockingSimulation.GetLargestStep(DELTA_TIME));
+        for(int id = 0; id < boids.size(); ++id) {
+            const vector<int> indexed = gather(id);
+
+            flockingSimulation.useSpatialGrid = false;
+            const vector<int> bruteForce = gather(id);
+            flockingSimulation.useSpatialGrid = true;
+
+            ASSERT_EQ(indexed, bruteForce) << static_cast<int>(backend) << " " << id;
+
+            ArenaScope scope;
+            NeighbourScratch scratch;
+            flockingSimulation.UpdateBoidAt(id, scratch, DELTA_TIME);
+            flockingSimulation.storage.Store(id, boids[id]);
+        }
+
+        flockingSimulation.ClearAll();
+    }
+    flockingSimulation.SetStorageMode(STORAGE_MODE::AOS);
+}
+
+TEST_F( FlockingTest, TopologicalNeighbours )
+{
+    constexpr int NEAREST = 7;
+
+    // Collapsed flock, every boid sees far more than NEAREST others
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    flockingSimulation.GetBehavior<PreyBehavior>().maxNeighbours = NEAREST;
+    for(int i = 0; i < 200; ++i) {
+        AddBoid<PreyBehavior>({std::fmod(i * 0.618f, 1.f), std::fmod(i * 0.414f, 1.f), std::fmod(i * 0.732f, 1.f)}, {1.f, 0.f, 0.f});
+    }
+    // Equally far from boid 0, the lower id wins the last place
+    AddBoid<PreyBehavior>({-0.01f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+
+    const Behavior& behavior = flockingSimulation.GetBehavior<PreyBehavior>();
+    vector<vector<int>> expected;
+    for(const Boid& boid : boids) {
+        vector<std::pair<float, int>> visible;
+        for(int other = 0; other < boids.size(); ++other) {
+            if(behavior.IsNeighbour(boid, boids[other])) {
+                visible.push_back({GetDistanceBetweenSquare(boid.position, boids[other].position), other});
+            }
+        }
+        std::sort(visible.begin(), visible.end());
+        visible.resize(std::min<size_t>(visible.size(), NEAREST));
+
+        vector<int> nearest;
+        for(const auto& entry : visible) {
+            nearest.push_back(entry.second);
+        }
+        std::sort(nearest.begin(), nearest.end());
+        expected.push_back(nearest);
+    }
+
+    // Brute force, then every index with its own nearest first search
+    for(bool useIndex : {false, true}) {
+        for(NEIGHBOUR_BACKEND backend : {NEIGHBOUR_BACKEND::GRID, NEIGHBOUR_BACKEND::KD_TREE, NEIGHBOUR_BACKEND::MORTON_SWEEP}) {
+            flockingSimulation.useSpatialGrid = useIndex;
+            flockingSimulation.SetNeighbourBackend(backend);
+            flockingSimulation.PrepareNeighbourSearch(nullptr, 0.f);
+            if(useIndex) {
+                flockingSimulation.BuildNeighbourIndexAoS();
+            }
+
+            for(int id = 0; id < boids.size(); ++id) {
+                ArenaScope scope;
+                vector<int> aos;
+                for(const Boid* other : behavior.GetNeighbours(boids[id], boids)) {
+                    aos.push_back(static_cast<int>(other - boids.data()));
+                }
+                ASSERT_EQ(aos, expected[id]) << static_cast<int>(backend) << " " << id;
+
+                NeighbourBuffer neighbours;
+                flockingSimulation.GatherNeighbours(id, behavior, neighbours);
+                ASSERT_EQ(vector<int>(neighbours.id.begin(), neighbours.id.end()), expected[id]) << static_cast<int>(backend) << " " << id;
+            }
+        }
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, CellAggregatesCountEveryNeighbour )
+{
+    constexpr int COUNT = 2000;
+
+    // Seeing all around and nothing out of reach, every cell lies entirely in view and the sums stand for exactly the boids left out
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    flockingSimulation.SetSteeringMode(STEERING_MODE::CELL_AGGREGATES);
+    PreyBehavior& behavior = flockingSimulation.GetBehavior<PreyBehavior>();
+    behavior.viewAngle = 180.f;
+    for(int i = 0; i < COUNT; ++i) {
+        AddBoid<PreyBehavior>({std::fmod(i * 0.618f, 0.8f), std::fmod(i * 0.414f, 0.8f), std::fmod(i * 0.732f, 0.8f)}, {1.f, 0.f, 0.f});
+    }
+
+    flockingSimulation.PrepareNeighbourSearch(nullptr, 0.f);
+    int aggregated = 0;
+    for(int id = 0; id < COUNT; ++id) {
+        ArenaScope scope;
+        NeighbourScratch exact;
+        NeighbourScratch approximate;
+        flockingSimulation.GatherNeighbours(id, behavior, exact.neighbours);
+        flockingSimulation.GatherNeighbours(id, behavior, approximate);
+
+        const CellSums& far = approximate.far[static_cast<int>(BEHAVIOR_TYPE::PREY)];
+        ASSERT_EQ(approximate.neighbours.Size() + far.count, exact.neighbours.Size()) << id;
+        aggregated += far.count;
+
+        const RVector3 exactAlignment = behavior.GetAlignment(exact.neighbours);
+        const RVector3 approximateAlignment = behavior.GetAlignment(approximate.neighbours, &far);
+        ASSERT_NEAR((exactAlignment - approximateAlignment).length(), 0.f, 1e-3f) << id;
+
+        const RVector3 position = flockingSimulation.storage.GetPosition(id);
+        const RVector3 exactCohesion = behavior.GetCohesion(position, exact.neighbours);
+        const RVector3 approximateCohesion = behavior.GetCohesion(position, approximate.neighbours, &far);
+        ASSERT_NEAR((exactCohesion - approximateCohesion).length(), 0.f, 1e-3f) << id;
+    }
+    ASSERT_GT(aggregated, 0);
+
+    const ApproximationError error = flockingSimulation.MeasureApproximationError(100);
+    ASSERT_EQ(error.samples, 100);
+    ASSERT_LT(error.alignmentDegrees, 0.1f);
+    ASSERT_LT(error.cohesionDegrees, 0.1f);
+
+    flockingSimulation.SetUpdateMode(UPDATE_MODE::PARALLEL);
+    flockingSimulation.OnUpdate(1.f / 60.f);
+    flockingSimulation.SetUpdateMode(UPDATE_MODE::SEQUENTIAL);
+    flockingSimulation.OnUpdate(1.f / 60.f);
+    for(const Boid& boid : flockingSimulation.GetBoids()) {
+        ASSERT_FALSE(std::isnan(boid.position.x) || std::isnan(boid.velocity.x));
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, FlockAttraction )
+{
+    constexpr float DT = 1.f / 60.f;
+    constexpr float ERROR = 0.001f;
+
+    // Two flocks far beyond each other's view
+    flockingSimulation.GetBehavior<PreyBehavior>().flockAttractionWeight = 1.f;
+    for(int i = 0; i < 5; ++i) {
+        AddBoid<PreyBehavior>({-8.f, 10.f + i * 0.3f, 0.f}, {0.f, 0.f, 1.f});
+        AddBoid<PreyBehavior>({8.f, 10.f + i * 0.3f, 0.f}, {0.f, 0.f, 1.f});
+    }
+    flockingSimulation.PrepareFlockOctree();
+
+    const PreyBehavior& behavior = flockingSimulation.GetBehavior<PreyBehavior>();
+    ASSERT_GT(behavior.GetFlockAttraction(boids[0]).dot({1.f, 0.f, 0.f}), 0.99f);
+    ASSERT_GT(behavior.GetFlockAttraction(boids[1]).dot({-1.f, 0.f, 0.f}), 0.99f);
+
+    FlockingSimulation soaSimulation;
+    soaSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    soaSimulation.GetBehavior<PreyBehavior>().flockAttractionWeight = 1.f;
+    for(const Boid& boid : boids) {
+        soaSimulation.Spawn<PreyBehavior>(&boid.position.x, &boid.velocity.x);
+    }
+
+    for(int frame = 0; frame < 5; ++frame) {
+        flockingSimulation.OnUpdate(DT);
+        soaSimulation.OnUpdate(DT);
+    }
+
+    const vector<Boid>& soaBoids = soaSimulation.GetBoids();
+    for(int i = 0; i < boids.size(); ++i) {
+        ASSERT_NEAR((soaBoids[i].position - boids[i].position).length(), 0.f, ERROR) << i;
+    }
+    ASSERT_GT(boids[0].velocity.x, 0.f);
+    ASSERT_LT(boids[1].velocity.x, 0.f);
+
+    // Nothing is built, nor felt, without the weight
+    flockingSimulation.GetBehavior<PreyBehavior>().flockAttractionWeight = 0.f;
+    flockingSimulation.OnUpdate(DT);
+    ASSERT_TRUE(flockingSimulation.flockOctree.IsEmpty());
+    ASSERT_EQ(behavior.GetFlockAttraction(boids[0]), RVector3{});
+
+    flockingSimulation.ClearAll();
+    soaSimulation.ClearAll();
+}
+
 TEST_F( FlockingTest, CheckUpdate)
 {
     AddBoid<Behavior>({DefaultBehaviorParams::MIN_BOID_DISTANCE, 0.f, 0.f}, {1.f, 0.f, 0.f});
@@ -276,7 +593,7 @@ TEST_F( FlockingTest, CheckUpdate)
     AddBoid<Behavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
 
     const Boid& boid = boids[CHECK_ID];
-    vector<const Boid*> neighbours = boid.behavior->GetNeighbours(boids[CHECK_ID], boids);
+    BoidList neighbours = boid.behavior->GetNeighbours(boids[CHECK_ID], boids);
 
     const Vector3 alignment = boid.behavior->GetAlignment(boids[CHECK_ID], neighbours) * DefaultBehaviorParams::ALIGNMENT_WEIGHT;
     const Vector3 cohesion = boid.behavior->GetCohesion(boids[CHECK_ID], neighbours) * DefaultBehaviorParams::COHESION_WEIGHT;
@@ -306,14 +623,14 @@ TEST_F( FlockingTest, CheckUpdate)
 TEST_F( FlockingTest, CheckTypes )
 {
     const Boid& boid_0 = AddBoid<Behavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
-    ASSERT_EQ(dynamic_cast<HunterBehavior*>(boid_0.behavior.get()), nullptr);
-    ASSERT_EQ(dynamic_cast<PreyBehavior*>(boid_0.behavior.get()), nullptr);
+    ASSERT_EQ(dynamic_cast<const HunterBehavior*>(boid_0.behavior), nullptr);
+    ASSERT_EQ(dynamic_cast<const PreyBehavior*>(boid_0.behavior), nullptr);
 
     const Boid& boid_1 = AddBoid<PreyBehavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
-    ASSERT_NE(dynamic_cast<PreyBehavior*>(boid_1.behavior.get()), nullptr);
+    ASSERT_NE(dynamic_cast<const PreyBehavior*>(boid_1.behavior), nullptr);
 
     const Boid& boid_2 = AddBoid<HunterBehavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
-    ASSERT_NE(dynamic_cast<HunterBehavior*>(boid_2.behavior.get()), nullptr);
+    ASSERT_NE(dynamic_cast<const HunterBehavior*>(boid_2.behavior), nullptr);
 
     flockingSimulation.ClearAll();
 }
@@ -325,8 +642,8 @@ TEST_F( FlockingTest, CheckEscape )
     AddBoid<PreyBehavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
     AddBoid<HunterBehavior>({0.f, DefaultBehaviorParams::MIN_BOID_DISTANCE, 0.f}, {1.f, 0.f, 0.f});
 
-    PreyBehavior* behavior = dynamic_cast<PreyBehavior*>(boids[0].behavior.get());
-    vector<const Boid*> neighbours = boids[0].behavior->GetNeighbours(boids[0], flockingSimulation.boids);
+    const PreyBehavior* behavior = dynamic_cast<const PreyBehavior*>(boids[0].behavior);
+    BoidList neighbours = boids[0].behavior->GetNeighbours(boids[0], flockingSimulation.boids);
 
     RVector3 assumedEscape = RVector3{0.f, -1.f, 0.f};
     const RVector3 escape = behavior->GetEscape(boids[0], neighbours);
@@ -342,10 +659,10 @@ TEST_F( FlockingTest, CheckHunting )
     AddBoid<HunterBehavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
     AddBoid<PreyBehavior>({0.f, DefaultPreyBehaviorParams::MIN_BOID_DISTANCE, 0.f}, {1.f, 0.f, 0.f});
     
-    vector<const Boid*> neighbours = boids[0].behavior->GetNeighbours(boids[0], flockingSimulation.boids);
+    BoidList neighbours = boids[0].behavior->GetNeighbours(boids[0], flockingSimulation.boids);
 
     RVector3 assumedHunting = (RVector3{0.f, 1.f, 0.f} + boids[0].velocity * DefaultHunterBehaviorParams::PREY_VELOCITY_WEIGHT).getUnit();
-    const RVector3 hunting = dynamic_cast<HunterBehavior*>(boids[0].behavior.get())->GetHunting(boids[0], neighbours);
+    const RVector3 hunting = dynamic_cast<const HunterBehavior*>(boids[0].behavior)->GetHunting(boids[0], neighbours);
     ASSERT_EQ(hunting, assumedHunting);
 
     flockingSimulation.ClearAll();
@@ -354,18 +671,96 @@ TEST_F( FlockingTest, CheckHunting )
 TEST_F( FlockingTest, Conversion )
 {
     AddBoid<HunterBehavior>({0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
-    ASSERT_NE(dynamic_cast<HunterBehavior*>(boids[0].behavior.get()), nullptr);
+    ASSERT_NE(dynamic_cast<const HunterBehavior*>(boids[0].behavior), nullptr);
 
-    HunterBehavior* behavior = dynamic_cast<HunterBehavior*>(boids[0].behavior.get());
-    behavior->targetsEaten = behavior->maxTargetEaten;
+    const HunterBehavior* behavior = dynamic_cast<const HunterBehavior*>(boids[0].behavior);
+    boids[0].hunter.targetsEaten = behavior->maxTargetEaten;
 
     flockingSimulation.OnUpdate(1.f);
 
-    ASSERT_NE(dynamic_cast<PreyBehavior*>(boids[0].behavior.get()), nullptr);
+    ASSERT_NE(dynamic_cast<const PreyBehavior*>(boids[0].behavior), nullptr);
 
     flockingSimulation.ClearAll();
 }
 
+TEST_F( FlockingTest, UnwiredHunterStaysHunter )
+{
+    static_assert(!std::is_copy_constructible_v<FlockingSimulation> && !std::is_move_constructible_v<FlockingSimulation>, "boids point into their simulation");
+
+    HunterBehavior unwired;
+    Boid boid = GetBoid({0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+    boid.behavior = &unwired;
+    boid.hunter.targetsEaten = unwired.maxTargetEaten;
+
+    ASSERT_FALSE(unwired.TryConvert(boid));
+    ASSERT_EQ(boid.behavior, &unwired);
+}
+
+TEST_F( FlockingTest, SharedBehaviors )
+{
+    flockingSimulation.Spawn<PreyBehavior>(2);
+    flockingSimulation.Spawn<HunterBehavior>(2);
+
+    ASSERT_EQ(boids[0].behavior, &flockingSimulation.GetBehavior<PreyBehavior>());
+    ASSERT_EQ(boids[1].behavior, boids[0].behavior);
+    ASSERT_EQ(boids[2].behavior, &flockingSimulation.GetBehavior<HunterBehavior>());
+    ASSERT_EQ(boids[3].behavior, boids[2].behavior);
+
+    // Tuning a type reaches every boid of it, per-boid state stays apart
+    flockingSimulation.GetBehavior<HunterBehavior>().eatEnergy = 1.f;
+    boids[2].hunter.energy = 0.f;
+    ASSERT_EQ(static_cast<const HunterBehavior*>(boids[3].behavior)->eatEnergy, 1.f);
+    ASSERT_EQ(boids[3].hunter.energy, DefaultHunterBehaviorParams::ENERGY);
+
+    boids[2].hunter.targetsEaten = DefaultHunterBehaviorParams::MAX_TARGETS_EATEN;
+    flockingSimulation.OnUpdate(0.01f);
+    ASSERT_EQ(boids[2].behavior, &flockingSimulation.GetBehavior<PreyBehavior>());
+    ASSERT_EQ(boids[3].behavior, &flockingSimulation.GetBehavior<HunterBehavior>());
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, Handles )
+{
+    const RVector3 position = {0.f, 0.f, 0.f};
+    const RVector3 velocity = {0.f, 1.f, 0.f};
+
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    flockingSimulation.Spawn<PreyBehavior>(3);
+    const BoidHandle hunter = flockingSimulation.Spawn<HunterBehavior>(&position.x, &velocity.x);
+    const BoidHandle prey = flockingSimulation.Spawn<PreyBehavior>(&position.x, &velocity.x);
+    const BoidHandle last = flockingSimulation.GetHandle(4);
+    ASSERT_EQ(last, prey);
+    ASSERT_EQ(flockingSimulation.Resolve(hunter), &boids[3]);
+
+    // The prey spawned on the hunter is eaten and another one dies, the hunter is swapped into a freed id
+    boids[1].status = STATUS::DEAD;
+    flockingSimulation.storage.status[1] = STATUS::DEAD;
+    flockingSimulation.OnUpdate(0.000001f);
+
+    ASSERT_EQ(boids.size(), 3);
+    ASSERT_FALSE(flockingSimulation.IsAlive(prey));
+    ASSERT_EQ(flockingSimulation.Resolve(prey), nullptr);
+    ASSERT_EQ(flockingSimulation.GetPositionOf(prey), nullptr);
+
+    ASSERT_TRUE(flockingSimulation.IsAlive(hunter));
+    const Boid* hunterBoid = flockingSimulation.Resolve(hunter);
+    ASSERT_NE(hunterBoid, nullptr);
+    ASSERT_EQ(hunterBoid->behavior->GetType(), BEHAVIOR_TYPE::HUNTER);
+    ASSERT_EQ(flockingSimulation.GetPositionOf(hunter), &hunterBoid->position.x);
+    ASSERT_EQ(flockingSimulation.GetHandle(static_cast<int>(hunterBoid - boids.data())), hunter);
+
+    // A reused slot does not bring the old handle back
+    const BoidHandle reused = flockingSimulation.Spawn<PreyBehavior>(&position.x, &velocity.x);
+    ASSERT_NE(reused, prey);
+    ASSERT_FALSE(flockingSimulation.IsAlive(prey));
+    ASSERT_TRUE(flockingSimulation.IsAlive(reused));
+
+    flockingSimulation.ClearAll();
+    ASSERT_FALSE(flockingSimulation.IsAlive(hunter));
+    ASSERT_FALSE(flockingSimulation.IsAlive(BoidHandle{}));
+}
+
 TEST_F( FlockingTest, HunterAcceleration )
 {
     RVector3 velocity = {0.f, 1.f, 0.f};
@@ -375,10 +770,10 @@ TEST_F( FlockingTest, HunterAcceleration )
         (flockingSimulation.maxPoint.z + flockingSimulation.minPoint.z) / 2
     };
     const Boid& boid = AddBoid<HunterBehavior>(position, velocity);
-    const HunterBehavior* behavior = dynamic_cast<HunterBehavior*>(boid.behavior.get());
+    const HunterBehavior* behavior = dynamic_cast<const HunterBehavior*>(boid.behavior);
 
     constexpr float DT = 0.1f;
-    const float initialSpeed = behavior->speed;
+    const float initialSpeed = boid.hunter.speed;
     const float acceleration = (behavior->acceleration * DT);
 
     ASSERT_EQ(boid.velocity, velocity);
@@ -405,5 +800,679 @@ TEST_F( FlockingTest, Death )
     flockingSimulation.OnUpdate(0.000001f);
 
     ASSERT_EQ(boids.size(), 1);
-    ASSERT_NE(dynamic_cast<HunterBehavior*>(boids[0].behavior.get()), nullptr);
-}
\ No newline at end of file
+    ASSERT_NE(dynamic_cast<const HunterBehavior*>(boids[0].behavior), nullptr);
+}
+
+// Storage modes
+
+TEST_F( FlockingTest, SoAStorageAligned )
+{
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    flockingSimulation.Spawn<PreyBehavior>(100);
+
+    const BoidStorage& storage = flockingSimulation.storage;
+    ASSERT_EQ(storage.Size(), boids.size());
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(storage.px.data()) % 32, 0);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(storage.vz.data()) % 32, 0);
+
+    flockingSimulation.OnUpdate(0.1f);
+
+    for(int i = 0; i < boids.size(); ++i) {
+        const float* position = flockingSimulation.GetPositionOf(i);
+        ASSERT_EQ(position[0], storage.px[i]);
+        ASSERT_EQ(position[1], storage.py[i]);
+        ASSERT_EQ(position[2], storage.pz[i]);
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, SoAMatchesAoS )
+{
+    constexpr int FRAMES = 5;
+    constexpr float DT = 1.f / 60.f;
+    constexpr float ERROR = 0.001f;
+
+    flockingSimulation.Spawn<PreyBehavior>(300);
+    flockingSimulation.Spawn<HunterBehavior>(30);
+
+    FlockingSimulation soaSimulation;
+    soaSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    for(const Boid& boid : boids) {
+        if(boid.behavior->GetType() == BEHAVIOR_TYPE::HUNTER) {
+            soaSimulation.Spawn<HunterBehavior>(&boid.position.x, &boid.velocity.x);
+        } else {
+            soaSimulation.Spawn<PreyBehavior>(&boid.position.x, &boid.velocity.x);
+        }
+    }
+
+    for(int frame = 0; frame < FRAMES; ++frame) {
+        flockingSimulation.OnUpdate(DT);
+        soaSimulation.OnUpdate(DT);
+    }
+
+    const vector<Boid>& soaBoids = soaSimulation.GetBoids();
+    ASSERT_EQ(soaBoids.size(), boids.size());
+    for(int i = 0; i < boids.size(); ++i) {
+        ASSERT_NEAR((soaBoids[i].position - boids[i].position).length(), 0.f, ERROR) << i;
+        ASSERT_NEAR((soaBoids[i].velocity - boids[i].velocity).length(), 0.f, ERROR) << i;
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, SoADeath )
+{
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    AddBoid<HunterBehavior>({0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+    AddBoid<PreyBehavior>({0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+
+    flockingSimulation.OnUpdate(0.000001f);
+
+    ASSERT_EQ(boids.size(), 1);
+    ASSERT_EQ(flockingSimulation.storage.Size(), 1);
+    ASSERT_EQ(flockingSimulation.storage.type[0], BEHAVIOR_TYPE::HUNTER);
+    ASSERT_NE(dynamic_cast<const HunterBehavior*>(boids[0].behavior), nullptr);
+}
+
+// Parallel update
+
+TEST_F( FlockingTest, ParallelIndependentOfWorkerCount )
+{
+    constexpr int FRAMES = 10;
+    constexpr float DT = 1.f / 60.f;
+
+    flockingSimulation.SetUpdateMode(UPDATE_MODE::PARALLEL);
+    flockingSimulation.SetWorkerCount(1);
+    flockingSimulation.Spawn<PreyBehavior>(500);
+    flockingSimulation.Spawn<HunterBehavior>(50);
+
+    FlockingSimulation parallelSimulation;
+    parallelSimulation.SetUpdateMode(UPDATE_MODE::PARALLEL);
+    parallelSimulation.SetWorkerCount(4);
+    for(const Boid& boid : boids) {
+        if(boid.behavior->GetType() == BEHAVIOR_TYPE::HUNTER) {
+            parallelSimulation.Spawn<HunterBehavior>(&boid.position.x, &boid.velocity.x);
+        } else {
+            parallelSimulation.Spawn<PreyBehavior>(&boid.position.x, &boid.velocity.x);
+        }
+    }
+
+    for(int frame = 0; frame < FRAMES; ++frame) {
+        flockingSimulation.OnUpdate(DT);
+        parallelSimulation.OnUpdate(DT);
+    }
+
+    ASSERT_EQ(parallelSimulation.GetWorkerCount(), 4);
+    const vector<Boid>& parallelBoids = parallelSimulation.GetBoids();
+    ASSERT_EQ(parallelBoids.size(), boids.size());
+    for(int i = 0; i < boids.size(); ++i) {
+        ASSERT_EQ(parallelBoids[i], boids[i]) << i;
+        ASSERT_EQ(parallelBoids[i].behavior->GetType(), boids[i].behavior->GetType()) << i;
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, ParallelDeath )
+{
+    flockingSimulation.SetUpdateMode(UPDATE_MODE::PARALLEL);
+    flockingSimulation.SetWorkerCount(2);
+    AddBoid<HunterBehavior>({0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+    AddBoid<PreyBehavior>({0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+
+    flockingSimulation.OnUpdate(0.000001f);
+
+    ASSERT_EQ(boids.size(), 1);
+    ASSERT_NE(dynamic_cast<const HunterBehavior*>(boids[0].behavior), nullptr);
+    ASSERT_EQ(boids[0].hunter.targetsEaten, 1);
+}
+
+TEST_F( FlockingTest, ParallelConversion )
+{
+    flockingSimulation.SetUpdateMode(UPDATE_MODE::PARALLEL);
+    AddBoid<HunterBehavior>({0.f, 0.f, 0.f}, {0.f, 1.f, 0.f});
+
+    const HunterBehavior* behavior = dynamic_cast<const HunterBehavior*>(boids[0].behavior);
+    boids[0].hunter.targetsEaten = behavior->maxTargetEaten;
+
+    flockingSimulation.OnUpdate(1.f);
+
+    ASSERT_NE(dynamic_cast<const PreyBehavior*>(boids[0].behavior), nullptr);
+    ASSERT_EQ(flockingSimulation.storage.type[0], BEHAVIOR_TYPE::PREY);
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, PartitionsByType )
+{
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    AddBoid<PreyBehavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    AddBoid<HunterBehavior>({1.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    AddBoid<Behavior>({2.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    AddBoid<PreyBehavior>({3.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+
+    TypePartitions& partitions = flockingSimulation.partitions;
+    partitions.Build(flockingSimulation.storage);
+
+    ASSERT_EQ(partitions.Of(BEHAVIOR_TYPE::PREY), (vector<int>{0, 3}));
+    ASSERT_EQ(partitions.Of(BEHAVIOR_TYPE::HUNTER), (vector<int>{1}));
+    ASSERT_EQ(partitions.Of(BEHAVIOR_TYPE::DEFAULT), (vector<int>{2}));
+
+    flockingSimulation.ClearAll();
+}
+
+// Neighbour lists
+
+TEST_F( FlockingTest, NeighbourListsMatchFreshSearch )
+{
+    constexpr int FRAMES = 40;
+
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    flockingSimulation.SetNeighbourSkin(0.5f);
+    flockingSimulation.Spawn<PreyBehavior>(500);
+    flockingSimulation.Spawn<HunterBehavior>(20);
+
+    NeighbourLists& lists = flockingSimulation.neighbourLists;
+    const auto gather = [this](int id)
+    {
+        ArenaScope scope;
+        NeighbourBuffer neighbours;
+        flockingSimulation.GatherNeighbours(id, *boids[id].behavior, neighbours);
+
+        vector<int> ids(neighbours.id.begin(), neighbours.id.end());
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    for(int frame = 0; frame < FRAMES; ++frame) {
+        flockingSimulation.OnUpdate(1.f / 60.f);
+        flockingSimulation.PrepareNeighbourSearch(nullptr, 0.f);
+        ASSERT_TRUE(lists.IsValid());
+
+        for(int id = 0; id < boids.size(); ++id) {
+            const vector<int> cached = gather(id);
+
+            lists.valid = false;
+            flockingSimulation.useSpatialGrid = false;
+            const vector<int> fresh = gather(id);
+            flockingSimulation.useSpatialGrid = true;
+            lists.valid = true;
+
+            ASSERT_EQ(cached, fresh);
+        }
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, NeighbourListsSurviveDeath )
+{
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    flockingSimulation.SetNeighbourSkin(1.f);
+    AddBoid<PreyBehavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    AddBoid<PreyBehavior>({1.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    AddBoid<PreyBehavior>({1.2f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+
+    flockingSimulation.PrepareNeighbourSearch(nullptr, 0.f);
+    ASSERT_TRUE(flockingSimulation.neighbourLists.IsValid());
+
+    // The last boid takes the dead one's id, its candidates still resolve through the slots
+    boids[1].status = STATUS::DEAD;
+    flockingSimulation.storage.status[1] = STATUS::DEAD;
+    flockingSimulation.RemoveDead();
+    ASSERT_FALSE(flockingSimulation.neighbourLists.NeedsRebuild(flockingSimulation.storage, flockingSimulation.slots, flockingSimulation.neighbourLists.GetRadius(), 1.f, 0.f));
+
+    ArenaScope scope;
+    NeighbourBuffer neighbours;
+    flockingSimulation.GatherNeighbours(0, *boids[0].behavior, neighbours);
+    ASSERT_EQ(neighbours.Size(), 1);
+    ASSERT_EQ(neighbours.id[0], 1);
+    ASSERT_FLOAT_EQ(neighbours.px[0], 1.2f);
+
+    // A spawn has no list yet
+    AddBoid<PreyBehavior>({3.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    ASSERT_FALSE(flockingSimulation.neighbourLists.IsValid());
+
+    flockingSimulation.ClearAll();
+}
+
+// Morton order
+
+TEST_F( FlockingTest, MortonCodes )
+{
+    const RVector3& minPoint = flockingSimulation.minPoint;
+    const RVector3& maxPoint = flockingSimulation.maxPoint;
+    const RVector3 cell = (maxPoint - minPoint) / static_cast<float>(1 << MortonOrder::BITS_PER_AXIS);
+
+    ASSERT_EQ(MortonOrder::GetCode(minPoint, minPoint, maxPoint), 0u);
+    ASSERT_EQ(MortonOrder::GetCode(maxPoint, minPoint, maxPoint), (1u << 3 * MortonOrder::BITS_PER_AXIS) - 1);
+    ASSERT_EQ(MortonOrder::GetCode(minPoint + RVector3{cell.x * 1.5f, 0.f, 0.f}, minPoint, maxPoint), 1u);
+    ASSERT_EQ(MortonOrder::GetCode(minPoint + RVector3{0.f, cell.y * 1.5f, 0.f}, minPoint, maxPoint), 2u);
+    ASSERT_EQ(MortonOrder::GetCode(minPoint + RVector3{0.f, 0.f, cell.z * 1.5f}, minPoint, maxPoint), 4u);
+    ASSERT_EQ(MortonOrder::GetCode(minPoint + RVector3{cell.x * 2.5f, 0.f, 0.f}, minPoint, maxPoint), 8u);
+    // Clamped into the bounds
+    ASSERT_EQ(MortonOrder::GetCode(minPoint - RVector3{5.f, 5.f, 5.f}, minPoint, maxPoint), 0u);
+}
+
+TEST_F( FlockingTest, SortKeepsHandles )
+{
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    flockingSimulation.Spawn<PreyBehavior>(300);
+    flockingSimulation.Spawn<HunterBehavior>(10);
+
+    vector<BoidHandle> handles;
+    vector<RVector3> positions;
+    for(int id = 0; id < boids.size(); ++id) {
+        handles.push_back(flockingSimulation.GetHandle(id));
+        positions.push_back(boids[id].position);
+    }
+
+    flockingSimulation.SortBoids();
+
+    for(size_t i = 0; i < handles.size(); ++i) {
+        const Boid* boid = flockingSimulation.Resolve(handles[i]);
+        ASSERT_NE(boid, nullptr);
+        ASSERT_EQ(boid->position, positions[i]);
+    }
+
+    const BoidStorage& storage = flockingSimulation.storage;
+    uint32_t previousCode = 0;
+    for(int id = 0; id < boids.size(); ++id) {
+        ASSERT_EQ(flockingSimulation.slots.Find(flockingSimulation.GetHandle(id)), id);
+        ASSERT_EQ(storage.GetPosition(id), boids[id].position);
+        ASSERT_EQ(storage.GetVelocity(id), boids[id].velocity);
+        ASSERT_EQ(storage.type[id], boids[id].behavior->GetType());
+
+        const uint32_t code = MortonOrder::GetCode(boids[id].position, flockingSimulation.minPoint, flockingSimulation.maxPoint);
+        ASSERT_LE(previousCode, code);
+        previousCode = code;
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, SortInterval )
+{
+    flockingSimulation.SetSortInterval(3);
+    flockingSimulation.Spawn<PreyBehavior>(100);
+
+    for(int frame = 1; frame <= 6; ++frame) {
+        flockingSimulation.OnUpdate(0.01f);
+        ASSERT_EQ(flockingSimulation.updatesSinceSort, frame % 3);
+    }
+
+    vector<int> order = flockingSimulation.mortonOrder.GetOrder();
+    std::sort(order.begin(), order.end());
+    for(int id = 0; id < order.size(); ++id) {
+        ASSERT_EQ(order[id], id);
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+// Frame stats
+
+#if FLOCKING_PROFILE
+TEST_F( FlockingTest, FrameStatsCounters )
+{
+    constexpr int FRAMES = 5;
+
+    flockingSimulation.SetStorageMode(STORAGE_MODE::SOA);
+    AddBoid<PreyBehavior>({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    AddBoid<PreyBehavior>({1.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    AddBoid<Behavior>({200.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+
+    for(int frame = 0; frame < FRAMES; ++frame) {
+        flockingSimulation.OnUpdate(0.01f);
+    }
+
+    const FrameStats stats = flockingSimulation.GetFrameStats();
+    ASSERT_EQ(stats.frames, FRAMES);
+    ASSERT_DOUBLE_EQ(stats.boidsPerFrame, 3.0);
+    // Only the trailing prey has the other one in its field of view
+    ASSERT_DOUBLE_EQ(stats.averageNeighbours, 1.0 / 3.0);
+    ASSERT_DOUBLE_EQ(stats.raycastsPerFrame, 3.0);
+    ASSERT_EQ(stats.droppedSamples, 0);
+
+    for(const PhaseStats& phase : stats.phases) {
+        ASSERT_LE(phase.minMs, phase.meanMs);
+        ASSERT_LE(phase.meanMs, phase.p99Ms);
+    }
+    ASSERT_GT(stats.phases[static_cast<int>(FRAME_PHASE::STEERING)].meanMs, 0.0);
+
+    flockingSimulation.ClearAll();
+    ASSERT_EQ(flockingSimulation.GetFrameStats().frames, 0);
+}
+
+TEST_F( FlockingTest, FrameStatsParallel )
+{
+    flockingSimulation.SetUpdateMode(UPDATE_MODE::PARALLEL);
+    flockingSimulation.SetWorkerCount(4);
+    flockingSimulation.Spawn<PreyBehavior>(200);
+    flockingSimulation.Spawn<HunterBehavior>(20);
+
+    flockingSimulation.OnUpdate(0.000001f);
+
+    const FrameStats stats = flockingSimulation.GetFrameStats();
+    ASSERT_EQ(stats.frames, 1);
+    ASSERT_DOUBLE_EQ(stats.boidsPerFrame, 220.0);
+    ASSERT_EQ(stats.droppedSamples, 0);
+    ASSERT_GT(stats.workerUtilization, 0.0);
+    ASSERT_LE(stats.workerUtilization, 1.0);
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, FrameStatsNeighbourListRebuilds )
+{
+    constexpr int FRAMES = 60;
+
+    flockingSimulation.SetUpdateMode(UPDATE_MODE::PARALLEL);
+    flockingSimulation.SetWorkerCount(4);
+    flockingSimulation.Spawn<PreyBehavior>(500);
+
+    for(int frame = 0; frame < FRAMES; ++frame) {
+        flockingSimulation.OnUpdate(1.f / 60.f);
+    }
+    ASSERT_DOUBLE_EQ(flockingSimulation.GetFrameStats().neighbourListRebuildRate, 0.0);
+
+    flockingSimulation.SetNeighbourSkin(1.f);
+    flockingSimulation.profiler.Clear();
+    for(int frame = 0; frame < FRAMES; ++frame) {
+        flockingSimulation.OnUpdate(1.f / 60.f);
+    }
+
+    // Prey cover 5 units/s, half a unit of skin lasts several updates
+    const double rebuildRate = flockingSimulation.GetFrameStats().neighbourListRebuildRate;
+    ASSERT_GT(rebuildRate, 0.0);
+    ASSERT_LT(rebuildRate, 0.5);
+
+    flockingSimulation.ClearAll();
+}
+#endif
+
+TEST_F( FlockingTest, SimulationThreadSpawnsAndPublishes )
+{
+    SimulationThread thread(flockingSimulation);
+
+    SimulationCommand flock;
+    flock.command = SIMULATION_COMMAND::SPAWN_RANDOM;
+    flock.type = BEHAVIOR_TYPE::PREY;
+    flock.count = 50;
+    ASSERT_TRUE(thread.Push(flock));
+
+    SimulationCommand single;
+    single.position[0] = 5.f;
+    single.velocity[2] = 1.f;
+    ASSERT_TRUE(thread.Push(single));
+
+    ASSERT_EQ(thread.AcquireSnapshot().step, 0);
+    thread.Start(0.001f);
+    ASSERT_TRUE(thread.IsRunning());
+
+    // Read while the thread keeps publishing, a snapshot is never seen half written
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    uint64_t lastStep = 0;
+    while(lastStep < 20 && std::chrono::steady_clock::now() < deadline) {
+        const SimulationSnapshot& snapshot = thread.AcquireSnapshot();
+        ASSERT_GE(snapshot.step, lastStep);
+        lastStep = snapshot.step;
+
+        if(snapshot.step > 0) {
+            ASSERT_EQ(snapshot.positions.size(), 51);
+            ASSERT_EQ(snapshot.radii.size(), 51);
+            ASSERT_EQ(snapshot.previousPositions.size(), 51);
+            ASSERT_EQ(snapshot.GetPosition(50, 1.f), snapshot.positions[50]);
+            ASSERT_EQ(std::count(snapshot.types.begin(), snapshot.types.end(), BEHAVIOR_TYPE::PREY), 50);
+            ASSERT_EQ(std::count(snapshot.types.begin(), snapshot.types.end(), BEHAVIOR_TYPE::DEFAULT), 1);
+        }
+    }
+    ASSERT_GE(lastStep, 20);
+
+    thread.Stop();
+    ASSERT_FALSE(thread.IsRunning());
+
+    thread.Step(1.f / 60.f);
+    ASSERT_EQ(thread.AcquireSnapshot().step, thread.steps);
+    ASSERT_FALSE(thread.snapshots.Acquire());
+
+    flockingSimulation.ClearAll();
+}
+
+// The game gets the handle when it queues the spawn and follows the boid through the snapshots
+TEST_F( FlockingTest, SimulationThreadReservedHandles )
+{
+    SimulationThread thread(flockingSimulation);
+    ASSERT_EQ(thread.ReserveHandle().slot, BoidHandle::INVALID_SLOT);
+
+    thread.Step(1.f / 60.f);
+    SimulationCommand hunter;
+    hunter.type = BEHAVIOR_TYPE::HUNTER;
+    hunter.position[1] = 5.f;
+    hunter.velocity[0] = 1.f;
+    hunter.handle = thread.ReserveHandle();
+    ASSERT_NE(hunter.handle.slot, BoidHandle::INVALID_SLOT);
+    ASSERT_TRUE(thread.Push(hunter));
+    ASSERT_FALSE(thread.AcquireSnapshot().IsAlive(hunter.handle));
+
+    // Spawned before the command in between, the reserved slot is not handed to anyone else
+    flockingSimulation.Spawn<PreyBehavior>(20);
+    thread.Step(1.f / 60.f);
+    ASSERT_TRUE(thread.AcquireSnapshot().IsAlive(hunter.handle));
+    ASSERT_TRUE(flockingSimulation.IsAlive(hunter.handle));
+    ASSERT_EQ(flockingSimulation.Resolve(hunter.handle)->behavior->GetType(), BEHAVIOR_TYPE::HUNTER);
+
+    // Every handle is unique
+    vector<uint32_t> slots;
+    for(BoidHandle handle = thread.ReserveHandle(); handle.slot != BoidHandle::INVALID_SLOT; handle = thread.ReserveHandle()) {
+        slots.push_back(handle.slot);
+    }
+    for(int id = 0; id < flockingSimulation.GetBoids().size(); ++id) {
+        slots.push_back(flockingSimulation.GetHandle(id).slot);
+    }
+    std::sort(slots.begin(), slots.end());
+    ASSERT_EQ(std::adjacent_find(slots.begin(), slots.end()), slots.end());
+
+    flockingSimulation.ClearAll();
+    thread.Step(1.f / 60.f);
+    ASSERT_FALSE(thread.AcquireSnapshot().IsAlive(hunter.handle));
+}
+
+TEST_F( FlockingTest, SimulationThreadFullQueueKeepsHandles )
+{
+    SimulationThread thread(flockingSimulation);
+    thread.Step(1.f / 60.f);
+
+    SimulationCommand observer;
+    observer.command = SIMULATION_COMMAND::SET_OBSERVER;
+    while(thread.Push(observer)) {}
+
+    // A dropped spawn takes no handle with it
+    SimulationCommand hunter;
+    hunter.type = BEHAVIOR_TYPE::HUNTER;
+    hunter.position[1] = 5.f;
+    ASSERT_EQ(thread.PushSpawn(hunter).slot, BoidHandle::INVALID_SLOT);
+
+    thread.Step(1.f / 60.f);
+    const BoidHandle handle = thread.PushSpawn(hunter);
+    ASSERT_NE(handle.slot, BoidHandle::INVALID_SLOT);
+    thread.Step(1.f / 60.f);
+    ASSERT_TRUE(thread.AcquireSnapshot().IsAlive(handle));
+    // The ring and the pending handle, then one more for the spawned hunter
+    ASSERT_EQ(flockingSimulation.GetSlotCount(), SimulationThread::RESERVED_HANDLE_CAPACITY + 2);
+
+    flockingSimulation.ClearAll();
+}
+
+// Boids move as a whole when dead ones are compacted or the flock is sorted, so do their previous positions
+TEST_F( FlockingTest, InterpolatedPositions )
+{
+    flockingSimulation.SetSortInterval(1);
+    flockingSimulation.Spawn<PreyBehavior>(100);
+
+    const float position[3] = {-20.f, 5.f, 0.f};
+    const float velocity[3] = {1.f, 0.f, 0.f};
+    const BoidHandle handle = flockingSimulation.Spawn<Behavior>(position, velocity);
+
+    vector<RVector3> positions;
+    flockingSimulation.GetInterpolatedPositions(0.5f, positions);
+    ASSERT_EQ(positions.back(), (RVector3{-20.f, 5.f, 0.f}));
+
+    for(int frame = 0; frame < 3; ++frame) {
+        const RVector3 before = flockingSimulation.Resolve(handle)->position;
+        flockingSimulation.OnUpdate(1.f / 30.f);
+
+        const Boid& after = *flockingSimulation.Resolve(handle);
+        const int id = static_cast<int>(&after - flockingSimulation.GetBoids().data());
+        ASSERT_EQ(after.previousPosition, before);
+
+        flockingSimulation.GetInterpolatedPositions(0.f, positions);
+        ASSERT_EQ(positions[id], before);
+        flockingSimulation.GetInterpolatedPositions(1.f, positions);
+        ASSERT_EQ(positions[id], after.position);
+        flockingSimulation.GetInterpolatedPositions(0.5f, positions);
+        ASSERT_LT((positions[id] - (before + after.position) * 0.5f).length(), 1e-5f);
+    }
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, FrameBudgetGovernor )
+{
+    constexpr int WINDOW = DefaultSimulationParams::FRAME_BUDGET_WINDOW;
+    constexpr int TOP_LEVEL = DefaultSimulationParams::LOD_LEVEL_COUNT - 1;
+
+    flockingSimulation.GetBehavior<PreyBehavior>().maxNeighbours = 12;
+    flockingSimulation.Spawn<PreyBehavior>(300);
+    flockingSimulation.Spawn<HunterBehavior>(5);
+
+    // No update fits, the governor steps down one level per window
+    flockingSimulation.SetFrameBudget(1e-6f);
+    for(int level = 1; level <= TOP_LEVEL + 1; ++level) {
+        for(int frame = 0; frame < WINDOW; ++frame) {
+            flockingSimulation.OnUpdate(1.f / 60.f);
+        }
+        ASSERT_EQ(flockingSimulation.GetLodLevel(), std::min(level, TOP_LEVEL));
+    }
+    ASSERT_EQ(flockingSimulation.GetFrameStats().lodLevel, TOP_LEVEL);
+
+    const SimulationLod& lowest = DefaultSimulationParams::LOD_LEVELS[TOP_LEVEL];
+    const PreyBehavior& prey = flockingSimulation.GetBehavior<PreyBehavior>();
+    ASSERT_EQ(prey.maxNeighbours, 12);
+    ASSERT_EQ(prey.GetMaxNeighbours(), std::min(12, lowest.neighbourCap));
+    ASSERT_EQ(prey.avoidanceInterval, lowest.avoidanceInterval);
+    ASSERT_EQ(flockingSimulation.GetBehavior<HunterBehavior>().GetMaxNeighbours(), 0);
+    ASSERT_EQ(flockingSimulation.GetBehavior<HunterBehavior>().avoidanceInterval, 1);
+
+    // Every update fits with room to spare, the quality comes back level by level
+    flockingSimulation.SetFrameBudget(1e6f);
+    for(int level = TOP_LEVEL - 1; level >= 0; --level) {
+        for(int frame = 0; frame < WINDOW; ++frame) {
+            flockingSimulation.OnUpdate(1.f / 60.f);
+        }
+        ASSERT_EQ(flockingSimulation.GetLodLevel(), level);
+    }
+    ASSERT_EQ(prey.GetMaxNeighbours(), 12);
+    ASSERT_EQ(prey.avoidanceInterval, 1);
+
+    flockingSimulation.SetLodLevel(2);
+    flockingSimulation.SetFrameBudget(0.f);
+    ASSERT_EQ(flockingSimulation.GetLodLevel(), 0);
+
+    flockingSimulation.ClearAll();
+}
+
+TEST_F( FlockingTest, TimeSlicedSteering )
+{
+    constexpr int SLICES = 4;
+    constexpr float DELTA_TIME = 1.f / 60.f;
+
+    const std::pair<STORAGE_MODE, UPDATE_MODE> modes[] = {
+        {STORAGE_MODE::AOS, UPDATE_MODE::SEQUENTIAL},
+        {STORAGE_MODE::SOA, UPDATE_MODE::SEQUENTIAL},
+        {STORAGE_MODE::SOA, UPDATE_MODE::PARALLEL}
+    };
+
+    for(const auto& [storage, update] : modes) {
+        SCOPED_TRACE(static_cast<int>(storage) * 10 + static_cast<int>(update));
+
+        FlockingSimulation simulation;
+        simulation.SetStorageMode(storage);
+        simulation.SetUpdateMode(update);
+        simulation.SetWorkerCount(2);
+        simulation.SetTimeSlices(SLICES);
+        simulation.SetTimeSliceExemptions(true, false);
+        // Blind hunters eat nothing, ids stay put
+        simulation.GetBehavior<HunterBehavior>().viewDistance = 0.f;
+        simulation.Spawn<PreyBehavior>(200);
+        simulation.Spawn<HunterBehavior>(4);
+
+        // Turns go by spawn order: prey 0, 4, 8... and every hunter steer on the first update, prey 3, 7, 11... on the second
+        for(int frame = 0; frame < SLICES; ++frame) {
+            vector<Boid> before = simulation.GetBoids();
+            simulation.OnUpdate(DELTA_TIME);
+            ASSERT_EQ(simulation.GetBoids().size(), before.size());
+
+            for(int id = 0; id < 200; ++id) {
+                if((id + frame) % SLICES != 0) {
+                    ASSERT_EQ(simulation.GetBoids()[id].position, before[id].position + before[id].velocity * DELTA_TIME) << id;
+                    ASSERT_EQ(simulation.GetBoids()[id].velocity, before[id].velocity) << id;
+                }
+            }
+        }
+
+        const FrameStats stats = simulation.GetFrameStats();
+        ASSERT_DOUBLE_EQ(stats.boidsPerFrame, 200.0 / SLICES + 4);
+
+        simulation.ClearAll();
+    }
+}
+
+TEST_F( FlockingTest, DistanceBands )
+{
+    constexpr int FRAMES = 8;
+
+    // Near the observer every update with raycasts, beyond 25 units every 4th update without, the last two bands unused
+    flockingSimulation.SetDistanceBand(1, {25.f, 4, false});
+    flockingSimulation.SetDistanceBand(2, {1e6f, 8, false});
+    flockingSimulation.SetDistanceBand(3, {2e6f, 8, false});
+    flockingSimulation.SetTimeSliceExemptions(false, false);
+
+    const float observer[3] = {-20.f, 0.f, -20.f};
+    flockingSimulation.SetObservers(observer, 1);
+    flockingSimulation.Spawn<PreyBehavior>(400);
+
+    for(int frame = 0; frame < FRAMES; ++frame) {
+        flockingSimulation.OnUpdate(1.f / 60.f);
+    }
+
+    const RVector3 observerPosition{observer[0], observer[1], observer[2]};
+    int far = 0;
+    // Bands are picked before the boid moves
+    for(const Boid& boid : boids) {
+        const bool isFar = (boid.previousPosition - observerPosition).length() >= 25.f;
+        far += isFar ? 1 : 0;
+        ASSERT_EQ(boid.avoidsObstacles, !isFar);
+    }
+    ASSERT_GT(far, 0);
+    ASSERT_LT(far, 400);
+
+    const FrameStats stats = flockingSimulation.GetFrameStats();
+    ASSERT_DOUBLE_EQ(stats.bands[0].boidsPerFrame + stats.bands[1].boidsPerFrame, 400.0);
+    ASSERT_DOUBLE_EQ(stats.bands[0].steeredPerFrame, stats.bands[0].boidsPerFrame);
+    ASSERT_DOUBLE_EQ(stats.bands[0].savedMs, 0.0);
+    ASSERT_NEAR(stats.bands[1].steeredPerFrame, stats.bands[1].boidsPerFrame / 4, 10.0);
+    ASSERT_GT(stats.bands[1].savedMs, 0.0);
+    ASSERT_DOUBLE_EQ(stats.bands[2].boidsPerFrame + stats.bands[3].boidsPerFrame, 0.0);
+    ASSERT_DOUBLE_EQ(stats.boidsPerFrame, stats.bands[0].steeredPerFrame + stats.bands[1].steeredPerFrame);
+
+    // Without observers every boid is back in the first band
+    flockingSimulation.SetObservers(nullptr, 0);
+    flockingSimulation.OnUpdate(1.f / 60.f);
+    for(const Boid& boid : boids) {
+        ASSERT_TRUE(boid.avoidsObstacles);
+    }
+
+    flockingSimulation.ClearAll();
+}
@@ -0,0 +1,229 @@
+﻿#include "pch.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <FlockingSimulation.h>
+
+// Allocation counting hook: the test binary replaces the global operator new, the count only moves while a test enables it
+namespace
+{
+    std::atomic<bool> countAllocations = false;
+    std::atomic<int> allocations = 0;
+
+    void* Allocate(size_t size, size_t alignment)
+    {
+        if(countAllocations.load(std::memory_order_relaxed)) {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        size = size == 0 ? 1 : size;
+        void* memory = nullptr;
+#ifdef _MSC_VER
+        memory = _aligned_malloc(size, alignment);
+#else
+        if(posix_memalign(&memory, std::max(alignment, sizeof(void*)), size) != 0) {
+            memory = nullptr;
+        }
+#endif
+        if(memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    void Free(void* memory)
+    {
+#ifdef _MSC_VER
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+
+    class AllocationCounter
+    {
+    public:
+        AllocationCounter()
+        {
+            allocations = 0;
+            countAllocations = true;
+        }
+
+        ~AllocationCounter()
+        {
+            countAllocations = false;
+        }
+
+        int GetCount() const
+        {
+            return allocations;
+        }
+    };
+}
+
+void* operator new(size_t size)
+{
+    return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return Allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept
+{
+    Free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    Free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    Free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+    Free(memory);
+}
+
+TEST( FrameArenaTest, ScopeRewinds )
+{
+    FrameArena& arena = FrameArena::Get();
+
+    void* first;
+    {
+        ArenaScope scope;
+        first = arena.Allocate(100, 16);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(first) % 16, 0);
+        arena.Allocate(1000, 8);
+    }
+
+    ArenaScope scope;
+    ASSERT_EQ(arena.Allocate(100, 16), first);
+}
+
+// An update only rewinds its own frame, not what the thread or another simulation's thread holds
+// Wide lanes after a small allocation in the same block, on blocks that start off a 32 byte boundary
+TEST( FrameArenaTest, AlignsInReusedBlock )
+{
+    // Heap blocks are only 16 byte aligned, keep allocating until some start 16 bytes past a 32 byte boundary
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+    int misalignedBlocks = 0;
+    for(int i = 0; i < 16; ++i) {
+        arenas.push_back(std::make_unique<FrameArena>());
+        FrameArena& arena = *arenas.back();
+        arena.Allocate(8, 8);
+        misalignedBlocks += reinterpret_cast<uintptr_t>(arena.blocks[0].data.get()) % 32 != 0;
+
+        for(int j = 0; j < 20; ++j) {
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(arena.Allocate(24, 32)) % 32, 0) << i << " " << j;
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(arena.Allocate(4, 4)) % 4, 0);
+        }
+        ASSERT_EQ(arena.blocks.size(), 1);
+    }
+
+    if(misalignedBlocks == 0) {
+        GTEST_SKIP() << "every block started on a 32 byte boundary";
+    }
+}
+
+TEST( FrameArenaTest, UpdateKeepsOtherAllocations )
+{
+    ArenaScope scope;
+    ArenaVector<int> held;
+    for(int i = 0; i < 1000; ++i) {
+        held.push_back(i);
+    }
+    const FrameArena::Mark before = FrameArena::Get().GetMark();
+
+    FlockingSimulation simulation;
+    simulation.Spawn<PreyBehavior>(500);
+    FlockingSimulation other;
+    other.Spawn<PreyBehavior>(500);
+
+    std::thread otherThread([&other]()
+    {
+        for(int frame = 0; frame < 10; ++frame) {
+            other.OnUpdate(1.f / 60.f);
+        }
+    });
+    for(int frame = 0; frame < 10; ++frame) {
+        simulation.OnUpdate(1.f / 60.f);
+    }
+    otherThread.join();
+
+    const FrameArena::Mark after = FrameArena::Get().GetMark();
+    ASSERT_EQ(after.block, before.block);
+    ASSERT_EQ(after.offset, before.offset);
+    for(int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(held[i], i);
+    }
+}
+
+TEST( FrameArenaTest, VectorGrowth )
+{
+    ArenaScope scope;
+
+    ArenaVector<int> grown;
+    ArenaVector<int> interleaved;
+    for(int i = 0; i < 100000; ++i) {
+        grown.push_back(i);
+        if(i % 3 == 0) {
+            interleaved.push_back(-i);
+        }
+    }
+
+    ASSERT_EQ(grown.size(), 100000);
+    for(int i = 0; i < 100000; ++i) {
+        ASSERT_EQ(grown[i], i);
+    }
+
+    ASSERT_EQ(interleaved.size(), 33334);
+    for(int i = 0; i < interleaved.size(); ++i) {
+        ASSERT_EQ(interleaved[i], -3 * i);
+    }
+}
+
+// After a few warm-up frames every temporary comes out of the arenas and the reused scratch buffers
+TEST( FrameArenaTest, SteadyUpdateDoesNotAllocate )
+{
+    constexpr int WARMUP = 10;
+    constexpr int FRAMES = 10;
+
+    const std::pair<STORAGE_MODE, UPDATE_MODE> modes[] = {
+        {STORAGE_MODE::AOS, UPDATE_MODE::SEQUENTIAL},
+        {STORAGE_MODE::SOA, UPDATE_MODE::SEQUENTIAL},
+        {STORAGE_MODE::SOA, UPDATE_MODE::PARALLEL}
+    };
+
+    for(const auto& [storage, update] : modes) {
+        SCOPED_TRACE(static_cast<int>(storage) * 10 + static_cast<int>(update));
+
+        FlockingSimulation simulation;
+        simulation.SetStorageMode(storage);
+        simulation.SetUpdateMode(update);
+        simulation.SetWorkerCount(4);
+        simulation.Spawn<PreyBehavior>(2000);
+        simulation.Spawn<HunterBehavior>(20);
+
+        for(int frame = 0; frame < WARMUP; ++frame) {
+            simulation.OnUpdate(1.f / 60.f);
+        }
+
+        AllocationCounter counter;
+        for(int frame = 0; frame < FRAMES; ++frame) {
+            simulation.OnUpdate(1.f / 60.f);
+        }
+        ASSERT_EQ(counter.GetCount(), 0);
+    }
+}
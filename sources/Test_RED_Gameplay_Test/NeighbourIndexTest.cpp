@@ -0,0 +1,75 @@
+﻿#include "pch.h"
+#include <algorithm>
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <KdTree.h>
+#include <MortonSweep.h>
+
+TEST( KdTreeTest, RefitsSmallMotion )
+{
+    constexpr int COUNT = 1000;
+    const RVector3 minPoint{0.f, 0.f, 0.f};
+    const RVector3 maxPoint{10.f, 10.f, 10.f};
+
+    vector<float> x(COUNT), y(COUNT), z(COUNT);
+    for(int i = 0; i < COUNT; ++i) {
+        x[i] = std::fmod(i * 0.618f, 10.f);
+        y[i] = std::fmod(i * 0.414f, 10.f);
+        z[i] = std::fmod(i * 0.732f, 10.f);
+    }
+
+    KdTree tree;
+    tree.Build({x.data(), y.data(), z.data(), COUNT}, minPoint, maxPoint, 1.f);
+    ASSERT_EQ(tree.GetRebuildCount(), 1);
+
+    for(int i = 0; i < COUNT; ++i) {
+        x[i] += 0.01f;
+    }
+    tree.Build({x.data(), y.data(), z.data(), COUNT}, minPoint, maxPoint, 1.f);
+    ASSERT_EQ(tree.GetRebuildCount(), 1);
+
+    // Every leaf now spans the whole x range, the refit is too loose to keep
+    for(int i = 0; i < COUNT; ++i) {
+        x[i] = std::fmod(i * 0.271f, 10.f);
+    }
+    tree.Build({x.data(), y.data(), z.data(), COUNT}, minPoint, maxPoint, 1.f);
+    ASSERT_EQ(tree.GetRebuildCount(), 2);
+
+    ArenaScope scope;
+    IdList candidates;
+    tree.Query({5.f, 5.f, 5.f}, 1.f, candidates);
+    std::sort(candidates.begin(), candidates.end());
+
+    vector<int> expected;
+    for(int i = 0; i < COUNT; ++i) {
+        if((RVector3{x[i], y[i], z[i]} - RVector3{5.f, 5.f, 5.f}).lengthSquare() <= 1.f) {
+            expected.push_back(i);
+        }
+    }
+    ASSERT_EQ(vector<int>(candidates.begin(), candidates.end()), expected);
+}
+
+TEST( MortonSweepTest, NextInBox )
+{
+    // Every box over the first 4 cells of each axis against a scan of the codes
+    constexpr uint32_t CODES = 1 << 12;
+
+    for(uint32_t zmin = 0; zmin < CODES; zmin += 37) {
+        for(uint32_t zmax = zmin; zmax < CODES; zmax += 53) {
+            if(!MortonSweep::IsInBox(zmax, zmin, zmax) || !MortonSweep::IsInBox(zmin, zmin, zmax)) {
+                continue;
+            }
+
+            uint32_t next = zmax;
+            for(uint32_t code = zmax; code > zmin; --code) {
+                if(MortonSweep::IsInBox(code, zmin, zmax)) {
+                    next = code;
+                } else {
+                    ASSERT_EQ(MortonSweep::GetNextInBox(code, zmin, zmax), next) << zmin << " " << zmax << " " << code;
+                }
+            }
+        }
+    }
+}
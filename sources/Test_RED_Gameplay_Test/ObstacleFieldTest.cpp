@@ -0,0 +1,131 @@
+﻿#include "pch.h"
+#include <chrono>
+#include <random>
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <FlockingSimulation.h>
+
+using reactphysics3d::Vector3;
+
+class ObstacleFieldTest : public ::testing::Test
+{
+public:
+    void SetUp() override
+    {
+        flockingSimulation.SetObstacleBackend(OBSTACLE_BACKEND::DISTANCE_FIELD);
+        flockingSimulation.SetObstacleFieldCellSize(CELL_SIZE, false);
+    }
+
+    void TearDown() override
+    {
+        flockingSimulation.ClearAll();
+    }
+
+    void AddObstacle(Vector3 center, Vector3 extents)
+    {
+        flockingSimulation.AddObstacle(&center.x, &extents.x);
+    }
+
+    constexpr static float CELL_SIZE = 0.25f;
+
+    FlockingSimulation flockingSimulation;
+};
+
+// test cases
+////////////////////////////////////////////////
+
+TEST_F( ObstacleFieldTest, Distance )
+{
+    AddObstacle({0.f, 5.f, 0.f}, {2.f, 5.f, 2.f});
+    flockingSimulation.OnUpdate(0.f);
+
+    const ObstacleField& field = flockingSimulation.GetObstacleField();
+    ASSERT_TRUE(field.IsReady());
+    ASSERT_GT(field.GetMemoryUsage(), 0);
+
+    float distance;
+    Vector3 gradient;
+
+    ASSERT_TRUE(field.Sample({5.f, 2.f, 0.f}, distance, gradient));
+    EXPECT_NEAR(distance, 3.f, 0.001f);
+    EXPECT_NEAR(gradient.x, 1.f, 0.001f);
+
+    ASSERT_TRUE(field.Sample({0.f, 2.f, -3.f}, distance, gradient));
+    EXPECT_NEAR(distance, 1.f, 0.001f);
+    EXPECT_NEAR(gradient.z, -1.f, 0.001f);
+
+    ASSERT_TRUE(field.Sample({1.5f, 2.f, 0.f}, distance, gradient));
+    EXPECT_NEAR(distance, -0.5f, 0.001f);
+    EXPECT_NEAR(gradient.x, 1.f, 0.001f);
+}
+
+TEST_F( ObstacleFieldTest, TrilinearError )
+{
+    std::mt19937 engine(3);
+    std::uniform_real_distribution<float> position(-15.f, 15.f);
+    std::uniform_real_distribution<float> extent(0.5f, 3.f);
+
+    for(int i = 0; i < 20; ++i) {
+        const float height = extent(engine) * 3.f;
+        AddObstacle({position(engine), height, position(engine)}, {extent(engine), height, extent(engine)});
+    }
+    flockingSimulation.OnUpdate(0.f);
+
+    const ObstacleField& field = flockingSimulation.GetObstacleField();
+    const ObstacleIndex& index = flockingSimulation.obstacleIndex;
+
+    // A distance field is 1-Lipschitz, so interpolating between nodes is off by at most the cell diagonal
+    const float maxError = CELL_SIZE * std::sqrt(3.f);
+
+    std::uniform_real_distribution<float> height(0.f, 20.f);
+    for(int i = 0; i < 2000; ++i) {
+        const Vector3 point = {position(engine), height(engine), position(engine)};
+
+        float distance;
+        Vector3 gradient;
+        ASSERT_TRUE(field.Sample(point, distance, gradient));
+
+        const float expected = ObstacleField::GetDistance(point, index.boxMin, index.boxMax);
+        ASSERT_NEAR(distance, expected, maxError);
+    }
+}
+
+TEST_F( ObstacleFieldTest, BackgroundBuild )
+{
+    flockingSimulation.SetObstacleFieldCellSize(CELL_SIZE, true);
+    AddObstacle({3.f, 5.f, 0.f}, {1.f, 5.f, 1.f});
+
+    const ObstacleField& field = flockingSimulation.GetObstacleField();
+    const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(!field.IsReady() && std::chrono::steady_clock::now() < timeout) {
+        flockingSimulation.OnUpdate(0.f);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    ASSERT_TRUE(field.IsReady());
+
+    // A new obstacle invalidates it until the next build is published
+    AddObstacle({-3.f, 5.f, 0.f}, {1.f, 5.f, 1.f});
+    ASSERT_FALSE(field.IsReady());
+}
+
+TEST_F( ObstacleFieldTest, Avoidance )
+{
+    AddObstacle({3.f, 5.f, 0.f}, {1.f, 5.f, 1.f});
+    flockingSimulation.OnUpdate(0.f);
+
+    const Vector3 position = {1.f, 2.f, 0.f};
+    const Vector3 velocity = {1.f, 0.f, 0.f};
+    const Boid& boid = *flockingSimulation.Resolve(flockingSimulation.Spawn<Behavior>(&position.x, &velocity.x));
+    ASSERT_EQ(boid.obstacleField, &flockingSimulation.GetObstacleField());
+
+    // Heading into the wall, pushed back and to the side
+    const Vector3 direction = boid.behavior->GetUnobstructedDirection(boid);
+    ASSERT_LT(direction.x, 0.f);
+
+    // Flying away from it
+    flockingSimulation.boids[0].velocity = {-1.f, 0.f, 0.f};
+    ASSERT_TRUE(boid.behavior->GetUnobstructedDirection(boid).isZero());
+}
@@ -0,0 +1,147 @@
+﻿#include "pch.h"
+#include <random>
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <FlockingSimulation.h>
+
+using reactphysics3d::Vector3;
+
+// The static index is checked against the rp3d world holding the same boxes
+class ObstacleIndexTest : public ::testing::Test
+{
+public:
+    void TearDown() override
+    {
+        flockingSimulation.ClearAll();
+    }
+
+    void AddObstacle(Vector3 center, Vector3 extents)
+    {
+        flockingSimulation.AddObstacle(&center.x, &extents.x);
+    }
+
+    // Closest rp3d hit, the callback clips the ray to every hit it gets
+    static bool PhysicsRaycast(const Vector3& from, const Vector3& to, Vector3& hitPoint)
+    {
+        float bestFraction = std::numeric_limits<float>::max();
+        RaycastCb cb = {[&bestFraction, &hitPoint](const RaycastInfo& raycastInfo)
+        {
+            if(raycastInfo.hitFraction < bestFraction) {
+                bestFraction = raycastInfo.hitFraction;
+                hitPoint = raycastInfo.worldPoint;
+            }
+            return raycastInfo.hitFraction;
+        }};
+
+        GetPhysicsWorld().raycast(RRay{from, to}, &cb);
+        return bestFraction <= 1.f;
+    }
+
+    FlockingSimulation flockingSimulation;
+};
+
+// test cases
+////////////////////////////////////////////////
+
+TEST_F( ObstacleIndexTest, Empty )
+{
+    ObstacleIndex& index = flockingSimulation.obstacleIndex;
+    index.Build(DefaultSimulationParams::OBSTACLE_CELL_SIZE);
+
+    Vector3 hitPoint;
+    ASSERT_FALSE(index.Raycast({0.f, 0.f, 0.f}, {10.f, 0.f, 0.f}, hitPoint));
+}
+
+TEST_F( ObstacleIndexTest, Hit )
+{
+    AddObstacle({5.f, 5.f, 0.f}, {1.f, 5.f, 1.f});
+    ObstacleIndex& index = flockingSimulation.obstacleIndex;
+    index.Build(DefaultSimulationParams::OBSTACLE_CELL_SIZE);
+
+    Vector3 hitPoint;
+    ASSERT_TRUE(index.Raycast({0.f, 1.f, 0.f}, {10.f, 1.f, 0.f}, hitPoint));
+    ASSERT_EQ(hitPoint, (Vector3{4.f, 1.f, 0.f}));
+
+    // Too short, above the roof and starting inside
+    ASSERT_FALSE(index.Raycast({0.f, 1.f, 0.f}, {3.f, 1.f, 0.f}, hitPoint));
+    ASSERT_FALSE(index.Raycast({0.f, 11.f, 0.f}, {10.f, 11.f, 0.f}, hitPoint));
+    ASSERT_FALSE(index.Raycast({5.f, 1.f, 0.f}, {10.f, 1.f, 0.f}, hitPoint));
+}
+
+TEST_F( ObstacleIndexTest, ClosestHit )
+{
+    AddObstacle({8.f, 5.f, 0.f}, {1.f, 5.f, 1.f});
+    AddObstacle({4.f, 5.f, 0.f}, {1.f, 5.f, 1.f});
+    ObstacleIndex& index = flockingSimulation.obstacleIndex;
+    index.Build(1.f);
+
+    Vector3 hitPoint;
+    ASSERT_TRUE(index.Raycast({0.f, 1.f, 0.f}, {10.f, 1.f, 0.f}, hitPoint));
+    ASSERT_EQ(hitPoint, (Vector3{3.f, 1.f, 0.f}));
+
+    ASSERT_TRUE(index.Raycast({10.f, 1.f, 0.f}, {0.f, 1.f, 0.f}, hitPoint));
+    ASSERT_EQ(hitPoint, (Vector3{9.f, 1.f, 0.f}));
+}
+
+TEST_F( ObstacleIndexTest, MatchesPhysics )
+{
+    std::mt19937 engine(7);
+    std::uniform_real_distribution<float> position(-20.f, 20.f);
+    std::uniform_real_distribution<float> extent(0.5f, 3.f);
+
+    for(int i = 0; i < 40; ++i) {
+        const float height = extent(engine) * 3.f;
+        AddObstacle({position(engine), height, position(engine)}, {extent(engine), height, extent(engine)});
+    }
+
+    ObstacleIndex& index = flockingSimulation.obstacleIndex;
+    index.Build(DefaultSimulationParams::OBSTACLE_CELL_SIZE);
+
+    std::uniform_real_distribution<float> height(0.f, 20.f);
+    std::uniform_real_distribution<float> direction(-1.f, 1.f);
+
+    int hits = 0;
+    for(int i = 0; i < 5000; ++i) {
+        const Vector3 from = {position(engine), height(engine), position(engine)};
+        const Vector3 to = from + Vector3{direction(engine), direction(engine) * 0.2f, direction(engine)} * 6.f;
+
+        Vector3 expectedHitPoint;
+        Vector3 hitPoint;
+        const bool expected = PhysicsRaycast(from, to, expectedHitPoint);
+        ASSERT_EQ(index.Raycast(from, to, hitPoint), expected);
+
+        if(expected) {
+            EXPECT_NEAR(hitPoint.x, expectedHitPoint.x, 0.0001f);
+            EXPECT_NEAR(hitPoint.y, expectedHitPoint.y, 0.0001f);
+            EXPECT_NEAR(hitPoint.z, expectedHitPoint.z, 0.0001f);
+            ++hits;
+        }
+    }
+
+    ASSERT_GT(hits, 0);
+}
+
+TEST_F( ObstacleIndexTest, AvoidanceMatchesPhysics )
+{
+    AddObstacle({3.f, 5.f, 0.f}, {1.f, 5.f, 1.f});
+    flockingSimulation.OnUpdate(0.f);
+
+    const Vector3 position = {0.f, 1.f, 0.f};
+    const Vector3 velocity = {1.f, 0.f, 0.f};
+    const Boid& boid = *flockingSimulation.Resolve(flockingSimulation.Spawn<Behavior>(&position.x, &velocity.x));
+    ASSERT_EQ(boid.obstacleIndex, &flockingSimulation.obstacleIndex);
+
+    const Vector3 indexDirection = boid.behavior->GetUnobstructedDirection(boid);
+
+    flockingSimulation.SetObstacleBackend(OBSTACLE_BACKEND::PHYSICS);
+    ASSERT_EQ(boid.obstacleIndex, nullptr);
+
+    const Vector3 physicsDirection = boid.behavior->GetUnobstructedDirection(boid);
+
+    ASSERT_FALSE(physicsDirection.isZero());
+    EXPECT_NEAR(indexDirection.x, physicsDirection.x, 0.0001f);
+    EXPECT_NEAR(indexDirection.y, physicsDirection.y, 0.0001f);
+    EXPECT_NEAR(indexDirection.z, physicsDirection.z, 0.0001f);
+}
@@ -0,0 +1,115 @@
+﻿#include "pch.h"
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <FlockingSimulation.h>
+
+namespace
+{
+    // Plain xoshiro128+ on one lane of the generator
+    float ReferenceNext(uint32_t state[4], float min, float max)
+    {
+        const uint32_t result = state[0] + state[3];
+        const uint32_t t = state[1] << 9;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = (state[3] << 11) | (state[3] >> 21);
+
+        const float unit = static_cast<float>(result >> 8) / 16777216.f;
+        const float scaled = unit * (max - min);
+        return scaled + min;
+    }
+}
+
+TEST( RandomTest, MatchesReference )
+{
+    constexpr int BLOCKS = 64;
+
+    Random random(42);
+    uint32_t lanes[Random::LANES][4];
+    for(int lane = 0; lane < Random::LANES; ++lane) {
+        lanes[lane][0] = random.s0[lane];
+        lanes[lane][1] = random.s1[lane];
+        lanes[lane][2] = random.s2[lane];
+        lanes[lane][3] = random.s3[lane];
+    }
+
+    vector<float> values(BLOCKS * Random::LANES);
+    random.FillUniform(values.data(), static_cast<int>(values.size()), -20.f, 20.f);
+
+    for(int i = 0; i < values.size(); ++i) {
+        ASSERT_EQ(values[i], ReferenceNext(lanes[i % Random::LANES], -20.f, 20.f)) << i;
+    }
+}
+
+TEST( RandomTest, Range )
+{
+    constexpr int COUNT = 100001;
+
+    Random random(1);
+    vector<float> values(COUNT);
+    random.FillUniform(values.data(), COUNT, 1.f, 10.f);
+
+    double sum = 0.0;
+    for(float value : values) {
+        ASSERT_GE(value, 1.f);
+        ASSERT_LT(value, 10.f);
+        sum += value;
+    }
+    ASSERT_NEAR(sum / COUNT, 5.5, 0.05);
+}
+
+TEST( RandomTest, SameSeed )
+{
+    Random a(7);
+    Random b(7);
+    Random c(8);
+
+    float valuesA[10];
+    float valuesB[10];
+    float valuesC[10];
+    a.FillUniform(valuesA, 10, 0.f, 1.f);
+    b.FillUniform(valuesB, 10, 0.f, 1.f);
+    c.FillUniform(valuesC, 10, 0.f, 1.f);
+
+    ASSERT_EQ(memcmp(valuesA, valuesB, sizeof(valuesA)), 0);
+    ASSERT_NE(memcmp(valuesA, valuesC, sizeof(valuesA)), 0);
+
+    a.Seed(7);
+    ASSERT_EQ(a.NextFloat(), valuesB[0]);
+}
+
+TEST( RandomTest, SeededSpawn )
+{
+    FlockingSimulation first;
+    FlockingSimulation second;
+    first.SetSeed(3);
+    second.SetSeed(3);
+
+    first.Spawn<PreyBehavior>(1001);
+    first.Spawn<HunterBehavior>(10);
+    second.Spawn<PreyBehavior>(1001);
+    second.Spawn<HunterBehavior>(10);
+
+    const vector<Boid>& boids = first.GetBoids();
+    const vector<Boid>& otherBoids = second.GetBoids();
+    ASSERT_EQ(boids.size(), otherBoids.size());
+
+    for(int i = 0; i < boids.size(); ++i) {
+        ASSERT_EQ(boids[i], otherBoids[i]) << i;
+
+        for(int axis = 0; axis < 3; ++axis) {
+            ASSERT_GE(boids[i].position[axis], first.minPoint[axis]);
+            ASSERT_LT(boids[i].position[axis], first.maxPoint[axis]);
+        }
+
+        const float speed = boids[i].velocity.length();
+        ASSERT_GE(speed, 0.999f);
+        ASSERT_LT(speed, 10.001f);
+    }
+}
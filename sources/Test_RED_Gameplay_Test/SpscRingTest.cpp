@@ -0,0 +1,24 @@
+﻿#include "pch.h"
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <FrameStats.h>
+
+TEST( SpscRingTest, FullAndWrap )
+{
+    SpscRing<int, 4> ring;
+    int item = -1;
+
+    ASSERT_FALSE(ring.Pop(item));
+    for(int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(ring.Push(i));
+    }
+    ASSERT_FALSE(ring.Push(4));
+
+    for(int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(ring.Pop(item));
+        ASSERT_EQ(item, i);
+        ASSERT_TRUE(ring.Push(i + 4));
+    }
+}
@@ -0,0 +1,201 @@
+﻿#include "pch.h"
+#include <random>
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <FlockingSimulation.h>
+#include <SteeringKernels.h>
+
+using reactphysics3d::Vector3;
+
+// Every instruction set is checked against the scalar kernels and the BoidList reference path.
+// Levels the CPU does not support fall back to the best supported one.
+class SteeringKernelsTest : public ::testing::TestWithParam<SIMD_LEVEL>
+{
+public:
+    void SetUp() override
+    {
+        previousLevel = GetSimdLevel();
+        SetSimdLevel(GetParam());
+    }
+
+    void TearDown() override
+    {
+        SetSimdLevel(previousLevel);
+        flockingSimulation.ClearAll();
+    }
+
+    const Boid& AddBoid(Vector3 position, Vector3 velocity)
+    {
+        return *flockingSimulation.Resolve(flockingSimulation.Spawn<Behavior>(&position.x, &velocity.x));
+    }
+
+    NeighbourBuffer GetBuffer(const BoidList& neighbours)
+    {
+        const vector<Boid>& boids = flockingSimulation.GetBoids();
+        storage.Assign(boids);
+
+        NeighbourBuffer buffer;
+        for(const Boid* neighbour : neighbours) {
+            buffer.Add(storage, static_cast<int>(neighbour - boids.data()));
+        }
+
+        return buffer;
+    }
+
+    void ExpectSameSteering(int id)
+    {
+        const Boid& boid = flockingSimulation.GetBoids()[id];
+        const Behavior& behavior = *boid.behavior;
+        const BoidList neighbours = behavior.GetNeighbours(boid, flockingSimulation.GetBoids());
+        const NeighbourBuffer buffer = GetBuffer(neighbours);
+
+        ExpectNear(behavior.GetAlignment(buffer), behavior.GetAlignment(boid, neighbours));
+        ExpectNear(behavior.GetCohesion(boid.position, buffer), behavior.GetCohesion(boid, neighbours));
+        ExpectNear(behavior.GetSeparation(boid.position, boid.radius, buffer), behavior.GetSeparation(boid, neighbours));
+    }
+
+    static void ExpectNear(const Vector3& value, const Vector3& expected)
+    {
+        constexpr float ERROR = 0.0001f;
+        const float tolerance = ERROR * (1.f + expected.length());
+
+        EXPECT_NEAR(value.x, expected.x, tolerance);
+        EXPECT_NEAR(value.y, expected.y, tolerance);
+        EXPECT_NEAR(value.z, expected.z, tolerance);
+    }
+
+    FlockingSimulation flockingSimulation;
+    BoidStorage storage;
+    SIMD_LEVEL previousLevel = SIMD_LEVEL::SCALAR;
+};
+
+// test cases
+////////////////////////////////////////////////
+
+TEST_P( SteeringKernelsTest, MatchesScalarKernels )
+{
+    const SteeringKernels& scalar = GetScalarSteeringKernels();
+    const SteeringKernels& kernels = GetSteeringKernels(GetParam());
+
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+
+    constexpr int MAX_NEIGHBOURS = 41;
+    for(int count = 0; count <= MAX_NEIGHBOURS; ++count) {
+        for(int i = 0; i < count; ++i) {
+            Vector3 position = {uniform(engine), uniform(engine), uniform(engine)};
+            Vector3 velocity = {uniform(engine) * 5.f, uniform(engine) * 5.f, uniform(engine) * 5.f};
+            AddBoid(position, velocity);
+        }
+
+        storage.Assign(flockingSimulation.GetBoids());
+        NeighbourBuffer buffer;
+        for(int i = 0; i < count; ++i) {
+            buffer.Add(storage, i);
+        }
+
+        const Vector3 position = {0.1f, -0.2f, 0.3f};
+        constexpr float MIN_DISTANCE_2 = 0.8f;
+
+        ExpectNear(kernels.sumVelocities(buffer), scalar.sumVelocities(buffer));
+        ExpectNear(kernels.sumPositions(buffer), scalar.sumPositions(buffer));
+        ExpectNear(kernels.sumSeparation(position, MIN_DISTANCE_2, buffer), scalar.sumSeparation(position, MIN_DISTANCE_2, buffer));
+
+        flockingSimulation.ClearAll();
+    }
+}
+
+// Neighbours on top of the boid have no direction to push along, every level skips them in the vector body and the tail alike
+TEST_P( SteeringKernelsTest, CoincidentNeighbours )
+{
+    const SteeringKernels& scalar = GetScalarSteeringKernels();
+    const SteeringKernels& kernels = GetSteeringKernels(GetParam());
+
+    const Vector3 position = {0.1f, -0.2f, 0.3f};
+    constexpr float MIN_DISTANCE_2 = 0.8f;
+    constexpr int COUNT = 13;
+
+    std::mt19937 engine(7);
+    std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+    for(int i = 0; i < COUNT; ++i) {
+        AddBoid(position + Vector3{uniform(engine), uniform(engine), uniform(engine)}, {1.f, 0.f, 0.f});
+    }
+    // Two neighbours sharing the boid's position
+    AddBoid(position, {1.f, 0.f, 0.f});
+    AddBoid(position, {0.f, 1.f, 0.f});
+    storage.Assign(flockingSimulation.GetBoids());
+
+    NeighbourBuffer others;
+    for(int i = 0; i < COUNT; ++i) {
+        others.Add(storage, i);
+    }
+    const Vector3 expected = scalar.sumSeparation(position, MIN_DISTANCE_2, others);
+
+    // The pair goes into every lane of the vector body and of the tail
+    for(int slot = 0; slot <= COUNT; ++slot) {
+        NeighbourBuffer buffer;
+        for(int i = 0; i <= COUNT; ++i) {
+            if(i == slot) {
+                buffer.Add(storage, COUNT);
+                buffer.Add(storage, COUNT + 1);
+            }
+            if(i < COUNT) {
+                buffer.Add(storage, i);
+            }
+        }
+
+        ExpectNear(scalar.sumSeparation(position, MIN_DISTANCE_2, buffer), expected);
+        ExpectNear(kernels.sumSeparation(position, MIN_DISTANCE_2, buffer), expected);
+    }
+}
+
+TEST_P( SteeringKernelsTest, CheckAlignment )
+{
+    AddBoid({0.f, 0.f, 0.f}, {1.f, 0.f, 0.f});
+    AddBoid({0.f, 0.f, DefaultBehaviorParams::VIEW_DISTANCE / 2}, {0.f, 1.f, 0.f});
+    AddBoid({0.f, 0.f, -DefaultBehaviorParams::VIEW_DISTANCE / 2}, {0.f, -1.f, 0.f});
+
+    for(int id = 0; id < 3; ++id) {
+        ExpectSameSteering(id);
+    }
+}
+
+TEST_P( SteeringKernelsTest, CheckCohesionCentered )
+{
+    const Vector3 positions[] = {{1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, 0.f, 1.f}, {-1.f, 0.f, 0.f}, {0.f, -1.f, 0.f}, {0.f, 0.f, -1.f}, {0.f, 0.f, 0.f}};
+    for(const Vector3& position : positions) {
+        AddBoid(position, {1.f, 0.f, 0.f});
+    }
+
+    constexpr int CHECK_ID = 6;
+    flockingSimulation.GetBehavior<Behavior>().viewAngle = 360.f;
+    ExpectSameSteering(CHECK_ID);
+}
+
+TEST_P( SteeringKernelsTest, CheckSeparation )
+{
+    constexpr float HALF_DISTANCE = DefaultBehaviorParams::MIN_BOID_DISTANCE / 2;
+    AddBoid({0.f, 0.f, 0.f}, {1.f, 2.f, 0.f});
+    AddBoid({0.f, 0.f, HALF_DISTANCE}, {0.f, 1.f, 1.f});
+    AddBoid({0.f, 0.f, -HALF_DISTANCE}, {0.f, 1.f, 0.f});
+    AddBoid({0.f, 0.f, HALF_DISTANCE}, {0.f, -1.f, 1.f});
+    AddBoid({0.f, 0.f, -HALF_DISTANCE}, {1.f, -1.f, 0.f});
+    AddBoid({0.f, -DefaultBehaviorParams::MIN_BOID_DISTANCE, 0.f}, {1.f, -1.f, 0.f});
+
+    for(int id = 0; id < 6; ++id) {
+        ExpectSameSteering(id);
+    }
+}
+
+TEST_P( SteeringKernelsTest, DenseFlock )
+{
+    flockingSimulation.Spawn<Behavior>(2000);
+
+    for(int id = 0; id < 2000; id += 7) {
+        ExpectSameSteering(id);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P( SimdLevels, SteeringKernelsTest, ::testing::Values(SIMD_LEVEL::SCALAR, SIMD_LEVEL::SSE41, SIMD_LEVEL::AVX2) );
@@ -0,0 +1,48 @@
+﻿#include "pch.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <ThreadPool.h>
+
+// The first quarter costs far more than the rest, the other workers steal it
+TEST( ThreadPoolTest, UnevenRangesRunOnce )
+{
+    constexpr int COUNT = 4000;
+
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> runs(COUNT);
+    std::atomic<int> wrongWorker = 0;
+
+    pool.ParallelFor(COUNT, [&](int begin, int end, int worker)
+    {
+        if(worker < 0 || worker >= pool.GetWorkerCount()) {
+            ++wrongWorker;
+        }
+        for(int i = begin; i < end; ++i) {
+            if(i < COUNT / 4) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            ++runs[i];
+        }
+    });
+
+    ASSERT_EQ(wrongWorker, 0);
+    for(int i = 0; i < COUNT; ++i) {
+        ASSERT_EQ(runs[i], 1) << i;
+    }
+
+    const SchedulerStats stats = pool.TakeStats();
+    ASSERT_GT(stats.steals, 0);
+    ASSERT_GE(stats.chunks, 4);
+    ASSERT_GT(stats.GetUtilization(), 0.0);
+    ASSERT_EQ(pool.TakeStats().chunks, 0);
+
+    std::atomic<int> flushed = 0;
+    pool.ForEachWorker([&](int begin, int end, int worker) { flushed += 1 << worker; });
+    ASSERT_EQ(flushed, 0b1111);
+}
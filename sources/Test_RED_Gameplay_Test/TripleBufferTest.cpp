@@ -0,0 +1,27 @@
+﻿#include "pch.h"
+#include <reactphysics3d/reactphysics3d.h>
+
+#define DEBUG
+
+#include <TripleBuffer.h>
+
+TEST( TripleBufferTest, ReaderGetsLatest )
+{
+    TripleBuffer<int> buffer;
+    ASSERT_FALSE(buffer.Acquire());
+
+    buffer.GetBack() = 1;
+    buffer.Publish();
+    buffer.GetBack() = 2;
+    buffer.Publish();
+    ASSERT_TRUE(buffer.Acquire());
+    ASSERT_EQ(buffer.GetFront(), 2);
+    ASSERT_FALSE(buffer.Acquire());
+    ASSERT_EQ(buffer.GetFront(), 2);
+
+    buffer.GetBack() = 3;
+    buffer.Publish();
+    ASSERT_EQ(buffer.GetFront(), 2);
+    ASSERT_TRUE(buffer.Acquire());
+    ASSERT_EQ(buffer.GetFront(), 3);
+}